@@ -6,19 +6,34 @@
  * Change Logs:
  * Date           Author       Notes
  * 2026-01-08     28784       the first version
+ * 2026-10-19     28784       add binary trace mode
+ * 2026-10-19     28784       add one-shot N-edge capture
+ * 2026-10-19     28784       add tachometer (RPM) mode
+ * 2026-10-19     28784       add stall / stuck-level detection
+ * 2026-10-19     28784       add quadrature encoder mode
+ * 2026-10-19     28784       add hardware-chained 32-bit counter
+ * 2026-10-19     28784       add synchronised start across capture timers
+ * 2026-10-19     28784       add IC/PWM shared-timer mode
+ * 2026-10-19     28784       add median / Hampel / min-width filter stage
+ * 2026-10-19     28784       add decimation (N-cycle averaging) output
+ * 2026-10-19     28784       per-timer bring-up from a shared descriptor, cached clock
+ * 2026-10-19     28784       add multi-reader fan-out buffer
+ * 2026-10-19     28784       add ISR-to-read latency tracing and per-device NVIC priority
+ * 2026-10-19     28784       fix a capture taken just after a wrap losing that wrap
+ * 2026-10-19     28784       add trace sync records so channels share one timebase
  */
 
 /*
  * ==>>一般注意事项：
  * 本文件初始化中只定义了stm32f4和f1的内容，其他的需要自己添加或修改本文件
- * 中断NVIC使能及优先级需在cubemx中设置，其配置内容在生成的msp函数中
+ * 中断NVIC使能及优先级需在cubemx中设置，其配置内容在生成的msp函数中；优先级也可以在input_capture_config.h中按定时器设置，打开设备时生效
  * 在RT-Thread Settings设置的输入捕获环形缓冲区是以8字节为单位的，因此不应太大，避免使用过多堆空间
  * 使用TIM1（高级定时器）需要注意其中断处理函数的名字
  * 其他定时器的中断处理函数需要自己加
  * 其他定时器的枚举索引需要自己加（按顺序）
  * 其他定时器的config需要自己加（在drv_config.h文件中写定义，在drv_inputcapture.c中写声明）
  * 其他定时器的中断处理函数中调用的isr函数中的条件编译（可能）需要自己加
- * 其他定时器的初始化init需要自己加（在drv_inputcapture.c中的stm32_timer_capture_init函数中的if else判断语句）
+ * 其他定时器需要加到stm32_capture_timer_obj表中（同一定时器上的通道共用一项，时基只初始化一次）
  * 触发回调后，一定要清空环形缓冲区数据，否则满时将警告缓冲区空间不足（需开启ulog组件的ISR使能打印，否则程序会卡住）
  * ==>>IC与pwm同定时器：
  * 与pwm同定时器的话pwm设置的周期会影响输入捕获的周期
@@ -26,6 +41,8 @@
  * 周期<=10000000ns时影响捕获准确度很大，周期越小影响越大
  * 周期过小时会导致中断频繁而占用较多的cpu从而使线程无法清除缓冲区而报错
  * 因此不建议一个定时器同时使用IC与pwm
+ * 确实要共用时在board.h定义TIMERx_CAPTURE_SHARE_PWM：预分频和周期由drv_pwm决定，捕获按实际的ARR和预分频换算，
+ * 精度不受影响，但pwm周期越小溢出中断越频繁的问题仍在
 
  * @本文件修改自原文：https://club.rt-thread.org/ask/article/798724ca63ab008c.html
  * */
@@ -39,12 +56,48 @@
 #ifdef RT_USING_INPUT_CAPTURE
 #include <rtdevice.h>
 #include "drv_config.h"
+#include "drv_input_capture.h"
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+#include "ic_trace_format.h"
+#ifdef RT_USING_DFS
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+#endif
 
 /* Private typedef --------------------------------------------------------------*/
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+/* 滤波的滑动窗口，同一组数据存两份：hist按到达顺序（找最老的），sorted升序（取中值） */
+struct input_capture_filter_window{
+    rt_uint8_t  pos;                        // hist的写位置
+    rt_uint8_t  filled;                     // 有效个数
+    rt_uint32_t hist[INPUT_CAPTURE_FILTER_WINDOW_MAX];
+    rt_uint32_t sorted[INPUT_CAPTURE_FILTER_WINDOW_MAX];
+};
+#endif
+
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+/* 记录的时间戳：DWT周期数是32位的，168MHz时约25.6s回绕一次，另记系统tick用来认出等得比这更久的记录 */
+struct input_capture_latency_stamp{
+    rt_uint32_t cyc;                        // 中断入口的DWT周期数
+    rt_tick_t   tick;
+};
+#endif
+
+/* @同一个定时器上的各通道共用：时基只初始化一次，定时器时钟只读一次
+ * @注册时只找到所属的定时器，硬件在第一次打开该定时器上的某个通道时才初始化（同步启动除外） */
+struct stm32_capture_timer{
+    TIM_TypeDef *instance;
+    rt_uint8_t  ready;                      // 时基已初始化并在计数
+    rt_uint32_t clock;                      // 定时器时钟（Hz），0为还没读
+};
+
 typedef struct stm32_capture_device{
     struct rt_inputcapture_device parent;   // 上层句柄
     TIM_HandleTypeDef   timer;              // 定时器句柄
+    struct stm32_capture_timer *group;      // 所属的定时器，编码器为RT_NULL
     IRQn_Type   irq;                        // 中断类型
+    rt_uint8_t  irq_priority;               // 中断抢占优先级+1，0为保持cubemx的设置
     char*       name;                       // 应用层rt_device_find时用这个名字
     rt_uint32_t ch;                         // 不是十进制1/2/3/4，是TIM_CHANNEL_1/TIM_CHANNEL_2...
     rt_uint32_t u32LastCnt;                 // 每次捕获边沿时的计数值
@@ -52,13 +105,111 @@ typedef struct stm32_capture_device{
     rt_uint32_t over_under_flowcount;       // 定时器计数溢出次数
     rt_uint8_t  input_data_level;           // 高/低电平
     rt_uint8_t  not_first_edge;             // 不是第一边沿（首次检测下降沿，1：不是第一边沿，0：是第一边沿，初始化为0）
+    rt_uint32_t oneshot_remain;             // 单次捕获还差多少条记录，0表示连续捕获（或单次捕获已完成）
+    struct rt_semaphore oneshot_sem;        // 单次捕获完成时释放
+    rt_uint8_t  mode;                       // 输出模式，INPUTCAPTURE_MODE_xxx
+    rt_uint32_t stall_overflows;            // 连续溢出这么多次没有边沿判为停滞，0不检测
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+    TIM_TypeDef *chain;                     // 级联的从定时器（计高16位），RT_NULL为不级联
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_SHARE_PWM
+    rt_uint8_t  share_pwm;                  // 1：与drv_pwm共用定时器，预分频和周期以寄存器为准
+    rt_uint32_t clk_mhz;                    // 定时器时钟（MHz），换算us用
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_RPM
+    struct {
+        rt_uint16_t events_per_rev;         // 每转的捕获次数（已除去硬件输入预分频）
+        rt_uint8_t  window;                 // 平均的转数
+        rt_uint8_t  every_rev;              // 1：每转输出一次滑动平均，0：每window转输出一次
+        rt_uint8_t  pos;                    // hist的写位置
+        rt_uint8_t  filled;                 // hist中的有效个数
+        rt_uint8_t  stalled;                // 已报告停转
+        rt_uint16_t events;                 // 本转已捕获的次数
+        rt_uint32_t acc;                    // 本转已累计的计数值
+        rt_uint32_t sum;                    // hist之和
+        rt_uint32_t icpsc;                  // 硬件输入预分频，TIM_ICPSC_DIVx
+        rt_uint32_t hist[INPUT_CAPTURE_RPM_WINDOW_MAX];// 最近几转的周期
+    } rpm;
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+    struct {
+        rt_uint8_t  type;                   // INPUTCAPTURE_FILTER_xxx
+        rt_uint8_t  window;                 // 中值/Hampel的窗口长度
+        rt_uint8_t  k_x10;                  // Hampel门限（MAD的倍数×10）
+        rt_uint8_t  has_pending;            // 最小宽度：pending中有一条还没输出
+        rt_uint8_t  pending_level;
+        rt_uint8_t  absorbing;              // 最小宽度：刚吞掉一个毛刺，下一条也并入pending
+        rt_uint32_t pending;                // 最小宽度：推迟一条输出，后面的毛刺才能并进来
+        rt_uint32_t min_us;                 // 最小宽度；Hampel门限的下限
+        struct inputcapture_filter_stat stat;
+        struct input_capture_filter_window win[2];// 低、高电平的宽度分开统计
+    } filt;
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+    struct {
+        rt_uint16_t cycles;                 // 每这么多个周期输出一次平均，0/1不抽取
+        rt_uint16_t records;                // 已累计的记录数
+        rt_uint16_t count[2];               // 低、高电平各累计的个数
+        rt_uint32_t sum[2];                 // 低、高电平各累计的宽度
+    } decim;
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_FANOUT
+    struct {
+        struct rt_inputcapture_data *buf;   // 各读者共用的缓冲区，有读者时才分配
+        volatile rt_uint32_t head;          // 已写入的记录总数（只增不减，取模后才是下标）
+        struct stm32_capture_reader *readers;
+    } fan;
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+    rt_int64_t  trace_ticks;                // 追踪时上一个边沿（或计数起点）距开始追踪的计数值，同步记录用
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+    struct {
+        struct input_capture_latency_stamp *stamps;// 与环形缓冲区的记录一一对应，开启时才分配
+        rt_uint32_t cyc_per_us;
+        rt_tick_t   limit_ticks;            // DWT周期数回绕一圈的tick数减1，等待不短于它的记录算不出延迟
+        struct inputcapture_latency_stat stat;
+    } lat;
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+    rt_uint8_t  encoder;                    // 1：编码器模式，整个定时器由本设备使用，ch为Z相所在通道
+    rt_uint8_t  enc_z;                      // 1：接了Z相
+    struct {
+        rt_uint32_t last_cnt;               // 上次采样时的计数值
+        rt_int32_t  position;               // 扩展成32位的位置
+        rt_int32_t  velocity;               // 速度（计数/s）
+        rt_uint8_t  low_speed;              // 1：低速，用A相边沿间隔测速
+        rt_uint32_t edge_cyc;               // 最近一个A相上升沿的DWT周期数
+        rt_uint32_t edge_cyc_prev;
+        rt_uint32_t edge_cnt;               // 最近一个A相上升沿时的计数值
+        rt_uint32_t edge_cnt_prev;
+        rt_uint32_t edges;                  // 进入低速后的A相上升沿个数
+        rt_uint32_t index_cyc;              // 上一个Z相脉冲的DWT周期数
+        rt_uint8_t  index_seen;             // 已经有过Z相脉冲
+        rt_int32_t  index_position;         // 上一个Z相脉冲时的位置
+        rt_uint32_t index_count;            // Z相脉冲个数
+        struct rt_timer timer;              // 周期采样，放在最后，打开时前面的成员清零
+    } enc;
+#endif
 }stm32_capture_device;
 /* Private functions ------------------------------------------------------------*/
 static  rt_err_t stm32_capture_init(struct rt_inputcapture_device *inputcapture);
 static  rt_err_t stm32_capture_open(struct rt_inputcapture_device *inputcapture);
 static  rt_err_t stm32_capture_close(struct rt_inputcapture_device *inputcapture);
 static  rt_err_t stm32_capture_get_pulsewidth(struct rt_inputcapture_device *inputcapture, rt_uint32_t *pulsewidth_us);
+static  rt_err_t stm32_capture_control(rt_device_t dev, int cmd, void *args);
 /* Private define ---------------------------------------------------------------*/
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+/* @中断入口的DWT周期数，放进环形缓冲区的记录以它为时间戳
+ * @被更高优先级的捕获中断嵌套时，由嵌套的中断退出时恢复 */
+static volatile rt_uint32_t input_capture_isr_cyc;
+#define INPUT_CAPTURE_ISR_ENTER()   rt_uint32_t ic_isr_cyc_now = DWT->CYCCNT, ic_isr_cyc_saved = input_capture_isr_cyc; \
+                                    input_capture_isr_cyc = ic_isr_cyc_now
+#define INPUT_CAPTURE_ISR_LEAVE()   input_capture_isr_cyc = ic_isr_cyc_saved
+#else
+#define INPUT_CAPTURE_ISR_ENTER()
+#define INPUT_CAPTURE_ISR_LEAVE()
+#endif
 /* Public functions -------------------------------------------------------------*/
 /* Private variables ------------------------------------------------------------*/
 enum
@@ -121,6 +272,16 @@ enum
 #ifdef TIMER4_CAPTURE_CHANNEL4
     TIMER4_CAPTURE_CH4_INDEX,
 #endif
+#endif
+
+#ifdef BSP_USING_TIMER2_ENCODER
+    TIMER2_ENCODER_INDEX,
+#endif
+#ifdef BSP_USING_TIMER3_ENCODER
+    TIMER3_ENCODER_INDEX,
+#endif
+#ifdef BSP_USING_TIMER4_ENCODER
+    TIMER4_ENCODER_INDEX,
 #endif
     TIMER_CAPTURE_INDEX_MAX,
 };
@@ -186,6 +347,16 @@ static struct stm32_capture_device stm32_capture_obj[] =
         TIMER4_CAPTURE_CH4_CONFIG,
 #endif
 #endif /* BSP_USING_TIMER4_CAPTURE */
+
+#ifdef BSP_USING_TIMER2_ENCODER
+        TIMER2_ENCODER_CONFIG,
+#endif
+#ifdef BSP_USING_TIMER3_ENCODER
+        TIMER3_ENCODER_CONFIG,
+#endif
+#ifdef BSP_USING_TIMER4_ENCODER
+        TIMER4_ENCODER_CONFIG,
+#endif
 };
 static struct rt_inputcapture_ops stm32_capture_ops = {
         .init   =   stm32_capture_init,
@@ -193,587 +364,2496 @@ static struct rt_inputcapture_ops stm32_capture_ops = {
         .close  =   stm32_capture_close,
         .get_pulsewidth =   stm32_capture_get_pulsewidth,
 };
+static struct stm32_capture_timer stm32_capture_timer_obj[] =
+{
+#ifdef BSP_USING_TIMER1_CAPTURE
+    {.instance = TIM1},
+#endif
+#ifdef BSP_USING_TIMER2_CAPTURE
+    {.instance = TIM2},
+#endif
+#ifdef BSP_USING_TIMER3_CAPTURE
+    {.instance = TIM3},
+#endif
+#ifdef BSP_USING_TIMER4_CAPTURE
+    {.instance = TIM4},
+#endif
+    {.instance = RT_NULL}
+};
+/* rt_inputcapture框架的control，驱动自己的命令之外都交给它 */
+static rt_err_t (*stm32_capture_parent_control)(rt_device_t dev, int cmd, void *args) = RT_NULL;
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+/* rt_inputcapture框架的read，开了延迟统计时读完再统计 */
+static rt_ssize_t (*stm32_capture_parent_read)(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size) = RT_NULL;
+#endif
+#ifdef RT_USING_DEVICE_OPS
+static struct rt_device_ops stm32_capture_dev_ops;
+#endif
 /* Functions define ------------------------------------------------------------*/
-void input_capture_cc1_isr(struct stm32_capture_device* device)
+rt_inline rt_uint32_t input_capture_ch_it(rt_uint32_t ch)
 {
-    /* Capture compare 1 event */
-    if (__HAL_TIM_GET_FLAG(&device->timer, TIM_FLAG_CC1) != RESET)
-    {
-        if (__HAL_TIM_GET_IT_SOURCE(&device->timer, TIM_IT_CC1) != RESET)
-        {
-            __HAL_TIM_CLEAR_IT(&device->timer, TIM_IT_CC1);
-#if defined(TIMER1_CAPTURE_CHANNEL1) || defined(TIMER2_CAPTURE_CHANNEL1) || defined(TIMER3_CAPTURE_CHANNEL1) || \
-        defined(TIMER4_CAPTURE_CHANNEL1) || defined(TIMER5_CAPTURE_CHANNEL1) || defined(TIMER8_CAPTURE_CHANNEL1) || \
-        defined(TIMER9_CAPTURE_CHANNEL1) || defined(TIMER10_CAPTURE_CHANNEL1) || defined(TIMER11_CAPTURE_CHANNEL1) || \
-        defined(TIMER12_CAPTURE_CHANNEL1) || defined(TIMER13_CAPTURE_CHANNEL1) || defined(TIMER14_CAPTURE_CHANNEL1)
-            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_1;
-            if ((device->timer.Instance->CCMR1 & TIM_CCMR1_CC1S) != 0x00U)// input capture
-            {
-                rt_uint32_t cnt = HAL_TIM_ReadCapturedValue(&device->timer, device->ch);//获取当前的捕获值.
-                if(!device->not_first_edge){    //首次检测下降沿
-                    device->not_first_edge = 1;
-                    device->input_data_level = 0; // 因为首次采集的是低电平时间，同时也对应了开始时的下降沿检测
-                    device->u32LastCnt = cnt;
-                }else{
-                    /* @对于32位定时器而言，1us计数下其周期能有1小时以上，不太可能计数溢出，因此这里的over_under_flowcount会等于0
-                     * @对于16位定时器而言，可能会经常溢出，over_under_flowcount等于溢出次数
-                     * @因此这里的计算适合16位定时器、兼容32位定时器*/
-                    device->u32PluseCnt = cnt + 0x10000 * device->over_under_flowcount - device->u32LastCnt;
-                    rt_hw_inputcapture_isr(&device->parent, device->input_data_level);
-                    device->input_data_level = !device->input_data_level;
-                }
-                if(device->input_data_level)
-                    __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_FALLING);     //切换捕获极性
-                else
-                    __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_RISING);    //切换捕获极性
-                device->over_under_flowcount = 0;
-                device->u32LastCnt = cnt;
-
-            }
-            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
-#endif /* TIMERx_CAPTURE_CHANNEL1 */
-        }
+    switch (ch) {
+    case TIM_CHANNEL_1: return TIM_IT_CC1;
+    case TIM_CHANNEL_2: return TIM_IT_CC2;
+    case TIM_CHANNEL_3: return TIM_IT_CC3;
+    case TIM_CHANNEL_4: return TIM_IT_CC4;
+    default:            return 0;
     }
 }
-void input_capture_cc2_isr(struct stm32_capture_device* device)
+
+/* 单次捕获完成：关掉本通道的捕获中断，定时器上没有别的通道在捕获时连溢出中断也关掉 */
+static void input_capture_oneshot_done(struct stm32_capture_device* device)
 {
-    /* Capture compare 2 event */
-    if (__HAL_TIM_GET_FLAG(&device->timer, TIM_FLAG_CC2) != RESET)
-    {
-        if (__HAL_TIM_GET_IT_SOURCE(&device->timer, TIM_IT_CC2) != RESET)
-        {
-            __HAL_TIM_CLEAR_IT(&device->timer, TIM_IT_CC2);
-#if defined(TIMER1_CAPTURE_CHANNEL2) || defined(TIMER2_CAPTURE_CHANNEL2) || defined(TIMER3_CAPTURE_CHANNEL2) || \
-        defined(TIMER4_CAPTURE_CHANNEL2) || defined(TIMER5_CAPTURE_CHANNEL2) || defined(TIMER8_CAPTURE_CHANNEL2) || \
-        defined(TIMER9_CAPTURE_CHANNEL2) || defined(TIMER12_CAPTURE_CHANNEL2)
-            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_2;
-            if ((device->timer.Instance->CCMR1 & TIM_CCMR1_CC2S) != 0x00U)// input capture
-            {
-                rt_uint32_t cnt = HAL_TIM_ReadCapturedValue(&device->timer, device->ch);//获取当前的捕获值.
-                if(!device->not_first_edge){    //首次检测下降沿
-                    device->not_first_edge = 1;
-                    device->input_data_level = 0;
-                    device->u32LastCnt = cnt;
-                }else{
-                    device->u32PluseCnt = cnt + 0x10000 * device->over_under_flowcount - device->u32LastCnt;
-                    rt_hw_inputcapture_isr(&device->parent, device->input_data_level);
-                    device->input_data_level = !device->input_data_level;
-                }
-                if(device->input_data_level)
-                    __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_FALLING);     //切换捕获极性
-                else
-                    __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_RISING);    //切换捕获极性
-                device->over_under_flowcount = 0;
-                device->u32LastCnt = cnt;
-            }
-            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
-#endif /* TIMERx_CAPTURE_CHANNEL2 */
-        }
-    }
+    __HAL_TIM_DISABLE_IT(&device->timer, input_capture_ch_it(device->ch));
+    if ((device->timer.Instance->DIER & (TIM_IT_CC1 | TIM_IT_CC2 | TIM_IT_CC3 | TIM_IT_CC4)) == 0)
+        __HAL_TIM_DISABLE_IT(&device->timer, TIM_IT_UPDATE);
+    rt_sem_release(&device->oneshot_sem);
 }
-void input_capture_cc3_isr(struct stm32_capture_device* device)
-{
-    /* Capture compare 3 event */
-    if (__HAL_TIM_GET_FLAG(&device->timer, TIM_FLAG_CC3) != RESET)
-    {
-        if (__HAL_TIM_GET_IT_SOURCE(&device->timer, TIM_IT_CC3) != RESET)
-        {
-            __HAL_TIM_CLEAR_IT(&device->timer, TIM_IT_CC3);
-#if defined(TIMER1_CAPTURE_CHANNEL3) || defined(TIMER2_CAPTURE_CHANNEL3) || defined(TIMER3_CAPTURE_CHANNEL3) || \
-        defined(TIMER4_CAPTURE_CHANNEL3) || defined(TIMER5_CAPTURE_CHANNEL3) || defined(TIMER8_CAPTURE_CHANNEL3)
-            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_3;
-            if ((device->timer.Instance->CCMR2 & TIM_CCMR2_CC3S) != 0x00U)// input capture
-            {
-                rt_uint32_t cnt = HAL_TIM_ReadCapturedValue(&device->timer, device->ch);//获取当前的捕获值.
-                if(!device->not_first_edge){    //首次检测下降沿
-                    device->not_first_edge = 1;
-                    device->input_data_level = 0;
-                    device->u32LastCnt = cnt;
-                }else{
-                    device->u32PluseCnt = cnt + 0x10000 * device->over_under_flowcount - device->u32LastCnt;
-                    rt_hw_inputcapture_isr(&device->parent, device->input_data_level);
-                    device->input_data_level = !device->input_data_level;
-                }
-                if(device->input_data_level)
-                    __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_FALLING);     //切换捕获极性
-                else
-                    __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_RISING);    //切换捕获极性
-                device->over_under_flowcount = 0;
-                device->u32LastCnt = cnt;
 
-            }
-            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
-#endif /* TIMERx_CAPTURE_CHANNEL3 */
-        }
-    }
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+/* 根据board.h中的TIMERx_CAPTURE_CHAIN找主定时器对应的从定时器 */
+static TIM_TypeDef *input_capture_chain_slave(TIM_TypeDef *master, rt_uint32_t *itr)
+{
+#ifdef TIMER2_CAPTURE_CHAIN
+    if (master == TIM2) { *itr = TIMER2_CAPTURE_CHAIN_ITR; return TIMER2_CAPTURE_CHAIN_TIM; }
+#endif
+#ifdef TIMER3_CAPTURE_CHAIN
+    if (master == TIM3) { *itr = TIMER3_CAPTURE_CHAIN_ITR; return TIMER3_CAPTURE_CHAIN_TIM; }
+#endif
+#ifdef TIMER4_CAPTURE_CHAIN
+    if (master == TIM4) { *itr = TIMER4_CAPTURE_CHAIN_ITR; return TIMER4_CAPTURE_CHAIN_TIM; }
+#endif
+    return RT_NULL;
 }
-void input_capture_cc4_isr(struct stm32_capture_device* device)
+#endif /* BSP_USING_INPUT_CAPTURE_CHAIN */
+
+/* @读本通道的捕获值，级联时拼成32位
+ * @从定时器的计数是读的时候的高16位，若捕获之后主定时器已经回绕（当前计数比捕获值小），高16位要减1
+ * @先读高位再读低位，读完高位又变了说明中间回绕过，重读 */
+rt_inline rt_uint32_t input_capture_read_value(struct stm32_capture_device* device)
 {
-    /* Capture compare 4 event */
-    if (__HAL_TIM_GET_FLAG(&device->timer, TIM_FLAG_CC4) != RESET)
-    {
-        if (__HAL_TIM_GET_IT_SOURCE(&device->timer, TIM_IT_CC4) != RESET)
-        {
-            __HAL_TIM_CLEAR_IT(&device->timer, TIM_IT_CC4);
-#if defined(TIMER1_CAPTURE_CHANNEL4) || defined(TIMER2_CAPTURE_CHANNEL4) || defined(TIMER3_CAPTURE_CHANNEL4) || \
-        defined(TIMER4_CAPTURE_CHANNEL4) || defined(TIMER5_CAPTURE_CHANNEL4) || defined(TIMER8_CAPTURE_CHANNEL4)
-            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_4;
-            if ((device->timer.Instance->CCMR2 & TIM_CCMR2_CC4S) != 0x00U)// input capture
-            {
-                rt_uint32_t cnt = HAL_TIM_ReadCapturedValue(&device->timer, device->ch);//获取当前的捕获值.
-                if(!device->not_first_edge){    //首次检测下降沿
-                    device->not_first_edge = 1;
-                    device->input_data_level = 0;
-                    device->u32LastCnt = cnt;
-                }else{
-                    device->u32PluseCnt = cnt + 0x10000 * device->over_under_flowcount - device->u32LastCnt;
-                    rt_hw_inputcapture_isr(&device->parent, device->input_data_level);
-                    device->input_data_level = !device->input_data_level;
-                }
-                if(device->input_data_level)
-                    __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_FALLING);     //切换捕获极性
-                else
-                    __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_RISING);    //切换捕获极性
-                device->over_under_flowcount = 0;
-                device->u32LastCnt = cnt;
+    rt_uint32_t ccr = HAL_TIM_ReadCapturedValue(&device->timer, device->ch);
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+    rt_uint32_t hi, lo;
 
-            }
-            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
-#endif /* TIMERx_CAPTURE_CHANNEL4 */
-        }
+    if (device->chain != RT_NULL) {
+        do {
+            hi = device->chain->CNT;
+            lo = device->timer.Instance->CNT;
+        } while (device->chain->CNT != hi);
+        if (lo < ccr)
+            hi--;
+        return ((hi & 0xffff) << 16) | (ccr & 0xffff);
     }
+#endif
+    return ccr;
 }
 
-#ifdef BSP_USING_TIMER1_CAPTURE
-void TIM1_UP_IRQHandler(void)
+#ifdef BSP_USING_INPUT_CAPTURE_SHARE_PWM
+static rt_uint8_t input_capture_share_pwm(TIM_TypeDef *instance)
 {
-    /* enter interrupt */
-    rt_interrupt_enter();
-    TIM_HandleTypeDef timer;
-#if defined(TIMER1_CAPTURE_CHANNEL1)
-    timer = stm32_capture_obj[TIMER1_CAPTURE_CH1_INDEX].timer;
-#elif defined(TIMER1_CAPTURE_CHANNEL2)
-    timer = stm32_capture_obj[TIMER1_CAPTURE_CH2_INDEX].timer;
-#elif defined(TIMER1_CAPTURE_CHANNEL3)
-    timer = stm32_capture_obj[TIMER1_CAPTURE_CH3_INDEX].timer;
-#elif defined(TIMER1_CAPTURE_CHANNEL4)
-    timer = stm32_capture_obj[TIMER1_CAPTURE_CH4_INDEX].timer;
+#ifdef TIMER1_CAPTURE_SHARE_PWM
+    if (instance == TIM1) return 1;
 #endif
-    /* TIM Update event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_UPDATE) != RESET)
-    {
-        if (__HAL_TIM_GET_IT_SOURCE(&timer, TIM_IT_UPDATE) != RESET)
-        {
-            __HAL_TIM_CLEAR_IT(&timer, TIM_IT_UPDATE);
-            for(rt_uint8_t i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
-            {
-                if (stm32_capture_obj[i].timer.Instance == TIM1) {// 避免其他的TIM参数被修改
-                    stm32_capture_obj[i].over_under_flowcount++;
-                }
-            }
-        }
-    }
-    /* leave interrupt */
-    rt_interrupt_leave();
-}
-void TIM1_CC_IRQHandler(void)
-{
-    /* enter interrupt */
-    rt_interrupt_enter();
-#if defined(TIMER1_CAPTURE_CHANNEL1)
-    input_capture_cc1_isr(&stm32_capture_obj[TIMER1_CAPTURE_CH1_INDEX]);
+#ifdef TIMER2_CAPTURE_SHARE_PWM
+    if (instance == TIM2) return 1;
 #endif
-#if defined(TIMER1_CAPTURE_CHANNEL2)
-    input_capture_cc2_isr(&stm32_capture_obj[TIMER1_CAPTURE_CH2_INDEX]);
+#ifdef TIMER3_CAPTURE_SHARE_PWM
+    if (instance == TIM3) return 1;
 #endif
-#if defined(TIMER1_CAPTURE_CHANNEL3)
-    input_capture_cc3_isr(&stm32_capture_obj[TIMER1_CAPTURE_CH3_INDEX]);
+#ifdef TIMER4_CAPTURE_SHARE_PWM
+    if (instance == TIM4) return 1;
 #endif
-#if defined(TIMER1_CAPTURE_CHANNEL4)
-    input_capture_cc4_isr(&stm32_capture_obj[TIMER1_CAPTURE_CH4_INDEX]);
+    return 0;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_SHARE_PWM */
+
+/* 一次溢出的计数值：独占时固定0x10000，与pwm共用时为当前的ARR+1（pwm改周期后跨在改动上的那一个脉宽不准） */
+rt_inline rt_uint32_t input_capture_wrap(struct stm32_capture_device* device)
+{
+#ifdef BSP_USING_INPUT_CAPTURE_SHARE_PWM
+    if (device->share_pwm)
+        return device->timer.Instance->ARR + 1;
+#else
+    RT_UNUSED(device);
 #endif
-    /* leave interrupt */
-    rt_interrupt_leave();
+    return 0x10000;
 }
-#endif /* BSP_USING_TIMER1_CAPTURE */
 
-#ifdef BSP_USING_TIMER2_CAPTURE
-void TIM2_IRQHandler(void)
+/* 计数值换算成us：独占时就是1us一个计数，与pwm共用时按当前预分频换算 */
+rt_inline rt_uint32_t input_capture_ticks_to_us(struct stm32_capture_device* device, rt_uint32_t ticks)
 {
-    /* enter interrupt */
-    rt_interrupt_enter();
-    TIM_HandleTypeDef timer;
-#if defined(TIMER2_CAPTURE_CHANNEL1)
-    input_capture_cc1_isr(&stm32_capture_obj[TIMER2_CAPTURE_CH1_INDEX]);
-    timer = stm32_capture_obj[TIMER2_CAPTURE_CH1_INDEX].timer;
+#ifdef BSP_USING_INPUT_CAPTURE_SHARE_PWM
+    rt_uint32_t div;
+
+    if (device->share_pwm) {
+        div = device->timer.Instance->PSC + 1;
+        if (div != device->clk_mhz)
+            return (rt_uint64_t)ticks * div / device->clk_mhz;
+    }
+#else
+    RT_UNUSED(device);
 #endif
-#if defined(TIMER2_CAPTURE_CHANNEL2)
-    input_capture_cc2_isr(&stm32_capture_obj[TIMER2_CAPTURE_CH2_INDEX]);
-    timer = stm32_capture_obj[TIMER2_CAPTURE_CH2_INDEX].timer;
+    return ticks;
+}
+
+/* 级联的定时器不开溢出中断 */
+rt_inline void input_capture_enable_update(struct stm32_capture_device* device)
+{
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+    if (device->chain != RT_NULL)
+        return;
 #endif
-#if defined(TIMER2_CAPTURE_CHANNEL3)
-    input_capture_cc3_isr(&stm32_capture_obj[TIMER2_CAPTURE_CH3_INDEX]);
-    timer = stm32_capture_obj[TIMER3_CAPTURE_CH3_INDEX].timer;
+    __HAL_TIM_ENABLE_IT(&device->timer, TIM_IT_UPDATE);
+}
+
+int stm32_capture_index(const char *name)
+{
+    for (int i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
+    {
+        if (rt_strcmp(stm32_capture_obj[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+/* @追踪缓冲区：各定时器中断写、追踪线程读，线程每次把连续的一整段一次写出
+ * @不同定时器的中断可能互相嵌套，因此写入时关中断（只有几条指令） */
+static struct stm32_capture_trace{
+    rt_uint32_t buf[INPUT_CAPTURE_TRACE_BUF_WORDS];
+    volatile rt_uint32_t head;          // 写位置（只增不减，取模后才是下标）
+    volatile rt_uint32_t tail;          // 读位置
+    volatile rt_uint32_t ch_mask;       // 正在追踪的通道
+    rt_uint32_t drop_pending;           // 还没写进流里的丢弃条数
+    rt_uint16_t sync_left[TIMER_CAPTURE_INDEX_MAX];// 各通道再过几条记录放同步记录，0为下一条就放
+    rt_uint8_t  kicked;                 // 已唤醒线程，避免半满后每个边沿都释放信号量
+    volatile rt_uint8_t running;
+    stm32_capture_trace_write_t write;
+    void *ctx;
+    struct rt_semaphore kick_sem;       // 唤醒追踪线程
+    struct rt_semaphore exit_sem;       // 追踪线程退出
+    struct stm32_capture_trace_stat stat;
+}stm32_capture_trace_obj;
+
+#define TRACE_BUF_MASK  (INPUT_CAPTURE_TRACE_BUF_WORDS - 1)
+#if (INPUT_CAPTURE_TRACE_BUF_WORDS & TRACE_BUF_MASK) != 0
+#error "INPUT_CAPTURE_TRACE_BUF_WORDS must be a power of 2"
 #endif
-#if defined(TIMER2_CAPTURE_CHANNEL4)
-    input_capture_cc2_isr(&stm32_capture_obj[TIMER2_CAPTURE_CH4_INDEX]);
-    timer = stm32_capture_obj[TIMER2_CAPTURE_CH4_INDEX].timer;
+
+/* 该通道正在被追踪 */
+rt_inline rt_uint8_t input_capture_traced(struct stm32_capture_device* device)
+{
+    return (stm32_capture_trace_obj.ch_mask & (1UL << (device - stm32_capture_obj))) != 0;
+}
+
+/* 当前计数值，与捕获值同一个量程（级联时拼成32位） */
+rt_inline rt_uint32_t input_capture_trace_now(struct stm32_capture_device* device)
+{
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+    rt_uint32_t hi, lo;
+
+    if (device->chain != RT_NULL) {
+        do {
+            hi = device->chain->CNT;
+            lo = device->timer.Instance->CNT;
+        } while (device->chain->CNT != hi);
+        return ((hi & 0xffff) << 16) | (lo & 0xffff);
+    }
 #endif
-    /* TIM Update event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_UPDATE) != RESET)
-    {
-        if (__HAL_TIM_GET_IT_SOURCE(&timer, TIM_IT_UPDATE) != RESET)
-        {
-            __HAL_TIM_CLEAR_IT(&timer, TIM_IT_UPDATE);
-            for(rt_uint8_t i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
-            {
-                if (stm32_capture_obj[i].timer.Instance == TIM2) {// 避免其他的TIM参数被修改
-                    stm32_capture_obj[i].over_under_flowcount++;
-                }
-            }
-        }
+    return __HAL_TIM_GET_COUNTER(&device->timer);
+}
+
+/* @开始追踪时关中断调用：按计数起点（上一个边沿）距现在的时间倒推，之后每个边沿加上与上一个的间隔，就是距开始追踪的时间
+ * @各定时器依次读计数值，通道之间的对齐误差在一个计数左右 */
+static void input_capture_trace_origin(struct stm32_capture_device* device)
+{
+    rt_uint32_t over = device->over_under_flowcount;
+
+    /* 溢出标志还没处理，说明计数已经回绕，这次溢出没计进去 */
+    if ((device->timer.Instance->SR & TIM_FLAG_UPDATE) && (device->timer.Instance->DIER & TIM_IT_UPDATE))
+        over++;
+    device->trace_ticks = -(rt_int64_t)(rt_uint32_t)(input_capture_trace_now(device) + input_capture_wrap(device) * over - device->u32LastCnt);
+}
+
+/* 距开始追踪的时间（us），与pwm共用时计数不是1us，要换算 */
+rt_inline rt_uint64_t input_capture_trace_us(struct stm32_capture_device* device)
+{
+    rt_uint64_t us = (rt_uint64_t)device->trace_ticks;
+#ifdef BSP_USING_INPUT_CAPTURE_SHARE_PWM
+    rt_uint32_t div;
+
+    if (device->share_pwm) {
+        div = device->timer.Instance->PSC + 1;
+        if (div != device->clk_mhz)
+            us = us * div / device->clk_mhz;
     }
-    /* TIM Break input event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_BREAK) != RESET)
-    {
-        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_BREAK);
+#endif
+    return us;
+}
+
+/* @中断中调用，返回1表示该通道在追踪，边沿已进入追踪流
+ * @通道的第一条记录、每条丢弃记录之后各通道的第一条记录、以及每INPUT_CAPTURE_TRACE_SYNC_RECORDS条记录前面放一条同步记录，
+ * 给出这条记录结束时的边沿距开始追踪的时间，上位机据此把各通道对齐到同一时间轴
+ * @开始追踪之前就捕获、开始之后才处理的边沿时间为负，不放同步记录，留给下一条 */
+rt_inline rt_uint8_t input_capture_trace_put(struct stm32_capture_device* device, rt_uint8_t data_level)
+{
+    struct stm32_capture_trace *trace = &stm32_capture_trace_obj;
+    rt_uint32_t ch = device - stm32_capture_obj;
+    rt_uint32_t delta = device->u32PluseCnt;
+    rt_uint32_t need, used;
+    rt_uint64_t sync_us = 0;
+    rt_uint8_t sync;
+    rt_base_t level;
+
+    if (!(trace->ch_mask & (1UL << ch)))
+        return 0;
+
+    level = rt_hw_interrupt_disable();
+    sync = (trace->sync_left[ch] == 0 || trace->drop_pending != 0) && device->trace_ticks >= 0;
+    if (sync)
+        sync_us = input_capture_trace_us(device);
+    need = 1 + (delta > IC_TRACE_DELTA_MAX) + (trace->drop_pending != 0) + (sync ? 1 + (sync_us > IC_TRACE_DELTA_MAX) : 0);
+    used = trace->head - trace->tail;
+    if (INPUT_CAPTURE_TRACE_BUF_WORDS - used < need) {
+        trace->drop_pending++;
+        trace->stat.dropped++;
     }
-    /* TIM Trigger detection event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_TRIGGER) != RESET)
-    {
-        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_TRIGGER);
+    else {
+        if (trace->drop_pending) {
+            trace->buf[trace->head++ & TRACE_BUF_MASK] = IC_TRACE_WORD(IC_TRACE_CH_DROP, 0, trace->drop_pending);
+            trace->drop_pending = 0;
+            /* 丢弃之后各通道的时间都不连续了，下一条都要同步 */
+            rt_memset(trace->sync_left, 0, sizeof(trace->sync_left));
+        }
+        if (sync) {
+            if (sync_us > IC_TRACE_DELTA_MAX)
+                trace->buf[trace->head++ & TRACE_BUF_MASK] = IC_TRACE_WORD(IC_TRACE_CH_EXT, 0, sync_us >> IC_TRACE_DELTA_BITS);
+            trace->buf[trace->head++ & TRACE_BUF_MASK] = IC_TRACE_WORD(IC_TRACE_CH_SYNC, 0, sync_us);
+            trace->sync_left[ch] = INPUT_CAPTURE_TRACE_SYNC_RECORDS;
+        }
+        if (trace->sync_left[ch])
+            trace->sync_left[ch]--;
+        if (delta > IC_TRACE_DELTA_MAX)
+            trace->buf[trace->head++ & TRACE_BUF_MASK] = IC_TRACE_WORD(IC_TRACE_CH_EXT, 0, delta >> IC_TRACE_DELTA_BITS);
+        trace->buf[trace->head++ & TRACE_BUF_MASK] = IC_TRACE_WORD(ch, data_level, delta);
+        trace->stat.records++;
+        used += need;
+        if (used > trace->stat.max_used)
+            trace->stat.max_used = used;
     }
-    /* TIM commutation event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_COM) != RESET)
-    {
-        __HAL_TIM_CLEAR_IT(&timer, TIM_FLAG_COM);
+    rt_hw_interrupt_enable(level);
+
+    /* 半满唤醒线程，其余情况由线程定时写出 */
+    if (used >= INPUT_CAPTURE_TRACE_BUF_WORDS / 2 && !trace->kicked) {
+        trace->kicked = 1;
+        rt_sem_release(&trace->kick_sem);
     }
-    /* leave interrupt */
-    rt_interrupt_leave();
+    return 1;
 }
-#endif /* BSP_USING_TIMER2_CAPTURE */
+#endif /* BSP_USING_INPUT_CAPTURE_TRACE */
 
-#ifdef BSP_USING_TIMER3_CAPTURE
-void TIM3_IRQHandler(void)
+#ifdef BSP_USING_INPUT_CAPTURE_FANOUT
+#define FANOUT_MASK     (INPUT_CAPTURE_FANOUT_RECORDS - 1)
+
+/* @写一条记录到共用缓冲区，不管读者读没读，满了就覆盖最老的，读者自己发现
+ * @每个读者只在未读的达到水位线（force时不管水位线）且还没被唤醒过时释放一次信号量 */
+static void input_capture_fanout_put(struct stm32_capture_device* device, rt_uint8_t data_level, rt_uint8_t force)
 {
-    /* enter interrupt */
-    rt_interrupt_enter();
-    TIM_HandleTypeDef timer;// 4个通道的timer句柄都一样，用哪个都行，条件编译是为了避免不知道使用了哪个通道
-#if defined(TIMER3_CAPTURE_CHANNEL1)
-    input_capture_cc1_isr(&stm32_capture_obj[TIMER3_CAPTURE_CH1_INDEX]);
-    timer = stm32_capture_obj[TIMER3_CAPTURE_CH1_INDEX].timer;
-#endif
-#if defined(TIMER3_CAPTURE_CHANNEL2)
-    input_capture_cc2_isr(&stm32_capture_obj[TIMER3_CAPTURE_CH2_INDEX]);
-    timer = stm32_capture_obj[TIMER3_CAPTURE_CH2_INDEX].timer;
+    struct rt_inputcapture_data *data = &device->fan.buf[device->fan.head & FANOUT_MASK];
+    struct stm32_capture_reader *reader;
+    rt_uint32_t head;
+
+    data->pulsewidth_us = device->u32PluseCnt;
+    data->is_high = data_level;
+    head = ++device->fan.head;
+    for (reader = device->fan.readers; reader != RT_NULL; reader = reader->next)
+    {
+        if (!reader->signalled && (force || head - reader->cursor >= reader->watermark)) {
+            reader->signalled = 1;
+            rt_sem_release(&reader->sem);
+        }
+    }
+}
+#endif /* BSP_USING_INPUT_CAPTURE_FANOUT */
+
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+/* 记下即将放进环形缓冲区的这条记录的时间戳，缓冲区满（这条会被丢掉）时不记，否则会盖掉最老一条未读记录的 */
+rt_inline void input_capture_latency_stamp(struct stm32_capture_device* device)
+{
+    struct rt_ringbuffer *rb = device->parent.ringbuff;
+    struct input_capture_latency_stamp *stamp;
+
+    if (device->lat.stamps != RT_NULL && rb != RT_NULL &&
+            rt_ringbuffer_space_len(rb) >= sizeof(struct rt_inputcapture_data)) {
+        stamp = &device->lat.stamps[rb->write_index / sizeof(struct rt_inputcapture_data)];
+        stamp->cyc = input_capture_isr_cyc;
+        stamp->tick = rt_tick_get();
+    }
+}
+#endif /* BSP_USING_INPUT_CAPTURE_LATENCY */
+
+/* 交给读者：有多读者时进共用缓冲区，否则进rt_inputcapture的环形缓冲区 */
+rt_inline void input_capture_deliver(struct stm32_capture_device* device, rt_uint8_t data_level)
+{
+#ifdef BSP_USING_INPUT_CAPTURE_FANOUT
+    if (device->fan.buf != RT_NULL) {
+        input_capture_fanout_put(device, data_level, 0);
+        return;
+    }
 #endif
-#if defined(TIMER3_CAPTURE_CHANNEL3)
-    input_capture_cc3_isr(&stm32_capture_obj[TIMER3_CAPTURE_CH3_INDEX]);
-    timer = stm32_capture_obj[TIMER3_CAPTURE_CH3_INDEX].timer;
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+    input_capture_latency_stamp(device);
 #endif
-#if defined(TIMER3_CAPTURE_CHANNEL4)
-    input_capture_cc4_isr(&stm32_capture_obj[TIMER3_CAPTURE_CH4_INDEX]);
-    timer = stm32_capture_obj[TIMER3_CAPTURE_CH4_INDEX].timer;
+    rt_hw_inputcapture_isr(&device->parent, data_level);
+}
+
+/* 单次捕获计数：每交给上层一条记录（包括停滞记录）调用一次 */
+rt_inline void input_capture_oneshot_count(struct stm32_capture_device* device)
+{
+    if (device->oneshot_remain && --device->oneshot_remain == 0)
+        input_capture_oneshot_done(device);
+}
+
+/* 把u32PluseCnt作为一条记录交给上层，除普通模式的停滞记录外，所有模式的输出都从这里走 */
+rt_inline void input_capture_push(struct stm32_capture_device* device, rt_uint8_t data_level)
+{
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+    if (!input_capture_trace_put(device, data_level))
 #endif
-    /* TIM Update event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_UPDATE) != RESET)
+    input_capture_deliver(device, data_level);
+    input_capture_oneshot_count(device);
+}
+
+#ifdef BSP_USING_INPUT_CAPTURE_RPM
+/* 重新开始平均：停转、重新打开、改设置时调用，hist也要清，否则sum从0开始却减去旧的周期 */
+static void input_capture_rpm_reset(struct stm32_capture_device* device)
+{
+    rt_memset(device->rpm.hist, 0, sizeof(device->rpm.hist));
+    device->rpm.events = 0;
+    device->rpm.acc = 0;
+    device->rpm.sum = 0;
+    device->rpm.pos = 0;
+    device->rpm.filled = 0;
+    device->rpm.stalled = 0;
+    device->not_first_edge = 0;
+}
+
+/* @测速模式下只捕获上升沿，且用硬件输入预分频，每次捕获是一个或几个完整的脉冲周期
+ * @累计满一转得到一转的周期，再对最近window转取平均 */
+rt_inline void input_capture_rpm_isr(struct stm32_capture_device* device, rt_uint32_t cnt)
+{
+    rt_uint32_t delta = input_capture_ticks_to_us(device, cnt + input_capture_wrap(device) * device->over_under_flowcount - device->u32LastCnt);
+
+    device->over_under_flowcount = 0;
+    device->u32LastCnt = cnt;
+    if (!device->not_first_edge) {// 第一次捕获只作为起点
+        device->not_first_edge = 1;
+        return;
+    }
+    device->rpm.stalled = 0;
+    device->rpm.acc += delta;
+    if (++device->rpm.events < device->rpm.events_per_rev)
+        return;
+
+    device->rpm.sum += device->rpm.acc - device->rpm.hist[device->rpm.pos];
+    device->rpm.hist[device->rpm.pos] = device->rpm.acc;
+    device->rpm.events = 0;
+    device->rpm.acc = 0;
+    if (++device->rpm.pos >= device->rpm.window)
+        device->rpm.pos = 0;
+    if (device->rpm.filled < device->rpm.window)
+        device->rpm.filled++;
+    if (device->rpm.every_rev || device->rpm.pos == 0) {
+        device->u32PluseCnt = device->rpm.sum / device->rpm.filled;
+        input_capture_push(device, 1);
+    }
+}
+
+/* 停滞时调用：只报告一次停转（周期为0的记录），并重新开始平均 */
+rt_inline void input_capture_rpm_stall_isr(struct stm32_capture_device* device)
+{
+    if (device->rpm.stalled)
+        return;
+    input_capture_rpm_reset(device);
+    device->rpm.stalled = 1;
+    device->u32PluseCnt = 0;
+    input_capture_push(device, 0);
+}
+#endif /* BSP_USING_INPUT_CAPTURE_RPM */
+
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+/* 把累计的平均值输出，先高后低，输出的记录仍然高低交替 */
+static void input_capture_decimate_flush(struct stm32_capture_device* device)
+{
+    for (rt_int8_t i = 1; i >= 0; i--)
     {
-        if (__HAL_TIM_GET_IT_SOURCE(&timer, TIM_IT_UPDATE) != RESET)
+        if (device->decim.count[i] == 0)
+            continue;
+        device->u32PluseCnt = device->decim.sum[i] / device->decim.count[i];
+        input_capture_push(device, i);
+        device->decim.sum[i] = 0;
+        device->decim.count[i] = 0;
+    }
+    device->decim.records = 0;
+}
+
+/* 累计一条记录，攒够cycles个周期（2×cycles条）输出一对平均的高、低电平 */
+rt_inline void input_capture_decimate(struct stm32_capture_device* device, rt_uint8_t data_level)
+{
+    rt_uint8_t i = data_level ? 1 : 0;
+    rt_uint32_t v = device->u32PluseCnt;
+
+    if (device->decim.sum[i] + v < device->decim.sum[i])// 再加就溢出了，先输出已有的
+        input_capture_decimate_flush(device);
+    device->decim.sum[i] += v;
+    device->decim.count[i]++;
+    if (++device->decim.records >= 2 * device->decim.cycles)
+        input_capture_decimate_flush(device);
+}
+#endif /* BSP_USING_INPUT_CAPTURE_DECIMATE */
+
+/* 普通模式下测到（并滤波后）的一条记录：抽取时先累计，否则直接输出 */
+rt_inline void input_capture_edge_out(struct stm32_capture_device* device, rt_uint8_t data_level)
+{
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+    if (device->decim.cycles > 1
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+            && !input_capture_traced(device)// 追踪的是原始边沿
+#endif
+            ) {
+        input_capture_decimate(device, data_level);
+        return;
+    }
+#endif
+    input_capture_push(device, data_level);
+}
+
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+static void input_capture_filter_reset(struct stm32_capture_device* device)
+{
+    device->filt.has_pending = 0;
+    device->filt.absorbing = 0;
+    device->filt.win[0].pos = device->filt.win[0].filled = 0;
+    device->filt.win[1].pos = device->filt.win[1].filled = 0;
+}
+
+/* @窗口中放入新值（满了就挤掉最老的），sorted保持升序
+ * @二分找到最老的值，再只移动它和新值之间的元素，信号平稳时几乎不用移动；
+ *  最坏（单调变化的信号，最老的在一头、新值在另一头）移动N-1个，O(N)，所以窗口上限较小，见INPUT_CAPTURE_FILTER_WINDOW_MAX */
+static void input_capture_filter_window_put(struct input_capture_filter_window *w, rt_uint8_t size, rt_uint32_t v)
+{
+    rt_uint32_t *s = w->sorted, old;
+    rt_uint8_t lo, hi, mid, i;
+
+    if (w->filled < size) {
+        i = w->filled++;
+    }
+    else {
+        old = w->hist[w->pos];
+        lo = 0;
+        hi = w->filled - 1;
+        while (lo < hi)
         {
-            __HAL_TIM_CLEAR_IT(&timer, TIM_IT_UPDATE);
-            for(rt_uint8_t i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
-            {
-                if (stm32_capture_obj[i].timer.Instance == TIM3) {// 避免其他的TIM参数被修改
-                    stm32_capture_obj[i].over_under_flowcount++;
-                }
-            }
+            mid = (lo + hi) / 2;
+            if (s[mid] < old)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        i = lo;
+        /* 空出的位置往新值该在的地方挪 */
+        while (i + 1 < w->filled && s[i + 1] < v)
+        {
+            s[i] = s[i + 1];
+            i++;
         }
     }
-    /* TIM Break input event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_BREAK) != RESET)
+    while (i > 0 && s[i - 1] > v)
     {
-        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_BREAK);
+        s[i] = s[i - 1];
+        i--;
     }
-    /* TIM Trigger detection event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_TRIGGER) != RESET)
+    s[i] = v;
+    w->hist[w->pos] = v;
+    if (++w->pos >= size)
+        w->pos = 0;
+}
+
+/* @中值绝对偏差（MAD），窗口长度为奇数
+ * @偏差从中值往两边各自递增，像归并一样从两边取，第m个就是偏差的中值（中值本身偏差为0，是第0个），固定(N-1)/2步 */
+static rt_uint32_t input_capture_filter_window_mad(const struct input_capture_filter_window *w)
+{
+    const rt_uint32_t *s = w->sorted;
+    rt_uint8_t m = (w->filled - 1) / 2, l = m, r = m;
+    rt_uint32_t med = s[m], dl, dr, d = 0;
+
+    for (rt_uint8_t k = 0; k < m; k++)
     {
-        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_TRIGGER);
+        dl = l > 0 ? med - s[l - 1] : 0xffffffffUL;
+        dr = r + 1 < w->filled ? s[r + 1] - med : 0xffffffffUL;
+        if (dl <= dr) {
+            d = dl;
+            l--;
+        }
+        else {
+            d = dr;
+            r++;
+        }
     }
-    /* TIM commutation event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_COM) != RESET)
+    return d;
+}
+
+/* @滤波：u32PluseCnt和*level为刚测到的一条，返回1时输出（可能已被改写的）u32PluseCnt和*level，返回0时这次不输出
+ * @中值：输出同电平最近window个宽度的中值
+ * @Hampel：窗口满后，与中值的偏差超过k×1.5×MAD（1.4826取1.5，且不小于min_us）的换成中值输出，窗口里放的仍是原值，
+ *  这样信号真的变了时，过半个窗口就会跟上
+ * @最小宽度：窄于min_us的是毛刺，连同它后面那一段一起并入前一段，输出推迟一条，高低电平仍交替 */
+static rt_uint8_t input_capture_filter_isr(struct stm32_capture_device* device, rt_uint8_t *level)
+{
+    struct input_capture_filter_window *w = &device->filt.win[*level & 1];
+    rt_uint32_t v = device->u32PluseCnt, med, dev, thresh;
+    rt_uint8_t out_level;
+
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+    /* 追踪的是原始边沿 */
+    if (input_capture_traced(device))
+        return 1;
+#endif
+    device->filt.stat.samples++;
+    switch (device->filt.type)
     {
-        __HAL_TIM_CLEAR_IT(&timer, TIM_FLAG_COM);
+    case INPUTCAPTURE_FILTER_MEDIAN:
+        input_capture_filter_window_put(w, device->filt.window, v);
+        device->u32PluseCnt = w->sorted[(w->filled - 1) / 2];
+        return 1;
+    case INPUTCAPTURE_FILTER_HAMPEL:
+        if (w->filled == device->filt.window) {
+            med = w->sorted[(w->filled - 1) / 2];
+            thresh = input_capture_filter_window_mad(w);
+            /* 超过约4s的MAD不再判断，避免乘法溢出 */
+            thresh = thresh < 0x400000UL ? thresh * device->filt.k_x10 * 3 / 20 : 0xffffffffUL;
+            if (thresh < device->filt.min_us)
+                thresh = device->filt.min_us;
+            dev = v > med ? v - med : med - v;
+            if (dev > thresh) {
+                device->u32PluseCnt = med;
+                device->filt.stat.rejected++;
+            }
+        }
+        input_capture_filter_window_put(w, device->filt.window, v);
+        return 1;
+    case INPUTCAPTURE_FILTER_MIN_WIDTH:
+        if (device->filt.absorbing) {// 毛刺之后这一段与毛刺之前那一段是同一个电平
+            device->filt.pending += v;
+            device->filt.absorbing = 0;
+            return 0;
+        }
+        if (!device->filt.has_pending) {
+            device->filt.pending = v;
+            device->filt.pending_level = *level;
+            device->filt.has_pending = 1;
+            return 0;
+        }
+        if (v < device->filt.min_us) {
+            device->filt.pending += v;
+            device->filt.absorbing = 1;
+            device->filt.stat.rejected++;
+            return 0;
+        }
+        out_level = device->filt.pending_level;
+        device->u32PluseCnt = device->filt.pending;
+        device->filt.pending = v;
+        device->filt.pending_level = *level;
+        *level = out_level;
+        return 1;
+    default:
+        return 1;
     }
-    /* leave interrupt */
-    rt_interrupt_leave();
 }
-#endif /* BSP_USING_TIMER3_CAPTURE */
 
-#ifdef BSP_USING_TIMER4_CAPTURE
-void TIM4_IRQHandler(void)
+/* 停滞时把最小宽度滤波推迟的那一条先输出 */
+static void input_capture_filter_flush(struct stm32_capture_device* device)
 {
-    /* enter interrupt */
-    rt_interrupt_enter();
-    TIM_HandleTypeDef timer;
-#if defined(TIMER4_CAPTURE_CHANNEL1)
-    input_capture_cc1_isr(&stm32_capture_obj[TIMER4_CAPTURE_CH1_INDEX]);
-    timer = stm32_capture_obj[TIMER4_CAPTURE_CH1_INDEX].timer;
+    if (!device->filt.has_pending)
+        return;
+    device->filt.has_pending = 0;
+    device->filt.absorbing = 0;
+    device->u32PluseCnt = device->filt.pending;
+    input_capture_edge_out(device, device->filt.pending_level);
+}
+#endif /* BSP_USING_INPUT_CAPTURE_FILTER */
+
+/* @捕获和溢出同时挂起时，中断里先处理捕获，这次溢出还没计入over_under_flowcount
+ * @捕获值在前半个周期说明边沿在溢出之后，返回1，要先补上这次溢出；在后半个周期则边沿在溢出之前，返回0 */
+rt_inline rt_uint32_t input_capture_wrap_pending(struct stm32_capture_device* device, rt_uint32_t cnt)
+{
+    TIM_TypeDef *tim = device->timer.Instance;
+
+    return (tim->SR & TIM_FLAG_UPDATE) && (tim->DIER & TIM_IT_UPDATE) && cnt < input_capture_wrap(device) / 2;
+}
+
+/* 各通道捕获到边沿后的公共处理，cnt为本次捕获值 */
+rt_inline void input_capture_edge_isr(struct stm32_capture_device* device, rt_uint32_t cnt)
+{
+    rt_uint8_t out_level;
+    rt_uint32_t early = input_capture_wrap_pending(device, cnt);
+
+    /* 补上的溢出在本次中断随后的溢出处理里不再计数：置为-1，加1后为0 */
+    device->over_under_flowcount += early;
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+    if (input_capture_traced(device))
+        device->trace_ticks += (rt_uint32_t)(cnt + input_capture_wrap(device) * device->over_under_flowcount - device->u32LastCnt);
 #endif
-#if defined(TIMER4_CAPTURE_CHANNEL2)
-    input_capture_cc2_isr(&stm32_capture_obj[TIMER4_CAPTURE_CH2_INDEX]);
-    timer = stm32_capture_obj[TIMER4_CAPTURE_CH2_INDEX].timer;
+#ifdef BSP_USING_INPUT_CAPTURE_RPM
+    if (device->mode == INPUTCAPTURE_MODE_RPM) {
+        input_capture_rpm_isr(device, cnt);
+        device->over_under_flowcount = 0 - early;
+        return;
+    }
 #endif
-#if defined(TIMER4_CAPTURE_CHANNEL3)
-    input_capture_cc3_isr(&stm32_capture_obj[TIMER4_CAPTURE_CH3_INDEX]);
-    timer = stm32_capture_obj[TIMER3_CAPTURE_CH3_INDEX].timer;
+    if(!device->not_first_edge){    //首次检测下降沿
+        device->not_first_edge = 1;
+        device->input_data_level = 0; // 因为首次采集的是低电平时间，同时也对应了开始时的下降沿检测
+    }else{
+        /* @对于32位定时器而言，1us计数下其周期能有1小时以上，不太可能计数溢出，因此这里的over_under_flowcount会等于0
+         * @对于16位定时器而言，可能会经常溢出，over_under_flowcount等于溢出次数
+         * @硬件级联的16位定时器捕获值已是32位，不开溢出中断，over_under_flowcount也等于0
+         * @因此这里的计算适合16位定时器、兼容32位定时器*/
+        device->u32PluseCnt = input_capture_ticks_to_us(device, cnt + input_capture_wrap(device) * device->over_under_flowcount - device->u32LastCnt);
+        out_level = device->input_data_level;
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+        if (device->filt.type == INPUTCAPTURE_FILTER_NONE || input_capture_filter_isr(device, &out_level))
 #endif
-#if defined(TIMER4_CAPTURE_CHANNEL4)
-    input_capture_cc4_isr(&stm32_capture_obj[TIMER4_CAPTURE_CH4_INDEX]);
-    timer = stm32_capture_obj[TIMER4_CAPTURE_CH4_INDEX].timer;
+        input_capture_edge_out(device, out_level);
+        device->input_data_level = !device->input_data_level;
+    }
+    if(device->input_data_level)
+        __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_FALLING);     //切换捕获极性
+    else
+        __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_RISING);    //切换捕获极性
+    device->over_under_flowcount = 0 - early;
+    device->u32LastCnt = cnt;
+}
+
+/* @普通模式下的停滞：放一条带INPUTCAPTURE_STALL_FLAG的记录，电平为当前保持的电平，宽度为距上一个边沿的时间
+ * @不管是否到水位线都通知读者，读者就不用自己再开定时器判断信号是否还在
+ * @计入单次捕获的个数，信号断了单次捕获也能完成；不进追踪流 */
+static void input_capture_stall_isr(struct stm32_capture_device* device)
+{
+    struct rt_device *dev = &device->parent.parent;
+    rt_uint32_t elapsed, len;
+    rt_uint64_t ticks;
+
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+    if (input_capture_traced(device))
+        return;
 #endif
-    /* TIM Update event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_UPDATE) != RESET)
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+    input_capture_filter_flush(device);
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+    /* 停滞前不满cycles个周期的也输出 */
+    input_capture_decimate_flush(device);
+#endif
+    /* 上面输出的记录已经让单次捕获完成了 */
+    if (!(device->timer.Instance->DIER & input_capture_ch_it(device->ch)))
+        return;
+    /* 溢出中断里计数值刚回到0 */
+    ticks = (rt_uint64_t)input_capture_wrap(device) * device->over_under_flowcount - device->u32LastCnt;
+    if (ticks > 0xffffffffUL)
+        ticks = 0xffffffffUL;
+    elapsed = input_capture_ticks_to_us(device, (rt_uint32_t)ticks);// 与pwm共用时计数比1us快，换算后再限幅
+    if (elapsed > INPUTCAPTURE_STALL_US_MASK)
+        elapsed = INPUTCAPTURE_STALL_US_MASK;
+    device->u32PluseCnt = INPUTCAPTURE_STALL_FLAG | elapsed;
+    if (!device->not_first_edge)// 打开后还没有过边沿，不知道是高还是低
+        device->u32PluseCnt |= INPUTCAPTURE_STALL_NO_LEVEL;
+#ifdef BSP_USING_INPUT_CAPTURE_FANOUT
+    if (device->fan.buf != RT_NULL) {
+        input_capture_fanout_put(device, device->not_first_edge ? device->input_data_level : 0, 1);
+        input_capture_oneshot_count(device);
+        return;
+    }
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+    input_capture_latency_stamp(device);
+#endif
+    rt_hw_inputcapture_isr(&device->parent, device->not_first_edge ? device->input_data_level : 0);
+
+    len = rt_ringbuffer_data_len(device->parent.ringbuff) / sizeof(struct rt_inputcapture_data);
+    if (len < device->parent.watermark && dev->rx_indicate != RT_NULL)
+        dev->rx_indicate(dev, len);
+    input_capture_oneshot_count(device);
+}
+
+/* 定时器溢出时对该定时器上的每个通道调用 */
+rt_inline void input_capture_overflow_isr(struct stm32_capture_device* device)
+{
+    /* 为0说明这次溢出已经在捕获处理里补上，溢出之后有过边沿，不是停滞 */
+    if (++device->over_under_flowcount == 0)
+        return;
+    if (device->stall_overflows == 0 || device->over_under_flowcount % device->stall_overflows != 0)
+        return;
+    /* 没在捕获（未打开或单次捕获已完成）的通道不报告 */
+    if (!(device->timer.Instance->DIER & input_capture_ch_it(device->ch)))
+        return;
+#ifdef BSP_USING_INPUT_CAPTURE_RPM
+    if (device->mode == INPUTCAPTURE_MODE_RPM) {
+        input_capture_rpm_stall_isr(device);
+        return;
+    }
+#endif
+    input_capture_stall_isr(device);
+}
+
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+/* 当前位置：上次采样的位置加上之后的计数变化 */
+rt_inline rt_int32_t input_capture_encoder_position(struct stm32_capture_device* device, rt_uint32_t cnt)
+{
+    return device->enc.position + (rt_int16_t)(cnt - device->enc.last_cnt);
+}
+
+/* @编码器的中断：CC1为A相上升沿（只在低速时打开），CC3为Z相
+ * @Z相脉冲放一条记录：pulsewidth_us为距上一个Z相脉冲的时间（us），is_high为方向（1正转，0反转） */
+static void input_capture_encoder_isr(struct stm32_capture_device* device)
+{
+    TIM_HandleTypeDef *tim = &device->timer;
+    rt_uint32_t now = DWT->CYCCNT;
+    rt_int32_t position;
+
+    if (__HAL_TIM_GET_FLAG(tim, TIM_FLAG_CC1) != RESET && __HAL_TIM_GET_IT_SOURCE(tim, TIM_IT_CC1) != RESET)
     {
-        if (__HAL_TIM_GET_IT_SOURCE(&timer, TIM_IT_UPDATE) != RESET)
+        __HAL_TIM_CLEAR_IT(tim, TIM_IT_CC1);
+        device->enc.edge_cyc_prev = device->enc.edge_cyc;
+        device->enc.edge_cnt_prev = device->enc.edge_cnt;
+        device->enc.edge_cyc = now;
+        device->enc.edge_cnt = tim->Instance->CCR1;
+        device->enc.edges++;
+    }
+    if (__HAL_TIM_GET_FLAG(tim, TIM_FLAG_CC3) != RESET && __HAL_TIM_GET_IT_SOURCE(tim, TIM_IT_CC3) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(tim, TIM_IT_CC3);
+        position = input_capture_encoder_position(device, tim->Instance->CCR3);
+        if (device->enc.index_seen) {
+            device->u32PluseCnt = (now - device->enc.index_cyc) / (SystemCoreClock / 1000000UL);
+            input_capture_push(device, position >= device->enc.index_position);
+        }
+        device->enc.index_seen = 1;
+        device->enc.index_cyc = now;
+        device->enc.index_position = position;
+        device->enc.index_count++;
+    }
+}
+
+/* @周期采样（硬定时器，在时钟中断中执行）：16位计数值扩展成32位位置并测速
+ * @一个周期内计数变化足够多时用计数差/周期，否则打开A相捕获中断，用相邻两个上升沿的间隔测速
+ * @低速时距上一个边沿的时间比上一个间隔还长，就按这段时间算，速度逐渐降到0 */
+static void input_capture_encoder_sample(void *parameter)
+{
+    struct stm32_capture_device* device = (struct stm32_capture_device*)parameter;
+    rt_uint32_t cnt, now, cyc, cyc_prev, edge_cnt, edge_cnt_prev, edges, period;
+    rt_int32_t diff;
+    rt_base_t level;
+
+    /* Z相中断会读position和last_cnt，两个一起更新 */
+    level = rt_hw_interrupt_disable();
+    cnt = __HAL_TIM_GET_COUNTER(&device->timer);
+    diff = (rt_int16_t)(cnt - device->enc.last_cnt);
+    device->enc.last_cnt = cnt;
+    device->enc.position += diff;
+    now = DWT->CYCCNT;
+    cyc = device->enc.edge_cyc;
+    cyc_prev = device->enc.edge_cyc_prev;
+    edge_cnt = device->enc.edge_cnt;
+    edge_cnt_prev = device->enc.edge_cnt_prev;
+    edges = device->enc.edges;
+    rt_hw_interrupt_enable(level);
+
+    if (diff >= INPUT_CAPTURE_ENCODER_LOW_COUNTS || diff <= -INPUT_CAPTURE_ENCODER_LOW_COUNTS) {
+        device->enc.velocity = diff * (1000 / INPUT_CAPTURE_ENCODER_PERIOD_MS);
+        if (device->enc.low_speed) {
+            device->enc.low_speed = 0;
+            __HAL_TIM_DISABLE_IT(&device->timer, TIM_IT_CC1);
+        }
+        return;
+    }
+    if (!device->enc.low_speed) {
+        /* 刚进入低速，先用本周期的计数差，等有两个边沿后再用边沿间隔 */
+        device->enc.low_speed = 1;
+        device->enc.edges = 0;
+        device->enc.velocity = diff * (1000 / INPUT_CAPTURE_ENCODER_PERIOD_MS);
+        __HAL_TIM_CLEAR_IT(&device->timer, TIM_IT_CC1);
+        __HAL_TIM_ENABLE_IT(&device->timer, TIM_IT_CC1);
+        return;
+    }
+    if (edges < 2) {
+        if (diff == 0)
+            device->enc.velocity = 0;
+        return;
+    }
+    period = cyc - cyc_prev;
+    if (now - cyc > period)
+        period = now - cyc;
+    if (period >= (rt_uint64_t)SystemCoreClock * INPUT_CAPTURE_ENCODER_STOP_MS / 1000) {
+        device->enc.velocity = 0;
+        return;
+    }
+    device->enc.velocity = (rt_int64_t)(rt_int16_t)(edge_cnt - edge_cnt_prev) * SystemCoreClock / period;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_ENCODER */
+
+void input_capture_cc1_isr(struct stm32_capture_device* device)
+{
+    /* Capture compare 1 event */
+    if (__HAL_TIM_GET_FLAG(&device->timer, TIM_FLAG_CC1) != RESET)
+    {
+        if (__HAL_TIM_GET_IT_SOURCE(&device->timer, TIM_IT_CC1) != RESET)
         {
-            __HAL_TIM_CLEAR_IT(&timer, TIM_IT_UPDATE);
-            for(rt_uint8_t i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
+            __HAL_TIM_CLEAR_IT(&device->timer, TIM_IT_CC1);
+#if defined(TIMER1_CAPTURE_CHANNEL1) || defined(TIMER2_CAPTURE_CHANNEL1) || defined(TIMER3_CAPTURE_CHANNEL1) || \
+        defined(TIMER4_CAPTURE_CHANNEL1) || defined(TIMER5_CAPTURE_CHANNEL1) || defined(TIMER8_CAPTURE_CHANNEL1) || \
+        defined(TIMER9_CAPTURE_CHANNEL1) || defined(TIMER10_CAPTURE_CHANNEL1) || defined(TIMER11_CAPTURE_CHANNEL1) || \
+        defined(TIMER12_CAPTURE_CHANNEL1) || defined(TIMER13_CAPTURE_CHANNEL1) || defined(TIMER14_CAPTURE_CHANNEL1)
+            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_1;
+            if ((device->timer.Instance->CCMR1 & TIM_CCMR1_CC1S) != 0x00U)// input capture
             {
-                if (stm32_capture_obj[i].timer.Instance == TIM4) {// 避免其他的TIM参数被修改
-                    stm32_capture_obj[i].over_under_flowcount++;
-                }
+                input_capture_edge_isr(device, input_capture_read_value(device));//获取当前的捕获值.
             }
+            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+#endif /* TIMERx_CAPTURE_CHANNEL1 */
         }
     }
-    /* TIM Break input event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_BREAK) != RESET)
+}
+void input_capture_cc2_isr(struct stm32_capture_device* device)
+{
+    /* Capture compare 2 event */
+    if (__HAL_TIM_GET_FLAG(&device->timer, TIM_FLAG_CC2) != RESET)
     {
-        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_BREAK);
+        if (__HAL_TIM_GET_IT_SOURCE(&device->timer, TIM_IT_CC2) != RESET)
+        {
+            __HAL_TIM_CLEAR_IT(&device->timer, TIM_IT_CC2);
+#if defined(TIMER1_CAPTURE_CHANNEL2) || defined(TIMER2_CAPTURE_CHANNEL2) || defined(TIMER3_CAPTURE_CHANNEL2) || \
+        defined(TIMER4_CAPTURE_CHANNEL2) || defined(TIMER5_CAPTURE_CHANNEL2) || defined(TIMER8_CAPTURE_CHANNEL2) || \
+        defined(TIMER9_CAPTURE_CHANNEL2) || defined(TIMER12_CAPTURE_CHANNEL2)
+            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_2;
+            if ((device->timer.Instance->CCMR1 & TIM_CCMR1_CC2S) != 0x00U)// input capture
+            {
+                input_capture_edge_isr(device, input_capture_read_value(device));//获取当前的捕获值.
+            }
+            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+#endif /* TIMERx_CAPTURE_CHANNEL2 */
+        }
     }
-    /* TIM Trigger detection event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_TRIGGER) != RESET)
+}
+void input_capture_cc3_isr(struct stm32_capture_device* device)
+{
+    /* Capture compare 3 event */
+    if (__HAL_TIM_GET_FLAG(&device->timer, TIM_FLAG_CC3) != RESET)
     {
-        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_TRIGGER);
+        if (__HAL_TIM_GET_IT_SOURCE(&device->timer, TIM_IT_CC3) != RESET)
+        {
+            __HAL_TIM_CLEAR_IT(&device->timer, TIM_IT_CC3);
+#if defined(TIMER1_CAPTURE_CHANNEL3) || defined(TIMER2_CAPTURE_CHANNEL3) || defined(TIMER3_CAPTURE_CHANNEL3) || \
+        defined(TIMER4_CAPTURE_CHANNEL3) || defined(TIMER5_CAPTURE_CHANNEL3) || defined(TIMER8_CAPTURE_CHANNEL3)
+            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_3;
+            if ((device->timer.Instance->CCMR2 & TIM_CCMR2_CC3S) != 0x00U)// input capture
+            {
+                input_capture_edge_isr(device, input_capture_read_value(device));//获取当前的捕获值.
+            }
+            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+#endif /* TIMERx_CAPTURE_CHANNEL3 */
+        }
     }
-    /* TIM commutation event */
-    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_COM) != RESET)
+}
+void input_capture_cc4_isr(struct stm32_capture_device* device)
+{
+    /* Capture compare 4 event */
+    if (__HAL_TIM_GET_FLAG(&device->timer, TIM_FLAG_CC4) != RESET)
     {
-        __HAL_TIM_CLEAR_IT(&timer, TIM_FLAG_COM);
-    }
-    /* leave interrupt */
-    rt_interrupt_leave();
+        if (__HAL_TIM_GET_IT_SOURCE(&device->timer, TIM_IT_CC4) != RESET)
+        {
+            __HAL_TIM_CLEAR_IT(&device->timer, TIM_IT_CC4);
+#if defined(TIMER1_CAPTURE_CHANNEL4) || defined(TIMER2_CAPTURE_CHANNEL4) || defined(TIMER3_CAPTURE_CHANNEL4) || \
+        defined(TIMER4_CAPTURE_CHANNEL4) || defined(TIMER5_CAPTURE_CHANNEL4) || defined(TIMER8_CAPTURE_CHANNEL4)
+            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_4;
+            if ((device->timer.Instance->CCMR2 & TIM_CCMR2_CC4S) != 0x00U)// input capture
+            {
+                input_capture_edge_isr(device, input_capture_read_value(device));//获取当前的捕获值.
+            }
+            device->timer.Channel = HAL_TIM_ACTIVE_CHANNEL_CLEARED;
+#endif /* TIMERx_CAPTURE_CHANNEL4 */
+        }
+    }
+}
+
+#ifdef BSP_USING_TIMER1_CAPTURE
+void TIM1_UP_IRQHandler(void)
+{
+    /* enter interrupt */
+    INPUT_CAPTURE_ISR_ENTER();
+    rt_interrupt_enter();
+    TIM_HandleTypeDef timer;
+#if defined(TIMER1_CAPTURE_CHANNEL1)
+    timer = stm32_capture_obj[TIMER1_CAPTURE_CH1_INDEX].timer;
+#elif defined(TIMER1_CAPTURE_CHANNEL2)
+    timer = stm32_capture_obj[TIMER1_CAPTURE_CH2_INDEX].timer;
+#elif defined(TIMER1_CAPTURE_CHANNEL3)
+    timer = stm32_capture_obj[TIMER1_CAPTURE_CH3_INDEX].timer;
+#elif defined(TIMER1_CAPTURE_CHANNEL4)
+    timer = stm32_capture_obj[TIMER1_CAPTURE_CH4_INDEX].timer;
+#endif
+    /* TIM Update event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_UPDATE) != RESET)
+    {
+        if (__HAL_TIM_GET_IT_SOURCE(&timer, TIM_IT_UPDATE) != RESET)
+        {
+            __HAL_TIM_CLEAR_IT(&timer, TIM_IT_UPDATE);
+            for(rt_uint8_t i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
+            {
+                if (stm32_capture_obj[i].timer.Instance == TIM1) {// 避免其他的TIM参数被修改
+                    input_capture_overflow_isr(&stm32_capture_obj[i]);
+                }
+            }
+        }
+    }
+    /* leave interrupt */
+    rt_interrupt_leave();
+    INPUT_CAPTURE_ISR_LEAVE();
+}
+void TIM1_CC_IRQHandler(void)
+{
+    /* enter interrupt */
+    INPUT_CAPTURE_ISR_ENTER();
+    rt_interrupt_enter();
+#if defined(TIMER1_CAPTURE_CHANNEL1)
+    input_capture_cc1_isr(&stm32_capture_obj[TIMER1_CAPTURE_CH1_INDEX]);
+#endif
+#if defined(TIMER1_CAPTURE_CHANNEL2)
+    input_capture_cc2_isr(&stm32_capture_obj[TIMER1_CAPTURE_CH2_INDEX]);
+#endif
+#if defined(TIMER1_CAPTURE_CHANNEL3)
+    input_capture_cc3_isr(&stm32_capture_obj[TIMER1_CAPTURE_CH3_INDEX]);
+#endif
+#if defined(TIMER1_CAPTURE_CHANNEL4)
+    input_capture_cc4_isr(&stm32_capture_obj[TIMER1_CAPTURE_CH4_INDEX]);
+#endif
+    /* leave interrupt */
+    rt_interrupt_leave();
+    INPUT_CAPTURE_ISR_LEAVE();
+}
+#endif /* BSP_USING_TIMER1_CAPTURE */
+
+#if defined(BSP_USING_TIMER2_CAPTURE) || defined(BSP_USING_TIMER2_ENCODER)
+void TIM2_IRQHandler(void)
+{
+    /* enter interrupt */
+    INPUT_CAPTURE_ISR_ENTER();
+    rt_interrupt_enter();
+    TIM_HandleTypeDef timer;
+#if defined(TIMER2_CAPTURE_CHANNEL1)
+    input_capture_cc1_isr(&stm32_capture_obj[TIMER2_CAPTURE_CH1_INDEX]);
+    timer = stm32_capture_obj[TIMER2_CAPTURE_CH1_INDEX].timer;
+#endif
+#if defined(TIMER2_CAPTURE_CHANNEL2)
+    input_capture_cc2_isr(&stm32_capture_obj[TIMER2_CAPTURE_CH2_INDEX]);
+    timer = stm32_capture_obj[TIMER2_CAPTURE_CH2_INDEX].timer;
+#endif
+#if defined(TIMER2_CAPTURE_CHANNEL3)
+    input_capture_cc3_isr(&stm32_capture_obj[TIMER2_CAPTURE_CH3_INDEX]);
+    timer = stm32_capture_obj[TIMER2_CAPTURE_CH3_INDEX].timer;
+#endif
+#if defined(TIMER2_CAPTURE_CHANNEL4)
+    input_capture_cc4_isr(&stm32_capture_obj[TIMER2_CAPTURE_CH4_INDEX]);
+    timer = stm32_capture_obj[TIMER2_CAPTURE_CH4_INDEX].timer;
+#endif
+#if defined(BSP_USING_TIMER2_ENCODER)
+    input_capture_encoder_isr(&stm32_capture_obj[TIMER2_ENCODER_INDEX]);
+    timer = stm32_capture_obj[TIMER2_ENCODER_INDEX].timer;
+#endif
+    /* TIM Update event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_UPDATE) != RESET)
+    {
+        if (__HAL_TIM_GET_IT_SOURCE(&timer, TIM_IT_UPDATE) != RESET)
+        {
+            __HAL_TIM_CLEAR_IT(&timer, TIM_IT_UPDATE);
+            for(rt_uint8_t i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
+            {
+                if (stm32_capture_obj[i].timer.Instance == TIM2) {// 避免其他的TIM参数被修改
+                    input_capture_overflow_isr(&stm32_capture_obj[i]);
+                }
+            }
+        }
+    }
+    /* TIM Break input event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_BREAK) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_BREAK);
+    }
+    /* TIM Trigger detection event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_TRIGGER) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_TRIGGER);
+    }
+    /* TIM commutation event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_COM) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(&timer, TIM_FLAG_COM);
+    }
+    /* leave interrupt */
+    rt_interrupt_leave();
+    INPUT_CAPTURE_ISR_LEAVE();
+}
+#endif /* BSP_USING_TIMER2_CAPTURE || BSP_USING_TIMER2_ENCODER */
+
+#if defined(BSP_USING_TIMER3_CAPTURE) || defined(BSP_USING_TIMER3_ENCODER)
+void TIM3_IRQHandler(void)
+{
+    /* enter interrupt */
+    INPUT_CAPTURE_ISR_ENTER();
+    rt_interrupt_enter();
+    TIM_HandleTypeDef timer;// 4个通道的timer句柄都一样，用哪个都行，条件编译是为了避免不知道使用了哪个通道
+#if defined(TIMER3_CAPTURE_CHANNEL1)
+    input_capture_cc1_isr(&stm32_capture_obj[TIMER3_CAPTURE_CH1_INDEX]);
+    timer = stm32_capture_obj[TIMER3_CAPTURE_CH1_INDEX].timer;
+#endif
+#if defined(TIMER3_CAPTURE_CHANNEL2)
+    input_capture_cc2_isr(&stm32_capture_obj[TIMER3_CAPTURE_CH2_INDEX]);
+    timer = stm32_capture_obj[TIMER3_CAPTURE_CH2_INDEX].timer;
+#endif
+#if defined(TIMER3_CAPTURE_CHANNEL3)
+    input_capture_cc3_isr(&stm32_capture_obj[TIMER3_CAPTURE_CH3_INDEX]);
+    timer = stm32_capture_obj[TIMER3_CAPTURE_CH3_INDEX].timer;
+#endif
+#if defined(TIMER3_CAPTURE_CHANNEL4)
+    input_capture_cc4_isr(&stm32_capture_obj[TIMER3_CAPTURE_CH4_INDEX]);
+    timer = stm32_capture_obj[TIMER3_CAPTURE_CH4_INDEX].timer;
+#endif
+#if defined(BSP_USING_TIMER3_ENCODER)
+    input_capture_encoder_isr(&stm32_capture_obj[TIMER3_ENCODER_INDEX]);
+    timer = stm32_capture_obj[TIMER3_ENCODER_INDEX].timer;
+#endif
+    /* TIM Update event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_UPDATE) != RESET)
+    {
+        if (__HAL_TIM_GET_IT_SOURCE(&timer, TIM_IT_UPDATE) != RESET)
+        {
+            __HAL_TIM_CLEAR_IT(&timer, TIM_IT_UPDATE);
+            for(rt_uint8_t i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
+            {
+                if (stm32_capture_obj[i].timer.Instance == TIM3) {// 避免其他的TIM参数被修改
+                    input_capture_overflow_isr(&stm32_capture_obj[i]);
+                }
+            }
+        }
+    }
+    /* TIM Break input event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_BREAK) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_BREAK);
+    }
+    /* TIM Trigger detection event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_TRIGGER) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_TRIGGER);
+    }
+    /* TIM commutation event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_COM) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(&timer, TIM_FLAG_COM);
+    }
+    /* leave interrupt */
+    rt_interrupt_leave();
+    INPUT_CAPTURE_ISR_LEAVE();
+}
+#endif /* BSP_USING_TIMER3_CAPTURE || BSP_USING_TIMER3_ENCODER */
+
+#if defined(BSP_USING_TIMER4_CAPTURE) || defined(BSP_USING_TIMER4_ENCODER)
+void TIM4_IRQHandler(void)
+{
+    /* enter interrupt */
+    INPUT_CAPTURE_ISR_ENTER();
+    rt_interrupt_enter();
+    TIM_HandleTypeDef timer;
+#if defined(TIMER4_CAPTURE_CHANNEL1)
+    input_capture_cc1_isr(&stm32_capture_obj[TIMER4_CAPTURE_CH1_INDEX]);
+    timer = stm32_capture_obj[TIMER4_CAPTURE_CH1_INDEX].timer;
+#endif
+#if defined(TIMER4_CAPTURE_CHANNEL2)
+    input_capture_cc2_isr(&stm32_capture_obj[TIMER4_CAPTURE_CH2_INDEX]);
+    timer = stm32_capture_obj[TIMER4_CAPTURE_CH2_INDEX].timer;
+#endif
+#if defined(TIMER4_CAPTURE_CHANNEL3)
+    input_capture_cc3_isr(&stm32_capture_obj[TIMER4_CAPTURE_CH3_INDEX]);
+    timer = stm32_capture_obj[TIMER4_CAPTURE_CH3_INDEX].timer;
+#endif
+#if defined(TIMER4_CAPTURE_CHANNEL4)
+    input_capture_cc4_isr(&stm32_capture_obj[TIMER4_CAPTURE_CH4_INDEX]);
+    timer = stm32_capture_obj[TIMER4_CAPTURE_CH4_INDEX].timer;
+#endif
+#if defined(BSP_USING_TIMER4_ENCODER)
+    input_capture_encoder_isr(&stm32_capture_obj[TIMER4_ENCODER_INDEX]);
+    timer = stm32_capture_obj[TIMER4_ENCODER_INDEX].timer;
+#endif
+    /* TIM Update event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_UPDATE) != RESET)
+    {
+        if (__HAL_TIM_GET_IT_SOURCE(&timer, TIM_IT_UPDATE) != RESET)
+        {
+            __HAL_TIM_CLEAR_IT(&timer, TIM_IT_UPDATE);
+            for(rt_uint8_t i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
+            {
+                if (stm32_capture_obj[i].timer.Instance == TIM4) {// 避免其他的TIM参数被修改
+                    input_capture_overflow_isr(&stm32_capture_obj[i]);
+                }
+            }
+        }
+    }
+    /* TIM Break input event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_BREAK) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_BREAK);
+    }
+    /* TIM Trigger detection event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_TRIGGER) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(&timer, TIM_IT_TRIGGER);
+    }
+    /* TIM commutation event */
+    if (__HAL_TIM_GET_FLAG(&timer, TIM_FLAG_COM) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(&timer, TIM_FLAG_COM);
+    }
+    /* leave interrupt */
+    rt_interrupt_leave();
+    INPUT_CAPTURE_ISR_LEAVE();
+}
+#endif /* BSP_USING_TIMER4_CAPTURE || BSP_USING_TIMER4_ENCODER */
+
+static rt_err_t stm32_capture_get_pulsewidth(struct rt_inputcapture_device *inputcapture, rt_uint32_t *pulsewidth_us)
+{
+    rt_err_t ret = RT_EOK;
+    struct stm32_capture_device *stm32_capture;
+    stm32_capture = (stm32_capture_device *)inputcapture;
+    *pulsewidth_us = stm32_capture->u32PluseCnt;
+    return -(ret);
+}
+
+/* APBx timer clocks frequency doubler state related to APB1CLKDivider value （从drv_pwm.c复制过来的）*/
+static void pclkx_doubler_get(rt_uint32_t *pclk1_doubler, rt_uint32_t *pclk2_doubler)
+{
+    //    rt_uint32_t flatency = 0;
+    uint32_t flatency = 0;
+    RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+
+    RT_ASSERT(pclk1_doubler != RT_NULL);
+    RT_ASSERT(pclk1_doubler != RT_NULL);
+
+    HAL_RCC_GetClockConfig(&RCC_ClkInitStruct, &flatency);
+
+    *pclk1_doubler = 1;
+    *pclk2_doubler = 1;
+
+#if defined(SOC_SERIES_STM32MP1)
+    if (RCC_ClkInitStruct.APB1_Div != RCC_APB1_DIV1)
+    {
+        *pclk1_doubler = 2;
+    }
+    if (RCC_ClkInitStruct.APB2_Div != RCC_APB2_DIV1)
+    {
+        *pclk2_doubler = 2;
+    }
+#else
+    if (RCC_ClkInitStruct.APB1CLKDivider != RCC_HCLK_DIV1)
+    {
+        *pclk1_doubler = 2;
+    }
+#if !defined(SOC_SERIES_STM32F0) && !defined(SOC_SERIES_STM32G0)
+    if (RCC_ClkInitStruct.APB2CLKDivider != RCC_HCLK_DIV1)
+    {
+        *pclk2_doubler = 2;
+    }
+#endif
+#endif
+}
+
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+/* 从定时器：外部时钟模式1，时钟为主定时器的TRGO（溢出） */
+static rt_err_t stm32_timer_chain_init(TIM_TypeDef *slave, rt_uint32_t itr)
+{
+    TIM_HandleTypeDef htim = {0};
+    TIM_SlaveConfigTypeDef sSlaveConfig = {0};
+
+    htim.Instance = slave;
+    htim.Init.Prescaler = 0;
+    htim.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim.Init.Period = 0xffff;
+    htim.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    if (HAL_TIM_Base_Init(&htim) != HAL_OK){
+        return -RT_ERROR;
+    }
+    sSlaveConfig.SlaveMode = TIM_SLAVEMODE_EXTERNAL1;
+    sSlaveConfig.InputTrigger = itr;
+    if (HAL_TIM_SlaveConfigSynchro(&htim, &sSlaveConfig) != HAL_OK){
+        return -RT_ERROR;
+    }
+    if (HAL_TIM_Base_Start(&htim) != HAL_OK){
+        return -RT_ERROR;
+    }
+    return RT_EOK;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_CHAIN */
+
+#ifdef BSP_USING_INPUT_CAPTURE_SYNC
+/* 从定时器的哪个ITR接同步主定时器的TRGO（F1/F4），返回0表示不是同步的从定时器 */
+static rt_uint8_t input_capture_sync_itr(TIM_TypeDef *slave, rt_uint32_t *itr)
+{
+    static const struct {
+        TIM_TypeDef *slave;
+        TIM_TypeDef *master;
+        rt_uint32_t itr;
+    } table[] = {
+        {TIM1, TIM2, TIM_TS_ITR1}, {TIM1, TIM3, TIM_TS_ITR2}, {TIM1, TIM4, TIM_TS_ITR3},
+        {TIM2, TIM3, TIM_TS_ITR2}, {TIM2, TIM4, TIM_TS_ITR3},
+        {TIM3, TIM2, TIM_TS_ITR1}, {TIM3, TIM4, TIM_TS_ITR3},
+        {TIM4, TIM2, TIM_TS_ITR1}, {TIM4, TIM3, TIM_TS_ITR2},
+    };
+
+    for (rt_uint8_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        if (table[i].slave == slave && table[i].master == INPUT_CAPTURE_SYNC_MASTER_TIM) {
+            *itr = table[i].itr;
+            return 1;
+        }
+    }
+    return 0;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_SYNC */
+
+static struct stm32_capture_timer *input_capture_timer_find(TIM_TypeDef *instance)
+{
+    for (struct stm32_capture_timer *group = stm32_capture_timer_obj; group->instance != RT_NULL; group++)
+    {
+        if (group->instance == instance)
+            return group;
+    }
+    return RT_NULL;
+}
+
+/* 定时器时钟：第一次用到时读RCC，之后用缓存的值（运行中改了系统时钟的话需要清零group->clock） */
+static rt_uint32_t input_capture_timer_clock(struct stm32_capture_timer *group)
+{
+    rt_uint32_t pclk1_doubler, pclk2_doubler;
+
+    if (group->clock)
+        return group->clock;
+    // 根据不同芯片类型和定时器类型确定定时器时钟频率
+    pclkx_doubler_get(&pclk1_doubler, &pclk2_doubler);
+#if defined(SOC_SERIES_STM32F4)
+    // 需要用到的其他部分需自行添加
+    if (group->instance == TIM1 || group->instance == TIM8 || group->instance == TIM9 || \
+            group->instance == TIM10 || group->instance == TIM11)
+#elif defined(SOC_SERIES_STM32F1)
+    if (group->instance == TIM1 || group->instance == TIM8)
+#else
+#error "need to add #elif by yourself(TIM_IC)."
+#endif
+        group->clock = (rt_uint32_t)(HAL_RCC_GetPCLK2Freq() * pclk2_doubler);// 挂在APB2定时器时钟上的定时器
+    else
+        group->clock = (rt_uint32_t)(HAL_RCC_GetPCLK1Freq() * pclk1_doubler);// 挂在APB1定时器时钟上的定时器
+    return group->clock;
+}
+
+/* 计数器一旦启动就不能随通道关闭而停：与pwm共用时pwm还在用；同步启动时从定时器是触发模式，停了HAL不会再启动它，而且计数也不再对齐 */
+rt_inline rt_uint8_t input_capture_keep_running(struct stm32_capture_device* device)
+{
+#if defined(BSP_USING_INPUT_CAPTURE_SYNC)
+    RT_UNUSED(device);
+    return 1;
+#elif defined(BSP_USING_INPUT_CAPTURE_SHARE_PWM)
+    return device->share_pwm;
+#else
+    RT_UNUSED(device);
+    return 0;
+#endif
+}
+
+/* 定时器的时基，每个定时器只在第一个通道初始化时调用一次，tim->Init.Prescaler已设好 */
+static rt_err_t stm32_capture_timer_bringup(struct stm32_capture_device* device)
+{
+    TIM_HandleTypeDef *tim = &device->timer;
+    TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+    TIM_MasterConfigTypeDef sMasterConfig = {0};
+    rt_uint8_t update_it = 1, sync_wait = 0;
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+    rt_uint32_t chain_itr = 0;
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_SYNC
+    TIM_SlaveConfigTypeDef sSlaveConfig = {0};
+    rt_uint32_t sync_itr = 0;
+#endif
+
+#ifdef BSP_USING_INPUT_CAPTURE_SHARE_PWM
+    /* @与pwm共用：定时器已由drv_pwm初始化，预分频和周期不动，只保证计数器在走、溢出中断打开
+     * @中断使能一般在cubemx生成的IC的msp函数里，pwm的msp函数没有，这里补上 */
+    if (device->share_pwm) {
+        __HAL_TIM_CLEAR_IT(tim, TIM_IT_UPDATE);
+        __HAL_TIM_ENABLE_IT(tim, TIM_IT_UPDATE);
+        __HAL_TIM_ENABLE(tim);
+        HAL_NVIC_EnableIRQ(device->irq);
+        return RT_EOK;
+    }
+#endif
+#if defined(SOC_SERIES_STM32F4)
+    if (tim->Instance == TIM2 || tim->Instance == TIM5) {
+        // F4系列的TIM2/5是32位定时器
+        tim->Init.Period = 0xffffffff;// 自动重装载值
+    }
+#elif defined(SOC_SERIES_STM32F1)
+    if (0) ; //F1系列定时器都是16位
+#else
+#error "need to add #elif by yourself(TIM_IC)."
+#endif
+    else {
+        tim->Init.Period = 0xffff;// 自动重装载值
+    }
+    tim->Init.CounterMode = TIM_COUNTERMODE_UP;
+    tim->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    tim->Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    /* @对于HAL_TIM_Base_Init和HAL_TIM_IC_Init调用顺序：
+     * @根据cubemx生成的相关的msp函数名称来决定，PWM驱动里也是如此
+     * @若是xxxICxxx则先调用HAL_TIM_IC_Init，若是xxxBasexxx则先调用HAL_TIM_Base_Init */
+    if (HAL_TIM_Base_Init(tim) != HAL_OK){
+        return -RT_ERROR;
+    }
+    if (HAL_TIM_IC_Init(tim) != HAL_OK){
+        return -RT_ERROR;
+    }
+    sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+    if (HAL_TIM_ConfigClockSource(tim, &sClockSourceConfig) != HAL_OK){
+        return -RT_ERROR;
+    }
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+    if (device->chain != RT_NULL) {
+        input_capture_chain_slave(tim->Instance, &chain_itr);
+        /* 溢出作为TRGO给从定时器计数，从定时器先启动，避免漏计 */
+        sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+        update_it = 0;
+        if (stm32_timer_chain_init(device->chain, chain_itr) != RT_EOK){
+            LOG_E("chain slave timer init failed");
+            return -RT_ERROR;
+        }
+    }
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_SYNC
+    /* @同步主定时器启动时由TRGO送出计数使能，其他捕获定时器为触发模式，收到后才开始计数
+     * @主定时器开主从模式，自己的计数也延迟到与从定时器同步 */
+    if (tim->Instance == INPUT_CAPTURE_SYNC_MASTER_TIM) {
+        sMasterConfig.MasterOutputTrigger = TIM_TRGO_ENABLE;
+        sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_ENABLE;
+    }
+    else if (input_capture_sync_itr(tim->Instance, &sync_itr)) {
+        sSlaveConfig.SlaveMode = TIM_SLAVEMODE_TRIGGER;
+        sSlaveConfig.InputTrigger = sync_itr;
+        if (HAL_TIM_SlaveConfigSynchro(tim, &sSlaveConfig) != HAL_OK){
+            return -RT_ERROR;
+        }
+        sync_wait = 1;
+    }
+#endif
+    if (HAL_TIMEx_MasterConfigSynchronization(tim, &sMasterConfig) != HAL_OK){
+        return -RT_ERROR;
+    }
+    __HAL_TIM_CLEAR_IT(tim, TIM_IT_UPDATE);
+    if (sync_wait) {
+        /* 触发模式由硬件置CEN，这里只开中断 */
+        if (update_it)
+            __HAL_TIM_ENABLE_IT(tim, TIM_IT_UPDATE);
+    }
+    else if (update_it) {
+        if(HAL_OK != HAL_TIM_Base_Start_IT(tim)){
+            return -RT_ERROR;
+        }
+    }
+    else {
+        if(HAL_OK != HAL_TIM_Base_Start(tim)){
+            return -RT_ERROR;
+        }
+    }
+    return RT_EOK;
+}
+
+/* @计数频率固定为1M次/s，自动重装载值固定为最大值
+ * @定时器的时基只在它的第一个通道上初始化一次（失败时下次打开再试），每个通道都要配置自己的输入 */
+static rt_err_t stm32_timer_capture_init(struct stm32_capture_device* device)
+{
+    struct stm32_capture_timer *group = device->group;
+    TIM_HandleTypeDef *tim = &device->timer;
+    TIM_IC_InitTypeDef sConfigIC = {0};
+    rt_uint32_t tim_clock;
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+    rt_uint32_t chain_itr = 0;
+#endif
+
+    if (group == RT_NULL) {
+        LOG_E("need to add %s's timer to stm32_capture_timer_obj", device->name);
+        return -RT_ERROR;
+    }
+    tim_clock = input_capture_timer_clock(group);
+    tim->Init.Prescaler = tim_clock / 1000000UL - 1;
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+    device->chain = input_capture_chain_slave(tim->Instance, &chain_itr);
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_SHARE_PWM
+    device->share_pwm = input_capture_share_pwm(tim->Instance);
+    device->clk_mhz = tim_clock / 1000000UL;
+#endif
+
+    if (!group->ready) {
+        if (stm32_capture_timer_bringup(device) != RT_EOK)
+            return -RT_ERROR;
+        group->ready = 1;
+    }
+#ifdef BSP_USING_INPUT_CAPTURE_SHARE_PWM
+    if (device->share_pwm) {
+        tim->Init.Prescaler = tim->Instance->PSC;
+        tim->Init.Period = tim->Instance->ARR;
+    }
+#endif
+
+    // 无论是否初始化都要配置通道
+    sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_FALLING;// 首次检测下降沿
+    sConfigIC.ICSelection = TIM_ICSELECTION_DIRECTTI;
+    sConfigIC.ICPrescaler = TIM_ICPSC_DIV1;
+    sConfigIC.ICFilter = 0;
+    if (HAL_TIM_IC_ConfigChannel(tim, &sConfigIC, device->ch) != HAL_OK){
+        return -RT_ERROR;
+    }
+
+    LOG_D("clock: %u, psc: %u, Period: %u", tim_clock, tim->Init.Prescaler + 1, tim->Init.Period);
+    return RT_EOK;
+}
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+/* 编码器模式：不分频，A/B相双边沿计数（4倍频），Z相在CH3上做上升沿捕获 */
+static rt_err_t stm32_timer_encoder_init(struct stm32_capture_device* device)
+{
+    TIM_HandleTypeDef *tim = &device->timer;
+    TIM_Encoder_InitTypeDef sConfig = {0};
+    TIM_MasterConfigTypeDef sMasterConfig = {0};
+    TIM_IC_InitTypeDef sConfigIC = {0};
+
+    tim->Init.Prescaler = 0;
+    tim->Init.CounterMode = TIM_COUNTERMODE_UP;
+    tim->Init.Period = 0xffff;// 32位定时器也按16位用，位置由周期采样扩展
+    tim->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    tim->Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    sConfig.EncoderMode = TIM_ENCODERMODE_TI12;
+    sConfig.IC1Polarity = TIM_ICPOLARITY_RISING;
+    sConfig.IC1Selection = TIM_ICSELECTION_DIRECTTI;
+    sConfig.IC1Prescaler = TIM_ICPSC_DIV1;
+    sConfig.IC1Filter = INPUT_CAPTURE_ENCODER_FILTER;
+    sConfig.IC2Polarity = TIM_ICPOLARITY_RISING;
+    sConfig.IC2Selection = TIM_ICSELECTION_DIRECTTI;
+    sConfig.IC2Prescaler = TIM_ICPSC_DIV1;
+    sConfig.IC2Filter = INPUT_CAPTURE_ENCODER_FILTER;
+    /* 需要cubemx把该定时器配置为Encoder Mode，生成HAL_TIM_Encoder_MspInit */
+    if (HAL_TIM_Encoder_Init(tim, &sConfig) != HAL_OK){
+        return -RT_ERROR;
+    }
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    if (HAL_TIMEx_MasterConfigSynchronization(tim, &sMasterConfig) != HAL_OK){
+        return -RT_ERROR;
+    }
+    if (device->enc_z) {
+        sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_RISING;
+        sConfigIC.ICSelection = TIM_ICSELECTION_DIRECTTI;
+        sConfigIC.ICPrescaler = TIM_ICPSC_DIV1;
+        sConfigIC.ICFilter = INPUT_CAPTURE_ENCODER_FILTER;
+        if (HAL_TIM_IC_ConfigChannel(tim, &sConfigIC, device->ch) != HAL_OK){
+            return -RT_ERROR;
+        }
+    }
+    /* DWT周期计数器，低速测速和Z相间隔用 */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    return RT_EOK;
+}
+
+static rt_err_t stm32_encoder_open(struct stm32_capture_device* device)
+{
+    rt_base_t level;
+
+    if (HAL_TIM_Encoder_Start(&device->timer, TIM_CHANNEL_ALL) != HAL_OK){
+        LOG_E("TIM_IC HAL_TIM_Encoder_Start Failed");
+        return -RT_ERROR;
+    }
+    level = rt_hw_interrupt_disable();
+    rt_memset(&device->enc, 0, (rt_uint8_t *)&device->enc.timer - (rt_uint8_t *)&device->enc);
+    device->enc.last_cnt = __HAL_TIM_GET_COUNTER(&device->timer);
+    device->oneshot_remain = 0;
+    rt_hw_interrupt_enable(level);
+    /* Z相通道不经过HAL的通道状态，直接开 */
+    if (device->enc_z) {
+        __HAL_TIM_CLEAR_IT(&device->timer, TIM_IT_CC3);
+        device->timer.Instance->CCER |= TIM_CCER_CC3E;
+        __HAL_TIM_ENABLE_IT(&device->timer, TIM_IT_CC3);
+    }
+    rt_timer_start(&device->enc.timer);
+    LOG_D("encoder dev open success");
+    return RT_EOK;
+}
+
+static rt_err_t stm32_encoder_close(struct stm32_capture_device* device)
+{
+    rt_timer_stop(&device->enc.timer);
+    __HAL_TIM_DISABLE_IT(&device->timer, TIM_IT_CC1 | TIM_IT_CC3);
+    device->timer.Instance->CCER &= ~TIM_CCER_CC3E;
+    HAL_TIM_Encoder_Stop(&device->timer, TIM_CHANNEL_ALL);
+    return RT_EOK;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_ENCODER */
+
+static rt_err_t stm32_capture_init(struct rt_inputcapture_device *inputcapture)
+{
+    RT_ASSERT(inputcapture != RT_NULL);
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+    if (((struct stm32_capture_device *)inputcapture)->encoder) {
+        if (stm32_timer_encoder_init((struct stm32_capture_device *)inputcapture) != RT_EOK){
+            LOG_E("Failed to initialize encoder.");
+            return -RT_ERROR;
+        }
+        return RT_EOK;
+    }
+#endif
+    if (stm32_timer_capture_init((struct stm32_capture_device *) inputcapture) != RT_EOK){
+        LOG_E("Failed to initialize TIMER.");
+        return -RT_ERROR;
+    }
+
+    LOG_D("tim_ic dev init success");
+    return RT_EOK;
+}
+static rt_err_t stm32_capture_open(struct rt_inputcapture_device *inputcapture)
+{
+    rt_uint32_t CCx = 0;
+    RT_ASSERT(inputcapture != RT_NULL);
+    struct stm32_capture_device* device = (struct stm32_capture_device*)inputcapture;
+    /* 中断优先级，同一定时器的通道共用一个中断，以最后打开的为准 */
+    if (device->irq_priority) {
+        HAL_NVIC_SetPriority(device->irq, device->irq_priority - 1, 0);
+#ifdef BSP_USING_TIMER1_CAPTURE
+        if (device->timer.Instance == TIM1)// TIM1的溢出是单独的中断
+            HAL_NVIC_SetPriority(TIM1_UP_IRQn, device->irq_priority - 1, 0);
+#endif
+    }
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+    if (device->encoder)
+        return stm32_encoder_open(device);
+#endif
+    device->not_first_edge = 0;
+    device->input_data_level = 0;
+    device->over_under_flowcount = 0;
+    device->u32LastCnt = 0;
+    device->oneshot_remain = 0;
+    __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_FALLING);
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+    /* 滤波设置保留，窗口重新开始 */
+    input_capture_filter_reset(device);
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+    device->decim.records = 0;
+    device->decim.count[0] = device->decim.count[1] = 0;
+    device->decim.sum[0] = device->decim.sum[1] = 0;
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_RPM
+    /* 测速模式在关闭后保留，重新打开时接着用 */
+    if (device->mode == INPUTCAPTURE_MODE_RPM) {
+        input_capture_rpm_reset(device);
+        __HAL_TIM_SET_ICPRESCALER(&device->timer, device->ch, device->rpm.icpsc);
+        __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_RISING);
+    }
+#endif
+    /* @通道的开关都直接写寄存器，不经过HAL_TIM_IC_Start_IT：
+     * @同一定时器上只有第一个通道的句柄经过了HAL的初始化（与pwm共用时一个都没有），其他通道句柄的通道状态不对，HAL会返回失败 */
+    CCx = input_capture_ch_it(device->ch);
+    if (CCx == 0) {
+        LOG_E("TIM_IC channel error");
+        return -RT_ERROR;
+    }
+    __HAL_TIM_CLEAR_IT(&device->timer, CCx);
+    device->timer.Instance->CCER |= TIM_CCER_CC1E << (device->ch & 0x1FU);
+    __HAL_TIM_ENABLE_IT(&device->timer, CCx);
+    /* 所有通道都关闭时计数器停了，这里重新启动 */
+    if (!input_capture_keep_running(device))
+        __HAL_TIM_ENABLE(&device->timer);
+    /* 之前的单次捕获可能把溢出中断关掉了 */
+    input_capture_enable_update(device);
+
+    LOG_D("tim_ic dev open success");
+    return RT_EOK;
+}
+static rt_err_t stm32_capture_close(struct rt_inputcapture_device *inputcapture)
+{
+    rt_err_t ret = RT_EOK;
+    RT_ASSERT(inputcapture != RT_NULL);
+    struct stm32_capture_device* device = (struct stm32_capture_device*)inputcapture;
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+    if (device->encoder)
+        return stm32_encoder_close(device);
+#endif
+    /* 与open一样直接写寄存器；定时器上没有通道在捕获时溢出中断也关掉 */
+    __HAL_TIM_DISABLE_IT(&device->timer, input_capture_ch_it(device->ch));
+    device->timer.Instance->CCER &= ~(TIM_CCER_CC1E << (device->ch & 0x1FU));
+    if ((device->timer.Instance->DIER & (TIM_IT_CC1 | TIM_IT_CC2 | TIM_IT_CC3 | TIM_IT_CC4)) == 0)
+        __HAL_TIM_DISABLE_IT(&device->timer, TIM_IT_UPDATE);
+    /* 与HAL_TIM_IC_Stop_IT一样，没有通道开着时停计数器（__HAL_TIM_DISABLE自己会检查）；计数器必须一直走的定时器不停 */
+    if (!input_capture_keep_running(device))
+        __HAL_TIM_DISABLE(&device->timer);
+    return ret;
+}
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+/* 把缓冲区中已有的数据写出，每次写一整段连续区域 */
+static void stm32_capture_trace_flush(struct stm32_capture_trace *trace)
+{
+    rt_uint32_t head, tail, len;
+    rt_ssize_t ret;
+
+    trace->kicked = 0;
+    head = trace->head;
+    tail = trace->tail;
+    while (tail != head)
+    {
+        len = head - tail;
+        if (len > INPUT_CAPTURE_TRACE_BUF_WORDS - (tail & TRACE_BUF_MASK))
+            len = INPUT_CAPTURE_TRACE_BUF_WORDS - (tail & TRACE_BUF_MASK);
+        ret = trace->write(trace->ctx, &trace->buf[tail & TRACE_BUF_MASK], len * sizeof(rt_uint32_t));
+        if (ret < 0) {
+            LOG_E("trace write failed(%d), data discarded", ret);
+        }
+        else {
+            trace->stat.bytes += ret;
+        }
+        /* 写失败也要丢掉，否则中断那边会一直满 */
+        tail += len;
+        trace->tail = tail;
+        head = trace->head;
+    }
+}
+
+static void stm32_capture_trace_thread_entry(void *parameter)
+{
+    struct stm32_capture_trace *trace = (struct stm32_capture_trace *)parameter;
+
+    while (trace->running)
+    {
+        rt_sem_take(&trace->kick_sem, rt_tick_from_millisecond(INPUT_CAPTURE_TRACE_FLUSH_MS));
+        stm32_capture_trace_flush(trace);
+    }
+    stm32_capture_trace_flush(trace);
+    rt_sem_release(&trace->exit_sem);
+}
+
+rt_err_t stm32_capture_trace_start(rt_uint32_t ch_mask, stm32_capture_trace_write_t write, void *ctx)
+{
+    struct stm32_capture_trace *trace = &stm32_capture_trace_obj;
+    rt_uint8_t header[IC_TRACE_HEADER_SIZE];
+    char name[IC_TRACE_NAME_LEN];
+    rt_uint32_t tick_hz = 1000000UL;
+    rt_thread_t thread;
+    rt_base_t level;
+
+    RT_ASSERT(write != RT_NULL);
+    if (trace->running) {
+        LOG_E("trace is already running");
+        return -RT_EBUSY;
+    }
+    ch_mask &= (1UL << (TIMER_CAPTURE_INDEX_MAX < IC_TRACE_CH_MAX ? TIMER_CAPTURE_INDEX_MAX : IC_TRACE_CH_MAX)) - 1;
+    if (ch_mask == 0)
+        return -RT_EINVAL;
+
+    /* 文件头，通道名按驱动通道表的顺序全部写出，记录中的通道号即下标 */
+    rt_memcpy(header, IC_TRACE_MAGIC, 4);
+    header[4] = IC_TRACE_VERSION & 0xff;
+    header[5] = IC_TRACE_VERSION >> 8;
+    header[6] = TIMER_CAPTURE_INDEX_MAX & 0xff;
+    header[7] = TIMER_CAPTURE_INDEX_MAX >> 8;
+    for (int i = 0; i < 4; i++)
+        header[8 + i] = (tick_hz >> (8 * i)) & 0xff;
+    if (write(ctx, header, sizeof(header)) != sizeof(header))
+        return -RT_EIO;
+    for (int i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
+    {
+        rt_memset(name, 0, sizeof(name));
+        rt_strncpy(name, stm32_capture_obj[i].name, sizeof(name) - 1);
+        if (write(ctx, name, sizeof(name)) != sizeof(name))
+            return -RT_EIO;
+    }
+
+    trace->head = trace->tail = 0;
+    trace->drop_pending = 0;
+    trace->kicked = 0;
+    rt_memset(&trace->stat, 0, sizeof(trace->stat));
+    trace->stat.bytes = IC_TRACE_HEADER_SIZE + IC_TRACE_NAME_LEN * TIMER_CAPTURE_INDEX_MAX;
+    trace->write = write;
+    trace->ctx = ctx;
+    rt_sem_init(&trace->kick_sem, "ictr_k", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&trace->exit_sem, "ictr_e", 0, RT_IPC_FLAG_FIFO);
+    trace->running = 1;
+
+    thread = rt_thread_create("ic_trace", stm32_capture_trace_thread_entry, trace,
+            INPUT_CAPTURE_TRACE_THREAD_STACK_SIZE, INPUT_CAPTURE_TRACE_THREAD_PRIORITY, 10);
+    if (thread == RT_NULL) {
+        trace->running = 0;
+        rt_sem_detach(&trace->kick_sem);
+        rt_sem_detach(&trace->exit_sem);
+        return -RT_ENOMEM;
+    }
+    rt_thread_startup(thread);
+    /* 定好各通道的时间起点后再开始，中间不能有边沿 */
+    level = rt_hw_interrupt_disable();
+    for (int i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
+    {
+        if (ch_mask & (1UL << i))
+            input_capture_trace_origin(&stm32_capture_obj[i]);
+    }
+    rt_memset(trace->sync_left, 0, sizeof(trace->sync_left));
+    trace->ch_mask = ch_mask;
+    rt_hw_interrupt_enable(level);
+    return RT_EOK;
 }
-#endif /* BSP_USING_TIMER4_CAPTURE */
 
-static rt_err_t stm32_capture_get_pulsewidth(struct rt_inputcapture_device *inputcapture, rt_uint32_t *pulsewidth_us)
+rt_err_t stm32_capture_trace_stop(void)
 {
-    rt_err_t ret = RT_EOK;
-    struct stm32_capture_device *stm32_capture;
-    stm32_capture = (stm32_capture_device *)inputcapture;
-    *pulsewidth_us = stm32_capture->u32PluseCnt;
-    return -(ret);
+    struct stm32_capture_trace *trace = &stm32_capture_trace_obj;
+
+    if (!trace->running)
+        return -RT_ERROR;
+    trace->ch_mask = 0;
+    trace->running = 0;
+    rt_sem_release(&trace->kick_sem);
+    rt_sem_take(&trace->exit_sem, RT_WAITING_FOREVER);
+    rt_sem_detach(&trace->kick_sem);
+    rt_sem_detach(&trace->exit_sem);
+    if (trace->drop_pending) {
+        LOG_W("trace stopped with %u edges dropped at the end", trace->drop_pending);
+    }
+    return RT_EOK;
 }
 
-/* APBx timer clocks frequency doubler state related to APB1CLKDivider value （从drv_pwm.c复制过来的）*/
-static void pclkx_doubler_get(rt_uint32_t *pclk1_doubler, rt_uint32_t *pclk2_doubler)
+void stm32_capture_trace_get_stat(struct stm32_capture_trace_stat *stat)
 {
-    //    rt_uint32_t flatency = 0;
-    uint32_t flatency = 0;
-    RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+    RT_ASSERT(stat != RT_NULL);
+    *stat = stm32_capture_trace_obj.stat;
+}
 
-    RT_ASSERT(pclk1_doubler != RT_NULL);
-    RT_ASSERT(pclk1_doubler != RT_NULL);
+rt_ssize_t stm32_capture_trace_device_write(void *ctx, const void *buf, rt_size_t size)
+{
+    rt_size_t done = 0;
+    rt_ssize_t ret;
 
-    HAL_RCC_GetClockConfig(&RCC_ClkInitStruct, &flatency);
+    /* 串口等设备可能一次写不完 */
+    while (done < size)
+    {
+        ret = rt_device_write((rt_device_t)ctx, 0, (const rt_uint8_t *)buf + done, size - done);
+        if (ret <= 0)
+            return done ? (rt_ssize_t)done : -RT_EIO;
+        done += ret;
+    }
+    return done;
+}
 
-    *pclk1_doubler = 1;
-    *pclk2_doubler = 1;
+#ifdef RT_USING_DFS
+rt_ssize_t stm32_capture_trace_fd_write(void *ctx, const void *buf, rt_size_t size)
+{
+    rt_size_t done = 0;
+    rt_ssize_t ret;
 
-#if defined(SOC_SERIES_STM32MP1)
-    if (RCC_ClkInitStruct.APB1_Div != RCC_APB1_DIV1)
+    while (done < size)
     {
-        *pclk1_doubler = 2;
+        ret = write((int)(rt_base_t)ctx, (const rt_uint8_t *)buf + done, size - done);
+        if (ret <= 0)
+            return done ? (rt_ssize_t)done : -RT_EIO;
+        done += ret;
     }
-    if (RCC_ClkInitStruct.APB2_Div != RCC_APB2_DIV1)
+    return done;
+}
+#endif /* RT_USING_DFS */
+
+#ifdef RT_USING_FINSH
+/* msh命令：ic_trace start <文件|设备> [通道名...] / ic_trace stop / ic_trace stat
+ * 不写通道名则追踪全部通道，追踪期间命令会帮忙打开对应的输入捕获设备 */
+static rt_device_t trace_msh_sink_dev = RT_NULL;
+static int trace_msh_sink_fd = -1;
+static rt_uint32_t trace_msh_opened = 0;
+
+static void ic_trace_msh_cleanup(void)
+{
+    for (int i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
     {
-        *pclk2_doubler = 2;
+        if (trace_msh_opened & (1UL << i))
+            rt_device_close(&stm32_capture_obj[i].parent.parent);
     }
-#else
-    if (RCC_ClkInitStruct.APB1CLKDivider != RCC_HCLK_DIV1)
-    {
-        *pclk1_doubler = 2;
+    trace_msh_opened = 0;
+    if (trace_msh_sink_dev != RT_NULL) {
+        rt_device_close(trace_msh_sink_dev);
+        trace_msh_sink_dev = RT_NULL;
     }
-#if !defined(SOC_SERIES_STM32F0) && !defined(SOC_SERIES_STM32G0)
-    if (RCC_ClkInitStruct.APB2CLKDivider != RCC_HCLK_DIV1)
-    {
-        *pclk2_doubler = 2;
+#ifdef RT_USING_DFS
+    if (trace_msh_sink_fd >= 0) {
+        close(trace_msh_sink_fd);
+        trace_msh_sink_fd = -1;
     }
 #endif
-#endif
 }
 
-/* 计数频率固定为1M次/s，自动重装载值固定为最大值 */
-static rt_err_t stm32_timer_capture_init(struct stm32_capture_device* device)
+static int ic_trace(int argc, char **argv)
 {
-    rt_uint8_t tim_init = 0;
-    static rt_uint8_t tim1_init = 0, tim8_init = 0, tim3_init = 0, tim4_init = 0, tim2_init = 0;
-    rt_uint32_t tim_clock, psc;
-    rt_uint32_t pclk1_doubler, pclk2_doubler;
-    TIM_HandleTypeDef *tim = RT_NULL;
-    TIM_ClockConfigTypeDef sClockSourceConfig = {0};
-    TIM_MasterConfigTypeDef sMasterConfig = {0};
-    TIM_IC_InitTypeDef sConfigIC = {0};
-
-    tim = (TIM_HandleTypeDef *)&device->timer;
+    struct stm32_capture_trace_stat stat;
+    rt_uint32_t mask = 0;
+    rt_err_t ret;
+    int index;
 
-    // 根据不同芯片类型和定时器类型确定定时器时钟频率
-    pclkx_doubler_get(&pclk1_doubler, &pclk2_doubler);
-
-#if defined(SOC_SERIES_STM32F4)
-    // 需要用到的其他部分需自行添加
-    if (tim->Instance == TIM1 || tim->Instance == TIM8 || tim->Instance == TIM9 || \
-            tim->Instance == TIM10 || tim->Instance == TIM11)
-#elif defined(SOC_SERIES_STM32F1)
-        if (tim->Instance == TIM1 || tim->Instance == TIM8)
-#else
-#error "need to add #elif by yourself(TIM_IC)."
-#endif
-        {// 挂在APB2定时器时钟上的定时器
-            tim_clock = (rt_uint32_t)(HAL_RCC_GetPCLK2Freq() * pclk2_doubler);
-            psc = tim_clock / 1000000UL;
-            /* 同一个定时器避免重复初始化, 但不同通道要配置，其他的定时器需自行定义 */
-            if     (tim->Instance == TIM1 && tim1_init == 0) { tim1_init = 1; tim_init = 1;}
-            else if(tim->Instance == TIM8 && tim8_init == 0) { tim8_init = 1; tim_init = 1;}
-            else {
-                LOG_W("need to add code by yourself(APB2)");
-                Error_Handler();
-            }
-            tim->Init.Prescaler = psc-1;
+    if (argc >= 3 && !rt_strcmp(argv[1], "start"))
+    {
+        if (stm32_capture_trace_obj.running) {
+            rt_kprintf("trace is already running\n");
+            return -1;
         }
-        else// 挂在APB1定时器时钟上的定时器
+        for (int i = 3; i < argc; i++)
         {
-            tim_clock = (rt_uint32_t)(HAL_RCC_GetPCLK1Freq() * pclk1_doubler);
-            psc = tim_clock / 1000000UL;
-            /* 同一个定时器避免重复初始化, 但不同通道要配置，其他的定时器需自行定义 */
-            if     (tim->Instance == TIM3 && tim3_init == 0) { tim3_init = 1; tim_init = 1;}
-            else if(tim->Instance == TIM2 && tim2_init == 0) { tim2_init = 1; tim_init = 1;}
-            else if(tim->Instance == TIM4 && tim4_init == 0) { tim4_init = 1; tim_init = 1;}
-            else {
-                LOG_E("need to add code by yourself(APB1)");
-                return -RT_ERROR;
+            index = stm32_capture_index(argv[i]);
+            if (index < 0 || index >= IC_TRACE_CH_MAX) {
+                rt_kprintf("unknown capture device: %s\n", argv[i]);
+                return -1;
             }
-            tim->Init.Prescaler = psc-1;
+            mask |= 1UL << index;
         }
+        if (mask == 0)
+            mask = 0xffffffffUL;
 
-    // 确认是否需要初始化
-    if(tim_init == 1) {
-#if defined(SOC_SERIES_STM32F4)
-        if (tim->Instance == TIM2 || tim->Instance == TIM5) {
-            // F4系列的TIM2/5是32位定时器
-            tim->Init.Period = 0xffffffff;// 自动重装载值
+        trace_msh_sink_dev = rt_device_find(argv[2]);
+        if (trace_msh_sink_dev != RT_NULL) {
+            if (rt_device_open(trace_msh_sink_dev, RT_DEVICE_OFLAG_WRONLY) != RT_EOK) {
+                rt_kprintf("open %s failed\n", argv[2]);
+                trace_msh_sink_dev = RT_NULL;
+                return -1;
+            }
+            ret = stm32_capture_trace_start(mask, stm32_capture_trace_device_write, trace_msh_sink_dev);
         }
-#elif defined(SOC_SERIES_STM32F1)
-        if (0) ; //F1系列定时器都是16位
+        else {
+#ifdef RT_USING_DFS
+            trace_msh_sink_fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0);
+            if (trace_msh_sink_fd < 0) {
+                rt_kprintf("open %s failed\n", argv[2]);
+                return -1;
+            }
+            ret = stm32_capture_trace_start(mask, stm32_capture_trace_fd_write, (void *)(rt_base_t)trace_msh_sink_fd);
 #else
-#error "need to add #elif by yourself(TIM_IC)."
+            rt_kprintf("device %s not found\n", argv[2]);
+            return -1;
 #endif
-        else {
-            tim->Init.Period = 0xffff;// 自动重装载值
-        }
-        tim->Init.CounterMode = TIM_COUNTERMODE_UP;
-        tim->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
-        tim->Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
-        /* @对于HAL_TIM_Base_Init和HAL_TIM_IC_Init调用顺序：
-         * @根据cubemx生成的相关的msp函数名称来决定，PWM驱动里也是如此
-         * @若是xxxICxxx则先调用HAL_TIM_IC_Init，若是xxxBasexxx则先调用HAL_TIM_Base_Init */
-        if (HAL_TIM_Base_Init(tim) != HAL_OK){
-            Error_Handler();
         }
-        if (HAL_TIM_IC_Init(tim) != HAL_OK){
-            Error_Handler();
+        if (ret != RT_EOK) {
+            rt_kprintf("trace start failed(%d)\n", ret);
+            ic_trace_msh_cleanup();
+            return -1;
         }
-        sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
-        if (HAL_TIM_ConfigClockSource(tim, &sClockSourceConfig) != HAL_OK){
-            Error_Handler();
-        }
-        sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
-        sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
-        if (HAL_TIMEx_MasterConfigSynchronization(tim, &sMasterConfig) != HAL_OK){
-            Error_Handler();
+        for (int i = 0; i < TIMER_CAPTURE_INDEX_MAX && i < IC_TRACE_CH_MAX; i++)
+        {
+            if ((mask & (1UL << i)) && rt_device_open(&stm32_capture_obj[i].parent.parent, RT_DEVICE_OFLAG_RDWR) == RT_EOK)
+                trace_msh_opened |= 1UL << i;
         }
-        if(HAL_OK != HAL_TIM_Base_Start_IT(tim)){
-            Error_Handler();
+    }
+    else if (argc == 2 && !rt_strcmp(argv[1], "stop"))
+    {
+        if (stm32_capture_trace_stop() != RT_EOK) {
+            rt_kprintf("trace is not running\n");
+            return -1;
         }
-        __HAL_TIM_CLEAR_IT(tim, TIM_IT_UPDATE);//
+        ic_trace_msh_cleanup();
+    }
+    else if (argc == 2 && !rt_strcmp(argv[1], "stat"))
+    {
+        stm32_capture_trace_get_stat(&stat);
+        rt_kprintf("running : %d\n", stm32_capture_trace_obj.running);
+        rt_kprintf("records : %u\n", stat.records);
+        rt_kprintf("dropped : %u\n", stat.dropped);
+        rt_kprintf("bytes   : %u\n", stat.bytes);
+        rt_kprintf("max used: %u/%u\n", stat.max_used, INPUT_CAPTURE_TRACE_BUF_WORDS);
+    }
+    else
+    {
+        rt_kprintf("Usage:\n");
+        rt_kprintf("ic_trace start <file|device> [capture_dev...]\n");
+        rt_kprintf("ic_trace stop\n");
+        rt_kprintf("ic_trace stat\n");
     }
+    return 0;
+}
+MSH_CMD_EXPORT(ic_trace, input capture binary trace);
+#endif /* RT_USING_FINSH */
+#endif /* BSP_USING_INPUT_CAPTURE_TRACE */
 
-    // 无论是否初始化都要配置通道
-    sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_FALLING;// 首次检测下降沿
-    sConfigIC.ICSelection = TIM_ICSELECTION_DIRECTTI;
-    sConfigIC.ICPrescaler = TIM_ICPSC_DIV1;
-    sConfigIC.ICFilter = 0;
-    if (HAL_TIM_IC_ConfigChannel(tim, &sConfigIC, device->ch) != HAL_OK){
-        Error_Handler();
+#ifdef BSP_USING_INPUT_CAPTURE_FANOUT
+rt_err_t stm32_capture_reader_attach(rt_device_t dev, struct stm32_capture_reader *reader)
+{
+    struct stm32_capture_device *device = (struct stm32_capture_device *)dev;
+    struct rt_inputcapture_data *buf = RT_NULL;
+    rt_base_t level;
+
+    RT_ASSERT(reader != RT_NULL);
+    if (device < stm32_capture_obj || device >= stm32_capture_obj + TIMER_CAPTURE_INDEX_MAX)
+        return -RT_EINVAL;
+    /* 先分配好，关中断期间只挂链表 */
+    if (device->fan.buf == RT_NULL) {
+        buf = rt_malloc(INPUT_CAPTURE_FANOUT_RECORDS * sizeof(struct rt_inputcapture_data));
+        if (buf == RT_NULL)
+            return -RT_ENOMEM;
+    }
+    rt_sem_init(&reader->sem, "icrd", 0, RT_IPC_FLAG_FIFO);
+    if (reader->watermark == 0)
+        reader->watermark = 1;
+    reader->overruns = 0;
+    reader->signalled = 0;
+    reader->device = device;
+
+    level = rt_hw_interrupt_disable();
+    if (device->fan.buf == RT_NULL) {
+        device->fan.buf = buf;
+        buf = RT_NULL;
     }
+    reader->cursor = device->fan.head;
+    reader->next = device->fan.readers;
+    device->fan.readers = reader;
+    rt_hw_interrupt_enable(level);
 
-    LOG_D("clock: %u, psc: %u, Period: %u", tim_clock, psc, tim->Init.Period);
+    if (buf != RT_NULL)// 别的线程抢先分配了
+        rt_free(buf);
     return RT_EOK;
 }
-static rt_err_t stm32_capture_init(struct rt_inputcapture_device *inputcapture)
+
+rt_err_t stm32_capture_reader_detach(struct stm32_capture_reader *reader)
 {
-    RT_ASSERT(inputcapture != RT_NULL);
-    if (stm32_timer_capture_init((struct stm32_capture_device *) inputcapture) != RT_EOK){
-        LOG_E("Failed to initialize TIMER.");
-        return -RT_ERROR;
+    struct stm32_capture_device *device;
+    struct stm32_capture_reader **pp;
+    struct rt_inputcapture_data *buf = RT_NULL;
+    rt_base_t level;
+
+    RT_ASSERT(reader != RT_NULL);
+    device = (struct stm32_capture_device *)reader->device;
+    if (device == RT_NULL)
+        return -RT_EINVAL;
+
+    level = rt_hw_interrupt_disable();
+    for (pp = &device->fan.readers; *pp != RT_NULL && *pp != reader; pp = &(*pp)->next);
+    if (*pp == RT_NULL) {
+        rt_hw_interrupt_enable(level);
+        return -RT_EINVAL;
     }
+    *pp = reader->next;
+    /* 最后一个读者走了，回到rt_inputcapture的环形缓冲区 */
+    if (device->fan.readers == RT_NULL) {
+        buf = device->fan.buf;
+        device->fan.buf = RT_NULL;
+    }
+    rt_hw_interrupt_enable(level);
 
-    LOG_D("tim_ic dev init success");
+    reader->device = RT_NULL;
+    rt_sem_detach(&reader->sem);
+    if (buf != RT_NULL)
+        rt_free(buf);
     return RT_EOK;
 }
-static rt_err_t stm32_capture_open(struct rt_inputcapture_device *inputcapture)
+
+/* 追上写位置，被覆盖的算作丢失 */
+rt_inline rt_uint32_t stm32_capture_reader_catch_up(struct stm32_capture_reader *reader, rt_uint32_t head)
 {
-    rt_uint32_t CCx = 0;
-    RT_ASSERT(inputcapture != RT_NULL);
-    struct stm32_capture_device* device = (struct stm32_capture_device*)inputcapture;
+    if (head - reader->cursor > INPUT_CAPTURE_FANOUT_RECORDS) {
+        reader->overruns += head - reader->cursor - INPUT_CAPTURE_FANOUT_RECORDS;
+        reader->cursor = head - INPUT_CAPTURE_FANOUT_RECORDS;
+    }
+    return head - reader->cursor;
+}
+
+rt_size_t stm32_capture_reader_read(struct stm32_capture_reader *reader, struct rt_inputcapture_data *buf, rt_size_t count)
+{
+    struct stm32_capture_device *device = (struct stm32_capture_device *)reader->device;
+    rt_uint32_t start, n, lost;
+
+    RT_ASSERT(device != RT_NULL && buf != RT_NULL);
+    n = stm32_capture_reader_catch_up(reader, device->fan.head);
+    if (n > count)
+        n = count;
+    start = reader->cursor;
+    for (rt_uint32_t i = 0; i < n; i++)
+        buf[i] = device->fan.buf[(start + i) & FANOUT_MASK];
+    reader->cursor = start + n;
+
+    /* 拷贝期间中断可能又覆盖了开头几条，这几条可能已经不完整，丢掉 */
+    lost = device->fan.head - start;
+    lost = lost > INPUT_CAPTURE_FANOUT_RECORDS ? lost - INPUT_CAPTURE_FANOUT_RECORDS : 0;
+    if (lost > n)
+        lost = n;
+    if (lost) {
+        reader->overruns += lost;
+        n -= lost;
+        rt_memmove(buf, buf + lost, n * sizeof(*buf));
+    }
+    return n;
+}
+
+rt_size_t stm32_capture_reader_peek(struct stm32_capture_reader *reader, const struct rt_inputcapture_data **span)
+{
+    struct stm32_capture_device *device = (struct stm32_capture_device *)reader->device;
+    rt_uint32_t n, pos;
+
+    RT_ASSERT(device != RT_NULL && span != RT_NULL);
+    n = stm32_capture_reader_catch_up(reader, device->fan.head);
+    pos = reader->cursor & FANOUT_MASK;
+    if (n > INPUT_CAPTURE_FANOUT_RECORDS - pos)
+        n = INPUT_CAPTURE_FANOUT_RECORDS - pos;
+    *span = &device->fan.buf[pos];
+    return n;
+}
+
+rt_err_t stm32_capture_reader_consume(struct stm32_capture_reader *reader, rt_size_t count)
+{
+    struct stm32_capture_device *device = (struct stm32_capture_device *)reader->device;
+    rt_uint32_t start = reader->cursor, over;
+
+    RT_ASSERT(device != RT_NULL);
+    reader->cursor = start + count;
+    over = device->fan.head - start;
+    if (over <= INPUT_CAPTURE_FANOUT_RECORDS)
+        return RT_EOK;
+    over -= INPUT_CAPTURE_FANOUT_RECORDS;
+    reader->overruns += over < count ? over : count;
+    return -RT_EFULL;
+}
+
+void stm32_capture_reader_clear(struct stm32_capture_reader *reader)
+{
+    struct stm32_capture_device *device = (struct stm32_capture_device *)reader->device;
+
+    RT_ASSERT(device != RT_NULL);
+    reader->cursor = device->fan.head;
+}
+
+rt_err_t stm32_capture_reader_wait(struct stm32_capture_reader *reader, rt_int32_t timeout)
+{
+    struct stm32_capture_device *device = (struct stm32_capture_device *)reader->device;
+    rt_uint32_t avail;
+    rt_base_t level;
+
+    RT_ASSERT(device != RT_NULL);
+    /* 先清掉上次留下的信号，再允许中断重新唤醒，最后看是不是已经够了 */
+    rt_sem_control(&reader->sem, RT_IPC_CMD_RESET, RT_NULL);
+    level = rt_hw_interrupt_disable();
+    reader->signalled = 0;
+    avail = device->fan.head - reader->cursor;
+    rt_hw_interrupt_enable(level);
+    if (avail >= reader->watermark)
+        return RT_EOK;
+    if (rt_sem_take(&reader->sem, timeout) != RT_EOK)
+        return -RT_ETIMEOUT;
+    return RT_EOK;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_FANOUT */
+
+/* @单次捕获：records为要交给上层的记录条数，为0时只停止捕获
+ * @普通模式下一条记录是一个脉宽（需要records+1个边沿），停滞记录也算；开了滤波、抽取或测速时按它们输出的记录计 */
+static rt_err_t stm32_capture_oneshot_arm(struct stm32_capture_device* device, rt_uint32_t records)
+{
+    rt_uint32_t CCx = input_capture_ch_it(device->ch);
+    rt_base_t level;
+
+    /* 先关中断再复位状态，避免与捕获中断交叉 */
+    level = rt_hw_interrupt_disable();
+    __HAL_TIM_DISABLE_IT(&device->timer, CCx);
+    device->oneshot_remain = 0;
+    rt_hw_interrupt_enable(level);
+    rt_sem_control(&device->oneshot_sem, RT_IPC_CMD_RESET, RT_NULL);
+    if (records == 0) {
+        if ((device->timer.Instance->DIER & (TIM_IT_CC1 | TIM_IT_CC2 | TIM_IT_CC3 | TIM_IT_CC4)) == 0)
+            __HAL_TIM_DISABLE_IT(&device->timer, TIM_IT_UPDATE);
+        return RT_EOK;
+    }
+
+    level = rt_hw_interrupt_disable();
     device->not_first_edge = 0;
     device->input_data_level = 0;
     device->over_under_flowcount = 0;
-    device->u32LastCnt = 0;
+    device->oneshot_remain = records;
     __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_FALLING);
-    if(HAL_OK != HAL_TIM_IC_Start_IT(&device->timer, device->ch)){
-        LOG_E("TIM_IC HAL_TIM_IC_Start_IT Failed");
-        return -RT_ERROR;
+    __HAL_TIM_CLEAR_IT(&device->timer, CCx);
+    input_capture_enable_update(device);
+    __HAL_TIM_ENABLE_IT(&device->timer, CCx);
+    rt_hw_interrupt_enable(level);
+    return RT_EOK;
+}
+
+/* 按当前一次溢出的时间换算（独占时为0x10000us），至少1次 */
+static rt_uint32_t input_capture_ms_to_overflows(struct stm32_capture_device* device, rt_uint32_t ms)
+{
+    rt_uint32_t overflow_us = input_capture_ticks_to_us(device, input_capture_wrap(device));
+
+    if (overflow_us == 0)
+        overflow_us = 1;
+    return ms ? ((rt_uint64_t)ms * 1000UL + overflow_us - 1) / overflow_us : 0;
+}
+
+#ifdef BSP_USING_INPUT_CAPTURE_RPM
+static rt_err_t stm32_capture_set_rpm(struct stm32_capture_device* device, struct inputcapture_rpm_config *cfg)
+{
+    rt_uint32_t CCx = input_capture_ch_it(device->ch);
+    rt_uint32_t icpsc = TIM_ICPSC_DIV1, div = 1;
+    rt_uint32_t enabled;
+    rt_base_t level;
+
+    if (cfg->pulses_per_rev != 0 && (cfg->window == 0 || cfg->window > INPUT_CAPTURE_RPM_WINDOW_MAX))
+        return -RT_EINVAL;
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+    if (cfg->pulses_per_rev != 0 && cfg->stall_timeout_ms != 0 && device->chain != RT_NULL)
+        return -RT_ENOSYS;// 停转检测靠溢出中断
+#endif
+    /* 每转脉冲数能被8/4/2整除时让硬件分频，减少中断次数 */
+    if (cfg->pulses_per_rev % 8 == 0) {
+        icpsc = TIM_ICPSC_DIV8;
+        div = 8;
     }
-    switch (device->ch) {
-    case TIM_CHANNEL_1:
-        CCx = TIM_IT_CC1;
-        break;
-    case TIM_CHANNEL_2:
-        CCx = TIM_IT_CC2;
-        break;
-    case TIM_CHANNEL_3:
-        CCx = TIM_IT_CC3;
+    else if (cfg->pulses_per_rev % 4 == 0) {
+        icpsc = TIM_ICPSC_DIV4;
+        div = 4;
+    }
+    else if (cfg->pulses_per_rev % 2 == 0) {
+        icpsc = TIM_ICPSC_DIV2;
+        div = 2;
+    }
+
+    level = rt_hw_interrupt_disable();
+    enabled = device->timer.Instance->DIER & CCx;
+    __HAL_TIM_DISABLE_IT(&device->timer, CCx);
+    rt_hw_interrupt_enable(level);
+
+    if (cfg->pulses_per_rev == 0) {
+        device->mode = INPUTCAPTURE_MODE_EDGE;
+        __HAL_TIM_SET_ICPRESCALER(&device->timer, device->ch, TIM_ICPSC_DIV1);
+        __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_FALLING);
+        device->not_first_edge = 0;
+        device->input_data_level = 0;
+    }
+    else {
+        device->mode = INPUTCAPTURE_MODE_RPM;
+        device->rpm.events_per_rev = cfg->pulses_per_rev / div;
+        device->rpm.window = cfg->window;
+        device->rpm.every_rev = cfg->every_rev;
+        device->stall_overflows = input_capture_ms_to_overflows(device, cfg->stall_timeout_ms);
+        device->rpm.icpsc = icpsc;
+        input_capture_rpm_reset(device);
+        __HAL_TIM_SET_ICPRESCALER(&device->timer, device->ch, icpsc);
+        __HAL_TIM_SET_CAPTUREPOLARITY(&device->timer, device->ch, TIM_INPUTCHANNELPOLARITY_RISING);
+    }
+    device->over_under_flowcount = 0;
+
+    if (enabled) {
+        __HAL_TIM_CLEAR_IT(&device->timer, CCx);
+        __HAL_TIM_ENABLE_IT(&device->timer, CCx);
+    }
+    return RT_EOK;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_RPM */
+
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+static rt_err_t stm32_capture_set_filter(struct stm32_capture_device* device, struct inputcapture_filter_config *cfg)
+{
+    rt_base_t level;
+
+    switch (cfg->type)
+    {
+    case INPUTCAPTURE_FILTER_NONE:
+    case INPUTCAPTURE_FILTER_MIN_WIDTH:
         break;
-    case TIM_CHANNEL_4:
-        CCx = TIM_IT_CC4;
+    case INPUTCAPTURE_FILTER_HAMPEL:
+    case INPUTCAPTURE_FILTER_MEDIAN:
+        if (cfg->type == INPUTCAPTURE_FILTER_HAMPEL && cfg->k_x10 == 0)
+            return -RT_EINVAL;
+        if (cfg->window < 3 || cfg->window > INPUT_CAPTURE_FILTER_WINDOW_MAX || (cfg->window & 1) == 0)
+            return -RT_EINVAL;
         break;
     default:
-        LOG_E("TIM_IC channel error");
-        return -RT_ERROR;
+        return -RT_EINVAL;
     }
-    __HAL_TIM_CLEAR_IT(&device->timer, CCx);
 
-    LOG_D("tim_ic dev open success");
+    level = rt_hw_interrupt_disable();
+    device->filt.type = cfg->type;
+    device->filt.window = cfg->window;
+    device->filt.k_x10 = cfg->k_x10;
+    device->filt.min_us = cfg->min_us;
+    device->filt.stat.samples = 0;
+    device->filt.stat.rejected = 0;
+    input_capture_filter_reset(device);
+    rt_hw_interrupt_enable(level);
     return RT_EOK;
 }
-static rt_err_t stm32_capture_close(struct rt_inputcapture_device *inputcapture)
+#endif /* BSP_USING_INPUT_CAPTURE_FILTER */
+
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+/* @读记录，并统计每条从中断入口到现在的延迟；cycles不为RT_NULL时同时给出每条的时间戳
+ * @DWT周期差只在一圈之内有效，按tick看等了一圈以上的记录只计入overlimit，不进直方图 */
+static rt_ssize_t stm32_capture_latency_read(struct stm32_capture_device* device, void *buffer, rt_size_t size, rt_uint32_t *cycles)
+{
+    struct rt_ringbuffer *rb = device->parent.ringbuff;
+    struct inputcapture_latency_stat *stat = &device->lat.stat;
+    struct input_capture_latency_stamp *stamp;
+    rt_uint32_t slot, cap, now, us, v;
+    rt_tick_t now_tick;
+    rt_ssize_t n;
+    rt_uint8_t bin;
+
+    if (rb == RT_NULL)
+        return 0;
+    /* 中断只移动写位置，读之前的读位置就是读出的第一条的位置 */
+    cap = rb->buffer_size / sizeof(struct rt_inputcapture_data);
+    slot = rb->read_index / sizeof(struct rt_inputcapture_data);
+    n = stm32_capture_parent_read(&device->parent.parent, 0, buffer, size);
+    now = DWT->CYCCNT;
+    now_tick = rt_tick_get();
+    for (rt_ssize_t i = 0; i < n; i++)
+    {
+        stamp = &device->lat.stamps[slot];
+        if (++slot >= cap)
+            slot = 0;
+        if (cycles != RT_NULL)
+            cycles[i] = stamp->cyc;
+        if (now_tick - stamp->tick >= device->lat.limit_ticks) {
+            stat->overlimit++;
+            continue;
+        }
+        us = (now - stamp->cyc) / device->lat.cyc_per_us;
+        for (bin = 0, v = us >> 1; v != 0 && bin < INPUTCAPTURE_LATENCY_BINS - 1; v >>= 1)
+            bin++;
+        stat->bins[bin]++;
+        stat->count++;
+        if (us > stat->max_us)
+            stat->max_us = us;
+    }
+    return n;
+}
+
+static rt_ssize_t stm32_capture_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    struct stm32_capture_device* device = (struct stm32_capture_device*)dev;
+
+    if (device->lat.stamps == RT_NULL)
+        return stm32_capture_parent_read(dev, pos, buffer, size);
+    return stm32_capture_latency_read(device, buffer, size, RT_NULL);
+}
+
+static rt_err_t stm32_capture_set_latency(struct stm32_capture_device* device, rt_uint32_t enable)
+{
+    struct input_capture_latency_stamp *stamps;
+    rt_uint32_t now;
+    rt_tick_t now_tick;
+    rt_base_t level;
+
+    if (!enable) {
+        level = rt_hw_interrupt_disable();
+        stamps = device->lat.stamps;
+        device->lat.stamps = RT_NULL;
+        rt_hw_interrupt_enable(level);
+        rt_free(stamps);
+        return RT_EOK;
+    }
+    stamps = device->lat.stamps;
+    if (stamps == RT_NULL) {
+        stamps = rt_malloc(RT_INPUT_CAPTURE_RB_SIZE * sizeof(struct input_capture_latency_stamp));
+        if (stamps == RT_NULL)
+            return -RT_ENOMEM;
+    }
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    /* 开启前已在缓冲区里的记录从现在开始算 */
+    now = DWT->CYCCNT;
+    now_tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < RT_INPUT_CAPTURE_RB_SIZE; i++)
+    {
+        stamps[i].cyc = now;
+        stamps[i].tick = now_tick;
+    }
+    device->lat.cyc_per_us = SystemCoreClock / 1000000UL;
+    if (device->lat.cyc_per_us == 0)
+        device->lat.cyc_per_us = 1;
+    /* tick只精确到一个，少算一个留余量 */
+    device->lat.limit_ticks = (rt_tick_t)((((rt_uint64_t)1 << 32) * RT_TICK_PER_SECOND) /
+            ((rt_uint64_t)device->lat.cyc_per_us * 1000000UL)) - 1;
+    rt_memset(&device->lat.stat, 0, sizeof(device->lat.stat));
+    level = rt_hw_interrupt_disable();
+    device->lat.stamps = stamps;
+    rt_hw_interrupt_enable(level);
+    return RT_EOK;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_LATENCY */
+
+static rt_err_t stm32_capture_control(rt_device_t dev, int cmd, void *args)
 {
+    struct stm32_capture_device* device = (struct stm32_capture_device*)dev;
     rt_err_t ret = RT_EOK;
-    RT_ASSERT(inputcapture != RT_NULL);
-    struct stm32_capture_device* device = (struct stm32_capture_device*)inputcapture;
-    HAL_TIM_IC_Stop_IT(&device->timer, device->ch);
+
+    RT_ASSERT(dev != RT_NULL);
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+    /* 其他驱动命令都是针对脉宽捕获的，编码器只能读状态 */
+    if (device->encoder && cmd >= INPUTCAPTURE_CMD_DRV_BASE && cmd != INPUTCAPTURE_CMD_ENCODER_GET)
+        return -RT_ENOSYS;
+#endif
+    switch (cmd)
+    {
+    case INPUTCAPTURE_CMD_ONESHOT_ARM:
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        if (!(dev->open_flag & RT_DEVICE_OFLAG_OPEN))
+            return -RT_ERROR;
+        ret = stm32_capture_oneshot_arm(device, *(rt_uint32_t *)args);
+        break;
+    case INPUTCAPTURE_CMD_ONESHOT_WAIT:
+        ret = rt_sem_take(&device->oneshot_sem, args ? *(rt_int32_t *)args : RT_WAITING_FOREVER);
+        if (ret != RT_EOK)
+            ret = -RT_ETIMEOUT;
+        break;
+    case INPUTCAPTURE_CMD_SET_STALL_TIMEOUT:
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+#ifdef BSP_USING_INPUT_CAPTURE_CHAIN
+        if (device->chain != RT_NULL && *(rt_uint32_t *)args != 0)
+            return -RT_ENOSYS;// 停滞检测靠溢出中断
+#endif
+        device->stall_overflows = input_capture_ms_to_overflows(device, *(rt_uint32_t *)args);
+        break;
+#ifdef BSP_USING_INPUT_CAPTURE_RPM
+    case INPUTCAPTURE_CMD_SET_RPM:
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        ret = stm32_capture_set_rpm(device, (struct inputcapture_rpm_config *)args);
+        break;
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+    case INPUTCAPTURE_CMD_SET_FILTER:
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        ret = stm32_capture_set_filter(device, (struct inputcapture_filter_config *)args);
+        break;
+    case INPUTCAPTURE_CMD_GET_FILTER_STAT:
+    {
+        rt_base_t level;
+
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        level = rt_hw_interrupt_disable();
+        *(struct inputcapture_filter_stat *)args = device->filt.stat;
+        rt_hw_interrupt_enable(level);
+        break;
+    }
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+    case INPUTCAPTURE_CMD_SET_DECIMATE:
+    {
+        rt_base_t level;
+
+        if (args == RT_NULL || *(rt_uint32_t *)args > INPUTCAPTURE_DECIMATE_MAX)
+            return -RT_EINVAL;
+        /* 已累计的丢掉，从下一条开始按新的周期数累计 */
+        level = rt_hw_interrupt_disable();
+        device->decim.cycles = *(rt_uint32_t *)args;
+        device->decim.records = 0;
+        device->decim.count[0] = device->decim.count[1] = 0;
+        device->decim.sum[0] = device->decim.sum[1] = 0;
+        rt_hw_interrupt_enable(level);
+        break;
+    }
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+    case INPUTCAPTURE_CMD_SET_LATENCY:
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        ret = stm32_capture_set_latency(device, *(rt_uint32_t *)args);
+        break;
+    case INPUTCAPTURE_CMD_GET_LATENCY:
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        *(struct inputcapture_latency_stat *)args = device->lat.stat;
+        break;
+    case INPUTCAPTURE_CMD_READ_STAMPED:
+    {
+        struct inputcapture_stamped_read *rd = (struct inputcapture_stamped_read *)args;
+
+        if (args == RT_NULL || rd->data == RT_NULL || rd->cycles == RT_NULL)
+            return -RT_EINVAL;
+        if (device->lat.stamps == RT_NULL)
+            return -RT_ERROR;
+        rd->read = stm32_capture_latency_read(device, rd->data, rd->count, rd->cycles);
+        break;
+    }
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+    case INPUTCAPTURE_CMD_ENCODER_GET:
+    {
+        struct inputcapture_encoder_state *state = (struct inputcapture_encoder_state *)args;
+        rt_base_t level;
+
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        if (!device->encoder)
+            return -RT_ENOSYS;
+        level = rt_hw_interrupt_disable();
+        state->position = input_capture_encoder_position(device, __HAL_TIM_GET_COUNTER(&device->timer));
+        state->velocity = device->enc.velocity;
+        state->index_position = device->enc.index_position;
+        state->index_count = device->enc.index_count;
+        state->low_speed = device->enc.low_speed;
+        rt_hw_interrupt_enable(level);
+        break;
+    }
+#endif
+    default:
+        ret = stm32_capture_parent_control(dev, cmd, args);
+        break;
+    }
     return ret;
 }
+
+#ifdef BSP_USING_INPUT_CAPTURE_SYNC
+/* @同步启动：注册完就把所有捕获定时器初始化好，从定时器先配置成等待触发，最后启动主定时器
+ * @各定时器从同一时刻开始计数，预分频相同（同在APB1上，都是1us），不同定时器的捕获值可以直接比较
+ * @之后打开设备时的初始化只配置通道，不会再复位计数器 */
+static rt_err_t stm32_capture_sync_start(void)
+{
+    struct stm32_capture_device *device;
+
+    for (rt_uint8_t pass = 0; pass < 2; pass++)
+    {
+        for (rt_uint8_t i = 0; i < TIMER_CAPTURE_INDEX_MAX; i++)
+        {
+            device = &stm32_capture_obj[i];
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+            if (device->encoder)
+                continue;
+#endif
+            /* 第一遍从定时器，第二遍主定时器 */
+            if ((device->timer.Instance == INPUT_CAPTURE_SYNC_MASTER_TIM) != pass)
+                continue;
+            if (!device->group->ready && stm32_timer_capture_init(device) != RT_EOK) {
+                LOG_E("%s sync init failed", device->name);
+                return -RT_ERROR;
+            }
+        }
+    }
+    return RT_EOK;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_SYNC */
+
 /* Init and register timer capture */
 static int stm32_timer_capture_device_init(void)
 {
@@ -781,11 +2861,43 @@ static int stm32_timer_capture_device_init(void)
     for (rt_uint8_t i = 0; i < sizeof(stm32_capture_obj) / sizeof(stm32_capture_obj[0]); i++){
         device = &stm32_capture_obj[i];
         device->parent.ops = &stm32_capture_ops;
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+        if (!device->encoder)
+#endif
+        device->group = input_capture_timer_find(device->timer.Instance);
         if (rt_device_inputcapture_register(&device->parent, stm32_capture_obj[i].name, device) != RT_EOK){
             LOG_E("%s register failed", stm32_capture_obj[i].name);
             return -RT_ERROR;
         }
+        /* 接管control，驱动自己的命令见drv_input_capture.h */
+#ifdef RT_USING_DEVICE_OPS
+        stm32_capture_parent_control = device->parent.parent.ops->control;
+        stm32_capture_dev_ops = *device->parent.parent.ops;
+        stm32_capture_dev_ops.control = stm32_capture_control;
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+        stm32_capture_parent_read = device->parent.parent.ops->read;
+        stm32_capture_dev_ops.read = stm32_capture_read;
+#endif
+        device->parent.parent.ops = &stm32_capture_dev_ops;
+#else
+        stm32_capture_parent_control = device->parent.parent.control;
+        device->parent.parent.control = stm32_capture_control;
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+        stm32_capture_parent_read = device->parent.parent.read;
+        device->parent.parent.read = stm32_capture_read;
+#endif
+#endif
+        rt_sem_init(&device->oneshot_sem, device->name, 0, RT_IPC_FLAG_FIFO);
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+        if (device->encoder)
+            rt_timer_init(&device->enc.timer, device->name, input_capture_encoder_sample, device,
+                    rt_tick_from_millisecond(INPUT_CAPTURE_ENCODER_PERIOD_MS), RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+#endif
     }
+#ifdef BSP_USING_INPUT_CAPTURE_SYNC
+    if (stm32_capture_sync_start() != RT_EOK)
+        return -RT_ERROR;
+#endif
     return 0;
 }
 INIT_DEVICE_EXPORT(stm32_timer_capture_device_init);
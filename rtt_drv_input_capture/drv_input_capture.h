@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ */
+
+/*
+ * drv_input_capture.c对应用层提供的扩展接口
+ * 基本的读写仍然走rt_inputcapture设备框架，这里只放框架之外的功能
+ */
+#ifndef DRIVERS_DRV_INPUT_CAPTURE_H_
+#define DRIVERS_DRV_INPUT_CAPTURE_H_
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef RT_USING_INPUT_CAPTURE
+
+/* 驱动自己的rt_device_control命令，接在rt_inputcapture框架的命令之后 */
+#define INPUTCAPTURE_CMD_DRV_BASE           (128 + 0x20)
+/* 单次捕获：args为rt_uint32_t *，交给上层这么多条记录后自动关闭该通道的捕获中断
+ * 计的是记录而不是边沿：普通模式下一条记录是一个脉宽（n条要n+1个边沿），停滞记录也算一条，
+ * 开了滤波、抽取或测速时按它们输出的记录计；设置了停滞超时时信号断了也会因停滞记录而完成，不会一直等；需要先打开设备，为0时立即停止捕获；关闭再打开设备后回到连续捕获 */
+#define INPUTCAPTURE_CMD_ONESHOT_ARM        (INPUTCAPTURE_CMD_DRV_BASE + 0)
+/* 等待单次捕获完成：args为rt_int32_t *超时时间（tick），RT_NULL表示一直等，超时返回-RT_ETIMEOUT */
+#define INPUTCAPTURE_CMD_ONESHOT_WAIT       (INPUTCAPTURE_CMD_DRV_BASE + 1)
+
+/* 测速模式：args为struct inputcapture_rpm_config *，pulses_per_rev为0时回到普通模式
+ * 测速模式下读到的记录：pulsewidth_us为平均每转的周期（us），is_high为1；
+ * 停转时给出一条pulsewidth_us为0、is_high为0的记录，之后有脉冲再重新开始平均 */
+#define INPUTCAPTURE_CMD_SET_RPM            (INPUTCAPTURE_CMD_DRV_BASE + 2)
+
+/* 停滞检测：args为rt_uint32_t *超时时间（ms），0关闭；精度为一次溢出（16位定时器约65.5ms）
+ * 超过这么久没有边沿，放一条停滞记录并通知读者（不受水位线限制），一直没有边沿则每隔这么久再放一条
+ * 停滞记录：pulsewidth_us带INPUTCAPTURE_STALL_FLAG，低位为距上一个边沿的时间（us），is_high为当前保持的电平
+ * 打开后一个边沿都没有时电平未知，另带INPUTCAPTURE_STALL_NO_LEVEL */
+#define INPUTCAPTURE_CMD_SET_STALL_TIMEOUT  (INPUTCAPTURE_CMD_DRV_BASE + 3)
+
+#define INPUTCAPTURE_STALL_FLAG             0x80000000UL
+#define INPUTCAPTURE_STALL_NO_LEVEL         0x40000000UL
+#define INPUTCAPTURE_STALL_US_MASK          0x3FFFFFFFUL
+#define INPUTCAPTURE_IS_STALL(data)         (((data)->pulsewidth_us & INPUTCAPTURE_STALL_FLAG) != 0)
+#define INPUTCAPTURE_STALL_US(data)         ((data)->pulsewidth_us & INPUTCAPTURE_STALL_US_MASK)
+
+/* 读编码器状态：args为struct inputcapture_encoder_state *，只对编码器设备（timx_enc）有效
+ * 编码器设备上的其他驱动命令返回-RT_ENOSYS；读到的记录为Z相脉冲，见readme */
+#define INPUTCAPTURE_CMD_ENCODER_GET        (INPUTCAPTURE_CMD_DRV_BASE + 4)
+
+struct inputcapture_encoder_state
+{
+    rt_int32_t  position;           // 位置（计数，4倍频），打开设备时为0
+    rt_int32_t  velocity;           // 速度（计数/s），正转为正
+    rt_int32_t  index_position;     // 最近一个Z相脉冲时的位置
+    rt_uint32_t index_count;        // 打开后的Z相脉冲个数
+    rt_uint8_t  low_speed;          // 1：当前按A相边沿间隔测速
+};
+
+/* 输出模式 */
+#define INPUTCAPTURE_MODE_EDGE              0   // 每个边沿输出一段高/低电平宽度（默认）
+#define INPUTCAPTURE_MODE_RPM               1   // 测速
+
+struct inputcapture_rpm_config
+{
+    rt_uint16_t pulses_per_rev;     // 每转脉冲数
+    rt_uint8_t  window;             // 平均的转数，1~INPUT_CAPTURE_RPM_WINDOW_MAX
+    rt_uint8_t  every_rev;          // 1：每转输出一次最近window转的滑动平均，0：每window转输出一次
+    rt_uint32_t stall_timeout_ms;   // 超过这么久没有脉冲报告停转，0不检测（与INPUTCAPTURE_CMD_SET_STALL_TIMEOUT是同一个设置）
+};
+
+/* 滤波：args为struct inputcapture_filter_config *，type为INPUTCAPTURE_FILTER_NONE时关闭
+ * 只对普通模式（每个边沿一条记录）生效，高、低电平的宽度分开滤波；停滞记录不滤波，被追踪的通道追踪的是原始边沿
+ * 设置后统计清零，关闭再打开设备时设置保留、窗口重新开始 */
+#define INPUTCAPTURE_CMD_SET_FILTER         (INPUTCAPTURE_CMD_DRV_BASE + 5)
+/* 读滤波统计：args为struct inputcapture_filter_stat * */
+#define INPUTCAPTURE_CMD_GET_FILTER_STAT    (INPUTCAPTURE_CMD_DRV_BASE + 6)
+
+#define INPUTCAPTURE_FILTER_NONE            0
+#define INPUTCAPTURE_FILTER_MEDIAN          1   // 输出最近window个同电平宽度的中值
+#define INPUTCAPTURE_FILTER_HAMPEL          2   // 偏离中值超过k×1.5×MAD的换成中值，其余原样输出
+#define INPUTCAPTURE_FILTER_MIN_WIDTH       3   // 窄于min_us的毛刺并入前一段，输出推迟一条
+
+struct inputcapture_filter_config
+{
+    rt_uint8_t  type;               // INPUTCAPTURE_FILTER_xxx
+    rt_uint8_t  window;             // 中值/Hampel的窗口长度，奇数，3~INPUT_CAPTURE_FILTER_WINDOW_MAX
+    rt_uint8_t  k_x10;              // Hampel的门限，MAD的倍数×10，常用30
+    rt_uint32_t min_us;             // 最小宽度：窄于此的是毛刺；Hampel：门限的下限，避免MAD为0时差1us就被替换
+};
+
+struct inputcapture_filter_stat
+{
+    rt_uint32_t samples;            // 进入滤波的记录数
+    rt_uint32_t rejected;           // Hampel：被替换成中值的个数；最小宽度：并掉的毛刺个数；中值：0
+};
+
+/* 抽取：args为rt_uint32_t *周期数N（0或1关闭，最大INPUTCAPTURE_DECIMATE_MAX）
+ * 驱动累计N个周期的高、低电平宽度，每N个周期只输出一对记录：平均高电平宽度（is_high为1）和平均低电平宽度（is_high为0），
+ * 环形缓冲区的写入、占用和读者被唤醒的次数都降为1/N；只对普通模式生效，在滤波之后，停滞时不满N个周期的也输出 */
+#define INPUTCAPTURE_CMD_SET_DECIMATE       (INPUTCAPTURE_CMD_DRV_BASE + 7)
+#define INPUTCAPTURE_DECIMATE_MAX           0x7fff
+
+/* 延迟统计：args为rt_uint32_t *，1开启（统计清零），0关闭；需要DWT周期计数器（M3及以上）
+ * 开启后每条放进环形缓冲区的记录都记下所在中断入口的DWT周期数，rt_device_read读出时统计从中断入口到读出的延迟
+ * （包括rx_indicate通知、线程被调度和读之前的处理），多读者和解码器的数据不统计；
+ * DWT周期数是32位的，一圈为2^32/主频（168MHz约25.6s），在缓冲区里等了一圈以上的记录算不出延迟，只计入overlimit */
+#define INPUTCAPTURE_CMD_SET_LATENCY        (INPUTCAPTURE_CMD_DRV_BASE + 8)
+/* 读延迟直方图：args为struct inputcapture_latency_stat * */
+#define INPUTCAPTURE_CMD_GET_LATENCY        (INPUTCAPTURE_CMD_DRV_BASE + 9)
+/* 带时间戳读：args为struct inputcapture_stamped_read *，与rt_device_read相同，另外给出每条的中断入口周期数（32位，会回绕），需先开启延迟统计 */
+#define INPUTCAPTURE_CMD_READ_STAMPED       (INPUTCAPTURE_CMD_DRV_BASE + 10)
+
+#define INPUTCAPTURE_LATENCY_BINS           16
+
+struct inputcapture_latency_stat
+{
+    rt_uint32_t count;              // 统计的记录数
+    rt_uint32_t max_us;             // 最大延迟（us）
+    rt_uint32_t bins[INPUTCAPTURE_LATENCY_BINS];// bins[0]：<2us，bins[k]：2^k~2^(k+1)us，最后一个包括更大的
+    rt_uint32_t overlimit;          // 等待超过DWT周期数一圈、算不出延迟的记录数，不计入上面各项
+};
+
+struct inputcapture_stamped_read
+{
+    struct rt_inputcapture_data *data;  // 读出的记录
+    rt_uint32_t *cycles;                // 每条记录的中断入口DWT周期数
+    rt_size_t   count;                  // 最多读几条
+    rt_size_t   read;                   // 实际读出的条数
+};
+
+/* 由每转周期（us）换算转速 */
+#define INPUTCAPTURE_PERIOD_TO_RPM(period_us)   ((period_us) ? 60000000UL / (period_us) : 0)
+
+/* 根据设备名获取其在驱动通道表中的下标，找不到返回-1 */
+int stm32_capture_index(const char *name);
+
+#ifdef BSP_USING_INPUT_CAPTURE_FANOUT
+/* @多读者：同一个设备的数据给多个线程各读各的（比如控制线程和记录线程）
+ * @中断只写一次共用缓冲区（INPUT_CAPTURE_FANOUT_RECORDS条），每个读者有自己的读位置、丢失计数和唤醒信号量，多一个读者中断里不多拷贝
+ * @设备上挂了读者后数据只进共用缓冲区，rt_device_read读不到（也不会因为没人读而报缓冲区满），最后一个读者摘下后恢复
+ * @读得太慢的读者被覆盖的记录计入overruns，不影响别的读者；读者之间互不清除 */
+struct stm32_capture_reader
+{
+    rt_uint32_t watermark;          // 未读的记录达到这么多条时唤醒stm32_capture_reader_wait，attach前设置，0按1；停滞记录不受限制
+    rt_uint32_t overruns;           // 没来得及读而被覆盖的记录数
+    /* 私有 */
+    rt_uint32_t cursor;             // 下一条要读的记录序号
+    volatile rt_uint8_t signalled;
+    struct rt_semaphore sem;
+    void *device;
+    struct stm32_capture_reader *next;
+};
+
+/* 挂上读者，从当前写位置开始读；设备需另外打开才有数据 */
+rt_err_t stm32_capture_reader_attach(rt_device_t dev, struct stm32_capture_reader *reader);
+rt_err_t stm32_capture_reader_detach(struct stm32_capture_reader *reader);
+/* 拷贝最多count条到buf，返回条数，不阻塞 */
+rt_size_t stm32_capture_reader_read(struct stm32_capture_reader *reader, struct rt_inputcapture_data *buf, rt_size_t count);
+/* 不拷贝：*span指向从读位置开始连续可读的一段，返回条数；用完后stm32_capture_reader_consume
+ * 用的过程中被覆盖时consume返回-RT_EFULL，这一段的数据不可信 */
+rt_size_t stm32_capture_reader_peek(struct stm32_capture_reader *reader, const struct rt_inputcapture_data **span);
+rt_err_t stm32_capture_reader_consume(struct stm32_capture_reader *reader, rt_size_t count);
+/* 丢掉本读者所有未读的记录（相当于只对自己的INPUTCAPTURE_CMD_CLEAR_BUF） */
+void stm32_capture_reader_clear(struct stm32_capture_reader *reader);
+/* 等到未读的记录达到水位线（或有停滞记录），超时返回-RT_ETIMEOUT */
+rt_err_t stm32_capture_reader_wait(struct stm32_capture_reader *reader, rt_int32_t timeout);
+#endif /* BSP_USING_INPUT_CAPTURE_FANOUT */
+
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+/* 追踪数据的输出函数，返回实际写入的字节数，小于0表示出错
+ * 可以是文件、管道或者串口设备，见下面两个现成的实现 */
+typedef rt_ssize_t (*stm32_capture_trace_write_t)(void *ctx, const void *buf, rt_size_t size);
+
+struct stm32_capture_trace_stat
+{
+    rt_uint32_t records;        // 已记录的边沿数
+    rt_uint32_t dropped;        // 缓冲区满而丢弃的边沿数
+    rt_uint32_t bytes;          // 已写出的字节数
+    rt_uint32_t max_used;       // 缓冲区最大使用量（记录字数）
+};
+
+/* 开始追踪ch_mask中的通道（bit i对应stm32_capture_index返回的下标i）
+ * 被追踪的通道的边沿只进入追踪流，不再进入rt_inputcapture的环形缓冲区
+ * 通道需处于打开状态才会有数据 */
+rt_err_t stm32_capture_trace_start(rt_uint32_t ch_mask, stm32_capture_trace_write_t write, void *ctx);
+/* 停止追踪，把缓冲区剩余的数据写完后返回 */
+rt_err_t stm32_capture_trace_stop(void);
+void stm32_capture_trace_get_stat(struct stm32_capture_trace_stat *stat);
+
+/* ctx为已打开的rt_device_t，例如串口 */
+rt_ssize_t stm32_capture_trace_device_write(void *ctx, const void *buf, rt_size_t size);
+#ifdef RT_USING_DFS
+/* ctx为文件描述符（强转为void*），文件或管道均可 */
+rt_ssize_t stm32_capture_trace_fd_write(void *ctx, const void *buf, rt_size_t size);
+#endif
+#endif /* BSP_USING_INPUT_CAPTURE_TRACE */
+
+#endif /* RT_USING_INPUT_CAPTURE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DRIVERS_DRV_INPUT_CAPTURE_H_ */
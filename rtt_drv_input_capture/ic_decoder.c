@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ */
+
+/*
+ * 解码框架：把解码器挂到输入捕获设备上，由一个解码线程服务所有挂了解码器的设备
+ * 解码线程直接拿设备环形缓冲区里从读位置开始的连续一段交给解码器，处理完再移动读位置，不拷贝数据
+ * 环形缓冲区只有中断在写、解码线程在读，移动读写位置时关中断（老版本ringbuffer的读写位置在同一个字里）
+ */
+#include <rtconfig.h>
+
+#if defined(RT_USING_INPUT_CAPTURE) && defined(BSP_USING_INPUT_CAPTURE_DECODER)
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "drv_config.h"
+#include "ic_decoder.h"
+
+#define LOG_TAG             "drv.tcap.dec"
+#include <drv_log.h>
+
+struct ic_decoder_port
+{
+    struct rt_inputcapture_device *dev;
+    struct ic_decoder *decoders;
+};
+
+static struct ic_decoder_port ic_decoder_ports[INPUT_CAPTURE_DECODER_PORT_MAX];
+static struct rt_event ic_decoder_event;
+static struct rt_mutex ic_decoder_lock;
+static rt_thread_t ic_decoder_thread = RT_NULL;
+
+/* 从读位置开始连续可读的记录，不移动读位置 */
+static rt_size_t ic_decoder_rb_span(struct rt_ringbuffer *rb, struct rt_inputcapture_data **span)
+{
+    rt_size_t len;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    len = rt_ringbuffer_data_len(rb);
+    if (len > (rt_size_t)(rb->buffer_size - rb->read_index))
+        len = rb->buffer_size - rb->read_index;
+    *span = (struct rt_inputcapture_data *)&rb->buffer_ptr[rb->read_index];
+    rt_hw_interrupt_enable(level);
+    return len / sizeof(struct rt_inputcapture_data);
+}
+
+static void ic_decoder_rb_consume(struct rt_ringbuffer *rb, rt_size_t count)
+{
+    rt_size_t len = count * sizeof(struct rt_inputcapture_data);
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (rb->read_index + len == (rt_size_t)rb->buffer_size) {
+        rb->read_mirror = ~rb->read_mirror;
+        rb->read_index = 0;
+    }
+    else {
+        rb->read_index += len;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+static void ic_decoder_port_process(struct ic_decoder_port *port)
+{
+    struct rt_ringbuffer *rb = port->dev->ringbuff;
+    struct rt_inputcapture_data *span;
+    struct ic_decoder *dec;
+    rt_size_t count;
+
+    if (rb == RT_NULL)
+        return;
+    /* 缓冲区回绕时分两段 */
+    while ((count = ic_decoder_rb_span(rb, &span)) != 0)
+    {
+        for (dec = port->decoders; dec != RT_NULL; dec = dec->next)
+            dec->ops->feed(dec, span, count);
+        ic_decoder_rb_consume(rb, count);
+    }
+}
+
+static rt_err_t ic_decoder_rx_ind(rt_device_t dev, rt_size_t size)
+{
+    RT_UNUSED(size);
+    for (int i = 0; i < INPUT_CAPTURE_DECODER_PORT_MAX; i++)
+    {
+        if ((rt_device_t)ic_decoder_ports[i].dev == dev) {
+            rt_event_send(&ic_decoder_event, 1UL << i);
+            break;
+        }
+    }
+    return RT_EOK;
+}
+
+static void ic_decoder_thread_entry(void *parameter)
+{
+    rt_uint32_t set;
+
+    RT_UNUSED(parameter);
+
+    while (1)
+    {
+        /* 没到水位线的数据也要定时处理，否则帧尾会一直留在缓冲区里 */
+        set = 0;
+        rt_event_recv(&ic_decoder_event, 0xffffffffUL, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                rt_tick_from_millisecond(INPUT_CAPTURE_DECODER_POLL_MS), &set);
+        rt_mutex_take(&ic_decoder_lock, RT_WAITING_FOREVER);
+        for (int i = 0; i < INPUT_CAPTURE_DECODER_PORT_MAX; i++)
+        {
+            if (ic_decoder_ports[i].dev != RT_NULL)
+                ic_decoder_port_process(&ic_decoder_ports[i]);
+        }
+        rt_mutex_release(&ic_decoder_lock);
+    }
+}
+
+rt_err_t ic_decoder_attach(rt_device_t dev, struct ic_decoder *dec)
+{
+    struct ic_decoder_port *port = RT_NULL, *empty = RT_NULL;
+    rt_err_t ret = RT_EOK;
+
+    RT_ASSERT(dev != RT_NULL);
+    RT_ASSERT(dec != RT_NULL);
+
+    rt_mutex_take(&ic_decoder_lock, RT_WAITING_FOREVER);
+    for (int i = 0; i < INPUT_CAPTURE_DECODER_PORT_MAX; i++)
+    {
+        if (ic_decoder_ports[i].dev == (struct rt_inputcapture_device *)dev)
+            port = &ic_decoder_ports[i];
+        else if (ic_decoder_ports[i].dev == RT_NULL && empty == RT_NULL)
+            empty = &ic_decoder_ports[i];
+    }
+    if (port == RT_NULL) {
+        if (empty == RT_NULL) {
+            LOG_E("no free decoder port, increase INPUT_CAPTURE_DECODER_PORT_MAX");
+            ret = -RT_EFULL;
+            goto _exit;
+        }
+        ret = rt_device_open(dev, RT_DEVICE_OFLAG_RDWR);
+        if (ret != RT_EOK)
+            goto _exit;
+        port = empty;
+        port->dev = (struct rt_inputcapture_device *)dev;
+        port->decoders = RT_NULL;
+        rt_device_set_rx_indicate(dev, ic_decoder_rx_ind);
+    }
+    dec->ops->reset(dec);
+    dec->next = port->decoders;
+    port->decoders = dec;
+    LOG_D("%s decoder attached to %s", dec->name, dev->parent.name);
+
+_exit:
+    rt_mutex_release(&ic_decoder_lock);
+    return ret;
+}
+
+rt_err_t ic_decoder_detach(rt_device_t dev, struct ic_decoder *dec)
+{
+    struct ic_decoder **pp;
+    rt_err_t ret = -RT_ERROR;
+
+    RT_ASSERT(dev != RT_NULL);
+    RT_ASSERT(dec != RT_NULL);
+
+    rt_mutex_take(&ic_decoder_lock, RT_WAITING_FOREVER);
+    for (int i = 0; i < INPUT_CAPTURE_DECODER_PORT_MAX; i++)
+    {
+        if (ic_decoder_ports[i].dev != (struct rt_inputcapture_device *)dev)
+            continue;
+        for (pp = &ic_decoder_ports[i].decoders; *pp != RT_NULL; pp = &(*pp)->next)
+        {
+            if (*pp == dec) {
+                *pp = dec->next;
+                dec->next = RT_NULL;
+                ret = RT_EOK;
+                break;
+            }
+        }
+        if (ic_decoder_ports[i].decoders == RT_NULL) {
+            rt_device_set_rx_indicate(dev, RT_NULL);
+            rt_device_close(dev);
+            ic_decoder_ports[i].dev = RT_NULL;
+        }
+        break;
+    }
+    rt_mutex_release(&ic_decoder_lock);
+    return ret;
+}
+
+static int ic_decoder_framework_init(void)
+{
+    rt_event_init(&ic_decoder_event, "ic_dec", RT_IPC_FLAG_FIFO);
+    rt_mutex_init(&ic_decoder_lock, "ic_dec", RT_IPC_FLAG_PRIO);
+    ic_decoder_thread = rt_thread_create("ic_dec", ic_decoder_thread_entry, RT_NULL,
+            INPUT_CAPTURE_DECODER_THREAD_STACK_SIZE, INPUT_CAPTURE_DECODER_THREAD_PRIORITY, 10);
+    if (ic_decoder_thread == RT_NULL) {
+        LOG_E("decoder thread create failed");
+        return -RT_ENOMEM;
+    }
+    rt_thread_startup(ic_decoder_thread);
+    return 0;
+}
+INIT_COMPONENT_EXPORT(ic_decoder_framework_init);
+
+#endif /* defined(RT_USING_INPUT_CAPTURE) && defined(BSP_USING_INPUT_CAPTURE_DECODER) */
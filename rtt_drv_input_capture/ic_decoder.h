@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ */
+
+/*
+ * 输入捕获协议解码框架
+ * 解码器挂到输入捕获设备上后，由解码线程直接在设备的环形缓冲区上成批解码（不拷贝），
+ * 解出一帧就调用on_frame回调（解码线程上下文）
+ * 挂了解码器的设备数据由解码线程消费，应用不要再rt_device_read/CLEAR_BUF
+ *
+ * 内置解码器见ic_decoder_builtin.c：PPM、NEC、RC5
+ * 解码器本身只依赖struct rt_inputcapture_data，定义IC_DECODER_HOST即可在上位机编译（见tools/ic_decoder_bench.c）
+ */
+#ifndef IC_DECODER_H_
+#define IC_DECODER_H_
+
+#ifdef IC_DECODER_HOST
+#include <stdint.h>
+#include <stddef.h>
+/* 与ic_kernels.h共用 */
+#ifndef IC_HOST_TYPES_DEFINED
+#define IC_HOST_TYPES_DEFINED
+typedef uint8_t     rt_uint8_t;
+typedef uint16_t    rt_uint16_t;
+typedef uint32_t    rt_uint32_t;
+typedef uint64_t    rt_uint64_t;
+typedef int32_t     rt_int32_t;
+typedef int         rt_bool_t;
+typedef size_t      rt_size_t;
+#define RT_NULL     NULL
+struct rt_inputcapture_data
+{
+    rt_uint32_t pulsewidth_us;
+    rt_bool_t   is_high;
+};
+#endif
+#else
+#include <rtthread.h>
+#include <rtdevice.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IC_FRAME_MAX_VALUES     16
+
+enum ic_frame_type
+{
+    IC_FRAME_PPM = 0,       // value[i]：第i通道脉宽（us），count为通道数
+    IC_FRAME_NEC,           // value[0]：地址（扩展NEC为16位），value[1]：命令
+    IC_FRAME_NEC_REPEAT,    // 重复码，value同上一帧
+    IC_FRAME_RC5,           // value[0]：地址，value[1]：命令（含RC5X第7位），value[2]：翻转位
+};
+
+struct ic_frame
+{
+    rt_uint8_t  type;
+    rt_uint8_t  count;
+    rt_uint16_t value[IC_FRAME_MAX_VALUES];
+};
+
+struct ic_decoder;
+typedef void (*ic_frame_cb_t)(struct ic_decoder *dec, const struct ic_frame *frame, void *user);
+
+struct ic_decoder_ops
+{
+    void (*reset)(struct ic_decoder *dec);
+    /* 一次处理一批连续的脉宽，span指向的数据只在调用期间有效 */
+    void (*feed)(struct ic_decoder *dec, const struct rt_inputcapture_data *span, rt_size_t count);
+};
+
+/* 各解码器在自己的结构体中把它作为第一个成员 */
+struct ic_decoder
+{
+    const char *name;
+    const struct ic_decoder_ops *ops;
+    ic_frame_cb_t on_frame;
+    void *user;
+    rt_uint8_t  active_level;   // 脉冲（mark）的电平：红外接收头一般低有效为0，PPM一般为1
+    rt_uint32_t frames;         // 解出的帧数
+    rt_uint32_t errors;         // 时序不符而丢弃的帧数
+    struct ic_decoder *next;    // 同一设备上的下一个解码器
+};
+
+/* PPM：相邻两个脉冲起点之间为一个通道，间隔大于sync_us为帧同步 */
+struct ic_ppm_decoder
+{
+    struct ic_decoder parent;
+    rt_uint16_t sync_us;        // 默认2700
+    rt_uint16_t min_us;         // 通道值范围，默认700~2300
+    rt_uint16_t max_us;
+    rt_uint8_t  min_channels;   // 少于这么多通道的帧丢弃，默认4
+    /* 私有 */
+    rt_uint8_t  synced;
+    rt_uint8_t  count;
+    rt_uint32_t mark;
+    rt_uint16_t value[IC_FRAME_MAX_VALUES];
+};
+
+/* NEC：9ms引导+4.5ms，32位LSB在前，9ms+2.25ms为重复码 */
+struct ic_nec_decoder
+{
+    struct ic_decoder parent;
+    /* 私有 */
+    rt_uint8_t  state;
+    rt_uint8_t  bits;
+    rt_uint8_t  have_mark;
+    rt_uint8_t  last_valid;
+    rt_uint32_t mark;
+    rt_uint32_t data;
+    struct ic_frame last;
+};
+
+/* RC5：曼彻斯特编码，半位889us，共14位 */
+struct ic_rc5_decoder
+{
+    struct ic_decoder parent;
+    /* 私有 */
+    rt_uint8_t  halves;         // 已收到的半位数
+    rt_uint8_t  gap;            // 之前有足够长的空闲，可以开始新的一帧
+    rt_uint32_t bits;           // 半位移位寄存器，1为mark
+};
+
+void ic_ppm_decoder_init(struct ic_ppm_decoder *dec, rt_uint8_t active_level, ic_frame_cb_t on_frame, void *user);
+void ic_nec_decoder_init(struct ic_nec_decoder *dec, rt_uint8_t active_level, ic_frame_cb_t on_frame, void *user);
+void ic_rc5_decoder_init(struct ic_rc5_decoder *dec, rt_uint8_t active_level, ic_frame_cb_t on_frame, void *user);
+
+/* 直接喂数据（不经过设备），上位机测试或应用自己读出的数据也可以用 */
+void ic_decoder_feed(struct ic_decoder *dec, const struct rt_inputcapture_data *span, rt_size_t count);
+void ic_decoder_reset(struct ic_decoder *dec);
+
+#ifndef IC_DECODER_HOST
+/* 把解码器挂到输入捕获设备上，设备会被打开，rx_indicate被解码框架接管
+ * 一个设备可以挂多个解码器，它们看到同样的数据 */
+rt_err_t ic_decoder_attach(rt_device_t dev, struct ic_decoder *dec);
+/* 摘下解码器，设备上最后一个解码器摘下时关闭设备 */
+rt_err_t ic_decoder_detach(rt_device_t dev, struct ic_decoder *dec);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IC_DECODER_H_ */
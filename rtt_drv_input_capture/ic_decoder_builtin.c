@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ */
+
+/*
+ * 内置协议解码器：PPM、NEC、RC5
+ * 输入是交替的高/低电平持续时间（us），即rt_hw_inputcapture_isr放进环形缓冲区的数据
+ * 这里只做纯计算，不调用rtthread的接口
+ */
+#ifdef IC_DECODER_HOST
+#include "ic_decoder.h"
+#else
+#include <rtconfig.h>
+#endif
+
+#if defined(IC_DECODER_HOST) || defined(BSP_USING_INPUT_CAPTURE_DECODER)
+#ifndef IC_DECODER_HOST
+#include "ic_decoder.h"
+#endif
+
+/* 与标称值相差30%以内 */
+static inline rt_bool_t ic_near(rt_uint32_t v, rt_uint32_t nominal)
+{
+    rt_uint32_t tol = nominal * 3 / 10;
+    return v + tol >= nominal && v <= nominal + tol;
+}
+
+static void ic_decoder_emit(struct ic_decoder *dec, const struct ic_frame *frame)
+{
+    dec->frames++;
+    if (dec->on_frame)
+        dec->on_frame(dec, frame, dec->user);
+}
+
+void ic_decoder_feed(struct ic_decoder *dec, const struct rt_inputcapture_data *span, rt_size_t count)
+{
+    dec->ops->feed(dec, span, count);
+}
+
+void ic_decoder_reset(struct ic_decoder *dec)
+{
+    dec->ops->reset(dec);
+}
+
+static void ic_decoder_base_init(struct ic_decoder *dec, const char *name, const struct ic_decoder_ops *ops,
+        rt_uint8_t active_level, ic_frame_cb_t on_frame, void *user)
+{
+    dec->name = name;
+    dec->ops = ops;
+    dec->on_frame = on_frame;
+    dec->user = user;
+    dec->active_level = active_level ? 1 : 0;
+    dec->frames = 0;
+    dec->errors = 0;
+    dec->next = RT_NULL;
+    ops->reset(dec);
+}
+
+/* PPM ------------------------------------------------------------------------*/
+static void ic_ppm_reset(struct ic_decoder *dec)
+{
+    struct ic_ppm_decoder *ppm = (struct ic_ppm_decoder *)dec;
+    ppm->synced = 0;
+    ppm->count = 0;
+    ppm->mark = 0;
+}
+
+static void ic_ppm_feed(struct ic_decoder *dec, const struct rt_inputcapture_data *span, rt_size_t count)
+{
+    struct ic_ppm_decoder *ppm = (struct ic_ppm_decoder *)dec;
+    struct ic_frame frame;
+    rt_uint32_t period;
+
+    for (rt_size_t i = 0; i < count; i++)
+    {
+        if ((span[i].is_high ? 1 : 0) == dec->active_level) {
+            ppm->mark = span[i].pulsewidth_us;
+            continue;
+        }
+        /* 一个通道 = 脉冲 + 其后的间隔 */
+        period = ppm->mark + span[i].pulsewidth_us;
+        ppm->mark = 0;
+        if (period >= ppm->sync_us) {
+            if (ppm->synced && ppm->count >= ppm->min_channels) {
+                frame.type = IC_FRAME_PPM;
+                frame.count = ppm->count;
+                for (rt_uint8_t c = 0; c < ppm->count; c++)
+                    frame.value[c] = ppm->value[c];
+                ic_decoder_emit(dec, &frame);
+            }
+            else if (ppm->synced) {
+                dec->errors++;
+            }
+            ppm->synced = 1;
+            ppm->count = 0;
+        }
+        else if (ppm->synced) {
+            if (period < ppm->min_us || period > ppm->max_us || ppm->count >= IC_FRAME_MAX_VALUES) {
+                /* 本帧作废，等下一个同步 */
+                dec->errors++;
+                ppm->synced = 0;
+            }
+            else {
+                ppm->value[ppm->count++] = (rt_uint16_t)period;
+            }
+        }
+    }
+}
+
+static const struct ic_decoder_ops ic_ppm_ops = { ic_ppm_reset, ic_ppm_feed };
+
+void ic_ppm_decoder_init(struct ic_ppm_decoder *dec, rt_uint8_t active_level, ic_frame_cb_t on_frame, void *user)
+{
+    dec->sync_us = 2700;
+    dec->min_us = 700;
+    dec->max_us = 2300;
+    dec->min_channels = 4;
+    ic_decoder_base_init(&dec->parent, "ppm", &ic_ppm_ops, active_level, on_frame, user);
+}
+
+/* NEC ------------------------------------------------------------------------*/
+#define NEC_LEADER_MARK     9000
+#define NEC_LEADER_SPACE    4500
+#define NEC_REPEAT_SPACE    2250
+#define NEC_BIT_MARK        560
+#define NEC_ZERO_SPACE      560
+#define NEC_ONE_SPACE       1690
+
+enum { NEC_IDLE = 0, NEC_DATA };
+
+static void ic_nec_reset(struct ic_decoder *dec)
+{
+    struct ic_nec_decoder *nec = (struct ic_nec_decoder *)dec;
+    nec->state = NEC_IDLE;
+    nec->bits = 0;
+    nec->have_mark = 0;
+    nec->last_valid = 0;
+    nec->data = 0;
+}
+
+/* 一个mark+space对 */
+static void ic_nec_pair(struct ic_nec_decoder *nec, rt_uint32_t mark, rt_uint32_t space)
+{
+    struct ic_decoder *dec = &nec->parent;
+    rt_uint8_t addr, addr_inv, cmd, cmd_inv;
+
+    if (nec->state == NEC_DATA) {
+        if (ic_near(mark, NEC_BIT_MARK) && (ic_near(space, NEC_ZERO_SPACE) || ic_near(space, NEC_ONE_SPACE))) {
+            if (space > (NEC_ZERO_SPACE + NEC_ONE_SPACE) / 2)
+                nec->data |= 1UL << nec->bits;
+            if (++nec->bits < 32)
+                return;
+            nec->state = NEC_IDLE;
+            addr = nec->data & 0xff;
+            addr_inv = (nec->data >> 8) & 0xff;
+            cmd = (nec->data >> 16) & 0xff;
+            cmd_inv = (nec->data >> 24) & 0xff;
+            if ((cmd ^ cmd_inv) != 0xff) {
+                dec->errors++;
+                nec->last_valid = 0;
+                return;
+            }
+            nec->last.type = IC_FRAME_NEC;
+            nec->last.count = 2;
+            /* 地址反码不对时按扩展NEC处理，地址为16位 */
+            nec->last.value[0] = ((addr ^ addr_inv) == 0xff) ? addr : (rt_uint16_t)(nec->data & 0xffff);
+            nec->last.value[1] = cmd;
+            nec->last_valid = 1;
+            ic_decoder_emit(dec, &nec->last);
+            return;
+        }
+        /* 数据位不对，看看是不是新的引导码 */
+        dec->errors++;
+        nec->state = NEC_IDLE;
+        nec->last_valid = 0;
+    }
+
+    if (!ic_near(mark, NEC_LEADER_MARK))
+        return;
+    if (ic_near(space, NEC_LEADER_SPACE)) {
+        nec->state = NEC_DATA;
+        nec->bits = 0;
+        nec->data = 0;
+    }
+    else if (ic_near(space, NEC_REPEAT_SPACE) && nec->last_valid) {
+        struct ic_frame repeat = nec->last;
+        repeat.type = IC_FRAME_NEC_REPEAT;
+        ic_decoder_emit(dec, &repeat);
+    }
+}
+
+static void ic_nec_feed(struct ic_decoder *dec, const struct rt_inputcapture_data *span, rt_size_t count)
+{
+    struct ic_nec_decoder *nec = (struct ic_nec_decoder *)dec;
+
+    for (rt_size_t i = 0; i < count; i++)
+    {
+        if ((span[i].is_high ? 1 : 0) == dec->active_level) {
+            nec->mark = span[i].pulsewidth_us;
+            nec->have_mark = 1;
+        }
+        else if (nec->have_mark) {
+            nec->have_mark = 0;
+            ic_nec_pair(nec, nec->mark, span[i].pulsewidth_us);
+        }
+    }
+}
+
+static const struct ic_decoder_ops ic_nec_ops = { ic_nec_reset, ic_nec_feed };
+
+void ic_nec_decoder_init(struct ic_nec_decoder *dec, rt_uint8_t active_level, ic_frame_cb_t on_frame, void *user)
+{
+    ic_decoder_base_init(&dec->parent, "nec", &ic_nec_ops, active_level, on_frame, user);
+}
+
+/* RC5 ------------------------------------------------------------------------*/
+/* @1 = 前半位空闲、后半位mark，0相反；第一位S1恒为1，其前半位与帧前空闲连在一起
+ * @因此帧开始时先补一个空闲半位，收满28个半位即一帧
+ * @最后一位为0时结尾的空闲半位也会和帧间空闲连在一起，收到第27个半位为mark时直接补上 */
+#define RC5_HALF_BIT        889
+#define RC5_HALVES          28
+
+static void ic_rc5_reset(struct ic_decoder *dec)
+{
+    struct ic_rc5_decoder *rc5 = (struct ic_rc5_decoder *)dec;
+    rc5->halves = 0;
+    rc5->bits = 0;
+    rc5->gap = 1;
+}
+
+static void ic_rc5_finish(struct ic_rc5_decoder *rc5)
+{
+    struct ic_decoder *dec = &rc5->parent;
+    struct ic_frame frame;
+    rt_uint32_t data = 0, pair;
+
+    /* bits的最高位是第一个半位 */
+    for (int i = 0; i < RC5_HALVES / 2; i++)
+    {
+        pair = (rc5->bits >> (RC5_HALVES - 2 - 2 * i)) & 0x3;
+        if (pair == 0x1)
+            data = (data << 1) | 1;
+        else if (pair == 0x2)
+            data = data << 1;
+        else {
+            dec->errors++;
+            return;
+        }
+    }
+    /* S1 S2 T A4..A0 C5..C0，S2取反是RC5X命令的第7位 */
+    frame.type = IC_FRAME_RC5;
+    frame.count = 3;
+    frame.value[0] = (data >> 6) & 0x1f;
+    frame.value[1] = (data & 0x3f) | ((((data >> 12) & 1) ^ 1) << 6);
+    frame.value[2] = (data >> 11) & 1;
+    ic_decoder_emit(dec, &frame);
+}
+
+static void ic_rc5_feed(struct ic_decoder *dec, const struct rt_inputcapture_data *span, rt_size_t count)
+{
+    struct ic_rc5_decoder *rc5 = (struct ic_rc5_decoder *)dec;
+    rt_uint32_t width, n;
+    rt_uint8_t mark;
+
+    for (rt_size_t i = 0; i < count; i++)
+    {
+        width = span[i].pulsewidth_us;
+        mark = (span[i].is_high ? 1 : 0) == dec->active_level;
+        if (width >= RC5_HALF_BIT / 2 && width < RC5_HALF_BIT * 3 / 2)
+            n = 1;
+        else if (width >= RC5_HALF_BIT * 3 / 2 && width < RC5_HALF_BIT * 5 / 2)
+            n = 2;
+        else
+            n = 0;
+
+        if (n == 0) {
+            if (rc5->halves)
+                dec->errors++;
+            rc5->halves = 0;
+            rc5->gap = !mark && width >= RC5_HALF_BIT * 5 / 2;
+            continue;
+        }
+        if (rc5->halves == 0) {
+            /* 只有长空闲之后的mark才能作为帧头 */
+            if (!mark || !rc5->gap) {
+                rc5->gap = 0;
+                continue;
+            }
+            rc5->bits = 0;
+            rc5->halves = 1;
+        }
+        while (n--)
+        {
+            rc5->bits = (rc5->bits << 1) | mark;
+            rc5->halves++;
+            if (rc5->halves == RC5_HALVES - 1 && mark) {
+                rc5->bits <<= 1;
+                rc5->halves++;
+            }
+            if (rc5->halves == RC5_HALVES) {
+                if (n == 0)
+                    ic_rc5_finish(rc5);
+                else
+                    dec->errors++;
+                rc5->halves = 0;
+                rc5->gap = 0;
+                break;
+            }
+        }
+    }
+}
+
+static const struct ic_decoder_ops ic_rc5_ops = { ic_rc5_reset, ic_rc5_feed };
+
+void ic_rc5_decoder_init(struct ic_rc5_decoder *dec, rt_uint8_t active_level, ic_frame_cb_t on_frame, void *user)
+{
+    ic_decoder_base_init(&dec->parent, "rc5", &ic_rc5_ops, active_level, on_frame, user);
+}
+
+#endif /* defined(IC_DECODER_HOST) || defined(BSP_USING_INPUT_CAPTURE_DECODER) */
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ */
+
+/*
+ * 输入捕获数据的批处理函数，说明见ic_kernels.h
+ * @SIMD部分用CMSIS的__USUB16/__SEL/__PKHBT，一个32位字装两个16位数
+ * @上位机定义IC_KERNELS_EMULATE_DSP时用C模拟这几条指令，可以在电脑上验证SIMD部分与普通实现结果一致
+ */
+#ifdef IC_KERNELS_HOST
+#include "ic_kernels.h"
+#else
+#include <rtconfig.h>
+#endif
+
+#if defined(IC_KERNELS_HOST) || defined(BSP_USING_INPUT_CAPTURE_KERNELS)
+#ifndef IC_KERNELS_HOST
+#include <board.h>
+#include "ic_kernels.h"
+#endif
+#include <string.h>
+
+#if defined(IC_KERNELS_EMULATE_DSP)
+/* GE标志，__USUB16设置，__SEL使用 */
+static rt_uint32_t ic_ge;
+
+static inline rt_uint32_t __USUB16(rt_uint32_t a, rt_uint32_t b)
+{
+    rt_uint32_t lo = (a & 0xffff) - (b & 0xffff);
+    rt_uint32_t hi = (a >> 16) - (b >> 16);
+    ic_ge = ((lo >> 31) ? 0 : 0x3) | ((hi >> 31) ? 0 : 0xc);
+    return (lo & 0xffff) | (hi << 16);
+}
+
+static inline rt_uint32_t __SEL(rt_uint32_t a, rt_uint32_t b)
+{
+    rt_uint32_t mask = ((ic_ge & 0x1) ? 0x0000ffffUL : 0) | ((ic_ge & 0x4) ? 0xffff0000UL : 0);
+    return (a & mask) | (b & ~mask);
+}
+
+static inline rt_uint32_t __PKHBT(rt_uint32_t a, rt_uint32_t b, int shift)
+{
+    return (a & 0xffff) | ((b << shift) & 0xffff0000UL);
+}
+#define IC_KERNELS_SIMD
+#elif defined(__ARM_FEATURE_DSP) && !defined(IC_KERNELS_HOST) && !defined(IC_KERNELS_PORTABLE)
+#define IC_KERNELS_SIMD
+#endif
+
+#ifdef IC_KERNELS_SIMD
+/* 16位数组不一定4字节对齐，M4/M7的LDR/STR支持非对齐访问，memcpy会被编译成一条指令 */
+static inline rt_uint32_t ic_load32(const void *p)
+{
+    rt_uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void ic_store32(void *p, rt_uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+#endif
+
+void ic_kernel_deltas_u16(const rt_uint16_t *ticks, rt_size_t n, rt_uint16_t *out)
+{
+    rt_size_t i = 0;
+
+    if (n < 2)
+        return;
+#ifdef IC_KERNELS_SIMD
+    if (n >= 4) {
+        /* a = t[i] | t[i+1]<<16，c = t[i+2] | t[i+3]<<16，b = t[i+1] | t[i+2]<<16，b - a一次得到两个差 */
+        rt_uint32_t a = ic_load32(&ticks[0]), b, c;
+        for (; i + 4 <= n; i += 2)
+        {
+            c = ic_load32(&ticks[i + 2]);
+            b = __PKHBT(a >> 16, c, 16);
+            ic_store32(&out[i], __USUB16(b, a));
+            a = c;
+        }
+    }
+#endif
+    for (; i + 1 < n; i++)
+        out[i] = (rt_uint16_t)(ticks[i + 1] - ticks[i]);
+}
+
+void ic_kernel_deltas_u32(const rt_uint32_t *ticks, rt_size_t n, rt_uint32_t *out)
+{
+    for (rt_size_t i = 0; i + 1 < n; i++)
+        out[i] = ticks[i + 1] - ticks[i];
+}
+
+rt_size_t ic_kernel_clamp_u16(rt_uint16_t *data, rt_size_t n, rt_uint16_t lo, rt_uint16_t hi)
+{
+    rt_size_t i = 0, clamped = 0;
+
+#ifdef IC_KERNELS_SIMD
+    rt_uint32_t lo2 = lo * 0x00010001UL, hi2 = hi * 0x00010001UL, x, y, diff;
+
+    for (; i + 2 <= n; i += 2)
+    {
+        x = ic_load32(&data[i]);
+        /* __SEL紧跟在__USUB16之后，用它设置的GE标志：先取max(x, lo)，再取min(y, hi) */
+        (void)__USUB16(x, lo2);
+        y = __SEL(x, lo2);
+        (void)__USUB16(hi2, y);
+        y = __SEL(y, hi2);
+        diff = x ^ y;
+        if (diff) {
+            clamped += ((diff & 0xffff) != 0) + ((diff >> 16) != 0);
+            ic_store32(&data[i], y);
+        }
+    }
+#endif
+    for (; i < n; i++)
+    {
+        if (data[i] < lo) {
+            data[i] = lo;
+            clamped++;
+        }
+        else if (data[i] > hi) {
+            data[i] = hi;
+            clamped++;
+        }
+    }
+    return clamped;
+}
+
+rt_size_t ic_kernel_period_duty(const struct rt_inputcapture_data *in, rt_size_t n,
+        struct ic_period_duty *out, rt_size_t *used)
+{
+    rt_size_t i = 0, count = 0;
+    rt_uint32_t high, low, period;
+
+    while (i + 1 < n)
+    {
+        /* 停滞记录的最高位为1（INPUTCAPTURE_STALL_FLAG） */
+        if (!in[i].is_high || (in[i].pulsewidth_us & 0x80000000UL)) {
+            i++;
+            continue;
+        }
+        if (in[i + 1].is_high || (in[i + 1].pulsewidth_us & 0x80000000UL)) {
+            i++;
+            continue;
+        }
+        high = in[i].pulsewidth_us;
+        low = in[i + 1].pulsewidth_us;
+        period = high + low;
+        out[count].period_us = period;
+        out[count].high_us = high;
+        /* 高电平不到0.43s时32位乘法不会溢出，避免64位除法（M3/M4上是库函数） */
+        if (period == 0)
+            out[count].duty = 0;
+        else if (high <= 0xffffffffUL / IC_KERNEL_DUTY_FULL)
+            out[count].duty = (rt_uint16_t)(high * IC_KERNEL_DUTY_FULL / period);
+        else
+            out[count].duty = (rt_uint16_t)((rt_uint64_t)high * IC_KERNEL_DUTY_FULL / period);
+        count++;
+        i += 2;
+    }
+    /* 最后一条是高电平时留着和下一批的低电平配对 */
+    if (i < n && !(in[i].is_high && !(in[i].pulsewidth_us & 0x80000000UL)))
+        i++;
+    if (used)
+        *used = i;
+    return count;
+}
+
+void ic_kernel_frequency(const struct ic_period_duty *in, rt_size_t n, rt_uint32_t *freq_mhz)
+{
+    for (rt_size_t i = 0; i < n; i++)
+        freq_mhz[i] = in[i].period_us ? 1000000000UL / in[i].period_us : 0;
+}
+
+rt_size_t ic_kernel_moving_average_u32(const rt_uint32_t *in, rt_size_t n, rt_uint8_t shift, rt_uint32_t *out)
+{
+    rt_size_t window = (rt_size_t)1 << shift, i;
+    rt_uint64_t sum = 0;
+
+    if (n < window)
+        return 0;
+    for (i = 0; i < window; i++)
+        sum += in[i];
+    out[0] = (rt_uint32_t)(sum >> shift);
+    for (i = window; i < n; i++)
+    {
+        sum += in[i];
+        sum -= in[i - window];
+        out[i - window + 1] = (rt_uint32_t)(sum >> shift);
+    }
+    return n - window + 1;
+}
+
+rt_size_t ic_kernel_reject_u32(const rt_uint32_t *in, rt_size_t n, rt_uint32_t lo, rt_uint32_t hi, rt_uint32_t *out)
+{
+    rt_size_t kept = 0;
+    rt_uint32_t range = hi - lo, v;
+
+    /* 无分支：先写再决定下标是否前进 */
+    for (rt_size_t i = 0; i < n; i++)
+    {
+        v = in[i];
+        out[kept] = v;
+        kept += (v - lo) <= range;
+    }
+    return kept;
+}
+
+#endif /* defined(IC_KERNELS_HOST) || defined(BSP_USING_INPUT_CAPTURE_KERNELS) */
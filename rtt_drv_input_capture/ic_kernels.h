@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ */
+
+/*
+ * 输入捕获数据的批处理函数
+ * 一次处理一整批数据（rt_device_read一次读出多条记录，或者DMA/追踪得到的原始计数值），
+ * 全用整数运算，不依赖FPU，结果与逐条用浮点算的一致（占空比差不超过0.01%）；
+ * 与逐条浮点计算比快慢取决于内核，有FPU时不一定更快，上位机的计时见tools/ic_kernels_bench.c
+ * 有DSP扩展的内核（Cortex-M4/M7，__ARM_FEATURE_DSP）对16位数据用SIMD指令一次处理两个，其他内核用普通C实现，结果完全一样
+ * 只做纯计算，定义IC_KERNELS_HOST即可在上位机编译（见tools/ic_kernels_bench.c）
+ */
+#ifndef IC_KERNELS_H_
+#define IC_KERNELS_H_
+
+#ifdef IC_KERNELS_HOST
+#include <stdint.h>
+#include <stddef.h>
+/* 与ic_decoder.h共用 */
+#ifndef IC_HOST_TYPES_DEFINED
+#define IC_HOST_TYPES_DEFINED
+typedef uint8_t     rt_uint8_t;
+typedef uint16_t    rt_uint16_t;
+typedef uint32_t    rt_uint32_t;
+typedef uint64_t    rt_uint64_t;
+typedef int32_t     rt_int32_t;
+typedef int         rt_bool_t;
+typedef size_t      rt_size_t;
+#define RT_NULL     NULL
+struct rt_inputcapture_data
+{
+    rt_uint32_t pulsewidth_us;
+    rt_bool_t   is_high;
+};
+#endif
+#else
+#include <rtthread.h>
+#include <rtdevice.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IC_KERNEL_DUTY_FULL     10000   // 占空比的满量程（0.01%）
+
+struct ic_period_duty
+{
+    rt_uint32_t period_us;      // 一个周期（高电平+紧随的低电平）
+    rt_uint32_t high_us;        // 其中的高电平
+    rt_uint16_t duty;           // 占空比，0~IC_KERNEL_DUTY_FULL
+};
+
+/* 原始计数值 -----------------------------------------------------------------*/
+/* 相邻计数值之差，out[i] = ticks[i+1] - ticks[i]，共n-1个；16位版本自动处理计数回绕 */
+void ic_kernel_deltas_u16(const rt_uint16_t *ticks, rt_size_t n, rt_uint16_t *out);
+void ic_kernel_deltas_u32(const rt_uint32_t *ticks, rt_size_t n, rt_uint32_t *out);
+/* 原地把超出[lo, hi]的值限幅到边界，返回被限幅的个数 */
+rt_size_t ic_kernel_clamp_u16(rt_uint16_t *data, rt_size_t n, rt_uint16_t lo, rt_uint16_t hi);
+
+/* 记录流 ---------------------------------------------------------------------*/
+/* @把rt_inputcapture_data组成周期/占空比：高电平和紧随其后的低电平为一个周期
+ * @开头的低电平、电平不交替（丢了边沿）和停滞记录都跳过，返回输出的个数，*used为用掉的记录数，
+ * @剩下的（最后一个只有高电平的）下次接着处理 */
+rt_size_t ic_kernel_period_duty(const struct rt_inputcapture_data *in, rt_size_t n,
+        struct ic_period_duty *out, rt_size_t *used);
+/* 由周期算频率，单位mHz（0.001Hz），周期为0时为0 */
+void ic_kernel_frequency(const struct ic_period_duty *in, rt_size_t n, rt_uint32_t *freq_mhz);
+
+/* 通用 -----------------------------------------------------------------------*/
+/* 滑动平均，窗口为2^shift，输出n - 2^shift + 1个（n不够时为0），out不能与in重叠 */
+rt_size_t ic_kernel_moving_average_u32(const rt_uint32_t *in, rt_size_t n, rt_uint8_t shift, rt_uint32_t *out);
+/* 剔除[lo, hi]之外的值，返回保留的个数，out可以与in相同 */
+rt_size_t ic_kernel_reject_u32(const rt_uint32_t *in, rt_size_t n, rt_uint32_t lo, rt_uint32_t hi, rt_uint32_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IC_KERNELS_H_ */
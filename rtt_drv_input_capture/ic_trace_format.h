@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-18     28784        the first version
+ * 2026-10-19     28784        version 2: sync records
+ */
+
+/*
+ * 输入捕获二进制追踪流格式，驱动(drv_input_capture.c)与上位机工具(tools/ic_trace_conv.c)共用
+ * 本文件只有宏定义，不依赖rtthread，上位机可直接包含
+ *
+ * 流 = 文件头 + 若干32位记录字，全部为小端
+ * 文件头：
+ *   [0..3]   魔数 "ICTR"
+ *   [4..5]   版本号
+ *   [6..7]   通道数N
+ *   [8..11]  计数频率（Hz），即记录中delta的单位
+ *   之后N个通道名，每个IC_TRACE_NAME_LEN字节，不足补0
+ * 记录字：
+ *   bit31      电平：刚结束的这段持续时间对应的电平（1高0低），边沿之后电平取反
+ *   bit30..26  通道号（文件头中通道名的下标）
+ *   bit25..0   持续时间（计数值）
+ * 特殊通道号：
+ *   IC_TRACE_CH_EXT   delta超出26位时先写这个记录，其低26位为下一条记录delta的高位（delta >> 26）
+ *   IC_TRACE_CH_DROP  缓冲区满丢弃了记录，低26位为丢弃条数，之后各通道时间不再连续，要靠下一条同步记录重新对齐
+ *   IC_TRACE_CH_SYNC  同步记录，低26位（前面可以有EXT给出高位）为流中下一条记录结束时的边沿距开始追踪的时间（计数值），
+ *                     各通道共用这个时间轴；每个通道的第一条记录、丢弃之后各通道的第一条记录前面一定有，之后每隔若干条再放一条
+ * 版本1没有同步记录，各通道的时间只能各自从第一个边沿算起
+ */
+#ifndef IC_TRACE_FORMAT_H_
+#define IC_TRACE_FORMAT_H_
+
+#define IC_TRACE_MAGIC              "ICTR"
+#define IC_TRACE_VERSION            2
+#define IC_TRACE_HEADER_SIZE        12
+#define IC_TRACE_NAME_LEN           12
+
+#define IC_TRACE_LEVEL_POS          31
+#define IC_TRACE_CH_POS             26
+#define IC_TRACE_CH_MASK            0x1FUL
+#define IC_TRACE_DELTA_BITS         26
+#define IC_TRACE_DELTA_MAX          ((1UL << IC_TRACE_DELTA_BITS) - 1)
+
+#define IC_TRACE_CH_EXT             31
+#define IC_TRACE_CH_DROP            30
+#define IC_TRACE_CH_SYNC            29
+#define IC_TRACE_CH_MAX             29  // 可追踪的通道数上限
+
+#define IC_TRACE_WORD(ch, level, delta) \
+    ((((unsigned long)(level) & 1UL) << IC_TRACE_LEVEL_POS) | \
+     (((unsigned long)(ch) & IC_TRACE_CH_MASK) << IC_TRACE_CH_POS) | \
+     ((unsigned long)(delta) & IC_TRACE_DELTA_MAX))
+#define IC_TRACE_WORD_LEVEL(w)      (((w) >> IC_TRACE_LEVEL_POS) & 1UL)
+#define IC_TRACE_WORD_CH(w)         (((w) >> IC_TRACE_CH_POS) & IC_TRACE_CH_MASK)
+#define IC_TRACE_WORD_DELTA(w)      ((w) & IC_TRACE_DELTA_MAX)
+
+#endif /* IC_TRACE_FORMAT_H_ */
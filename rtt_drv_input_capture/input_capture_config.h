@@ -17,6 +17,21 @@ extern "C" {
 
 #ifdef RT_USING_INPUT_CAPTURE
 
+/* @各定时器中断的抢占优先级（子优先级为0），打开设备时用HAL_NVIC_SetPriority设置，可在board.h中定义覆盖
+ * @-1为不设置，保持cubemx在msp函数中的配置；同一定时器的通道共用一个中断，不同通道的config填了不同的值时以最后打开的为准 */
+#ifndef TIMER1_CAPTURE_IRQ_PRIORITY
+#define TIMER1_CAPTURE_IRQ_PRIORITY             -1
+#endif
+#ifndef TIMER2_CAPTURE_IRQ_PRIORITY
+#define TIMER2_CAPTURE_IRQ_PRIORITY             -1
+#endif
+#ifndef TIMER3_CAPTURE_IRQ_PRIORITY
+#define TIMER3_CAPTURE_IRQ_PRIORITY             -1
+#endif
+#ifndef TIMER4_CAPTURE_IRQ_PRIORITY
+#define TIMER4_CAPTURE_IRQ_PRIORITY             -1
+#endif
+
 #if defined(BSP_USING_TIMER1_CAPTURE) && defined(TIMER1_CAPTURE_CHANNEL1)
 #ifndef TIMER1_CAPTURE_CH1_CONFIG
 #define TIMER1_CAPTURE_CH1_CONFIG               \
@@ -25,6 +40,7 @@ extern "C" {
     .name                    = "tim1_ic1",           \
     .u32PluseCnt             = 0,               \
     .irq                     = TIM1_CC_IRQn,       \
+    .irq_priority            = TIMER1_CAPTURE_IRQ_PRIORITY + 1, \
     .ch                      = TIM_CHANNEL_1,   \
         }
 #endif /* TIMER1_CAPTURE_CH1_CONFIG */
@@ -38,6 +54,7 @@ extern "C" {
     .name                    = "tim2_ic2",           \
     .u32PluseCnt             = 0,               \
     .irq                     = TIM2_IRQn,       \
+    .irq_priority            = TIMER2_CAPTURE_IRQ_PRIORITY + 1, \
     .ch                      = TIM_CHANNEL_2,   \
         }
 #endif /* TIMER2_CAPTURE_CH2_CONFIG */
@@ -51,6 +68,7 @@ extern "C" {
     .name                    = "tim3_ic2",           \
     .u32PluseCnt             = 0,               \
     .irq                     = TIM3_IRQn,       \
+    .irq_priority            = TIMER3_CAPTURE_IRQ_PRIORITY + 1, \
     .ch                      = TIM_CHANNEL_2,   \
         }
 #endif /* TIMER3_CAPTURE_CH2_CONFIG */
@@ -64,6 +82,7 @@ extern "C" {
     .name                    = "tim4_ic1",           \
     .u32PluseCnt             = 0,               \
     .irq                     = TIM4_IRQn,       \
+    .irq_priority            = TIMER4_CAPTURE_IRQ_PRIORITY + 1, \
     .ch                      = TIM_CHANNEL_1,   \
         }
 #endif /* TIMER4_CAPTURE_CH1_CONFIG */
@@ -77,6 +96,7 @@ extern "C" {
     .name                    = "tim4_ic2",           \
     .u32PluseCnt             = 0,               \
     .irq                     = TIM4_IRQn,       \
+    .irq_priority            = TIMER4_CAPTURE_IRQ_PRIORITY + 1, \
     .ch                      = TIM_CHANNEL_2,   \
         }
 #endif /* TIMER4_CAPTURE_CH1_CONFIG */
@@ -90,6 +110,7 @@ extern "C" {
     .name                    = "tim4_ic3",           \
     .u32PluseCnt             = 0,               \
     .irq                     = TIM4_IRQn,       \
+    .irq_priority            = TIMER4_CAPTURE_IRQ_PRIORITY + 1, \
     .ch                      = TIM_CHANNEL_3,   \
         }
 #endif /* TIMER4_CAPTURE_CH1_CONFIG */
@@ -103,11 +124,312 @@ extern "C" {
     .name                    = "tim4_ic4",           \
     .u32PluseCnt             = 0,               \
     .irq                     = TIM4_IRQn,       \
+    .irq_priority            = TIMER4_CAPTURE_IRQ_PRIORITY + 1, \
     .ch                      = TIM_CHANNEL_4,   \
         }
 #endif /* TIMER4_CAPTURE_CH1_CONFIG */
 #endif /* BSP_USING_TIMER4_CAPTURE */
 
+/* @硬件级联：board.h中定义TIMERx_CAPTURE_CHAIN为从定时器的编号（2/3/4），从定时器对主定时器的溢出（TRGO）计数，
+ * @捕获值与从定时器的计数拼成32位，主定时器不再开溢出中断
+ * @从定时器不能再做别的用途；cubemx中从定时器配置为Slave Mode: External Clock Mode 1，Trigger为对应的ITR
+ * @ITR对应关系（F1/F4）：TIM2<-TIM3:ITR2 TIM2<-TIM4:ITR3 TIM3<-TIM2:ITR1 TIM3<-TIM4:ITR3 TIM4<-TIM2:ITR1 TIM4<-TIM3:ITR2 */
+#ifdef TIMER2_CAPTURE_CHAIN
+#if TIMER2_CAPTURE_CHAIN == 3
+#define TIMER2_CAPTURE_CHAIN_TIM           TIM3
+#define TIMER2_CAPTURE_CHAIN_ITR           TIM_TS_ITR1
+#if defined(BSP_USING_TIMER3_CAPTURE) || defined(BSP_USING_TIMER3_ENCODER) || defined(TIMER3_CAPTURE_CHAIN)
+#error "TIM3 is the chain slave of TIM2, it can not be used for anything else"
+#endif
+#elif TIMER2_CAPTURE_CHAIN == 4
+#define TIMER2_CAPTURE_CHAIN_TIM           TIM4
+#define TIMER2_CAPTURE_CHAIN_ITR           TIM_TS_ITR1
+#if defined(BSP_USING_TIMER4_CAPTURE) || defined(BSP_USING_TIMER4_ENCODER) || defined(TIMER4_CAPTURE_CHAIN)
+#error "TIM4 is the chain slave of TIM2, it can not be used for anything else"
+#endif
+#else
+#error "TIMER2_CAPTURE_CHAIN must be the number of another timer (2/3/4)"
+#endif
+#ifndef BSP_USING_TIMER2_CAPTURE
+#error "TIMER2_CAPTURE_CHAIN needs BSP_USING_TIMER2_CAPTURE"
+#endif
+#endif /* TIMER2_CAPTURE_CHAIN */
+#ifdef TIMER3_CAPTURE_CHAIN
+#if TIMER3_CAPTURE_CHAIN == 2
+#define TIMER3_CAPTURE_CHAIN_TIM           TIM2
+#define TIMER3_CAPTURE_CHAIN_ITR           TIM_TS_ITR2
+#if defined(BSP_USING_TIMER2_CAPTURE) || defined(BSP_USING_TIMER2_ENCODER) || defined(TIMER2_CAPTURE_CHAIN)
+#error "TIM2 is the chain slave of TIM3, it can not be used for anything else"
+#endif
+#elif TIMER3_CAPTURE_CHAIN == 4
+#define TIMER3_CAPTURE_CHAIN_TIM           TIM4
+#define TIMER3_CAPTURE_CHAIN_ITR           TIM_TS_ITR2
+#if defined(BSP_USING_TIMER4_CAPTURE) || defined(BSP_USING_TIMER4_ENCODER) || defined(TIMER4_CAPTURE_CHAIN)
+#error "TIM4 is the chain slave of TIM3, it can not be used for anything else"
+#endif
+#else
+#error "TIMER3_CAPTURE_CHAIN must be the number of another timer (2/3/4)"
+#endif
+#ifndef BSP_USING_TIMER3_CAPTURE
+#error "TIMER3_CAPTURE_CHAIN needs BSP_USING_TIMER3_CAPTURE"
+#endif
+#endif /* TIMER3_CAPTURE_CHAIN */
+#ifdef TIMER4_CAPTURE_CHAIN
+#if TIMER4_CAPTURE_CHAIN == 2
+#define TIMER4_CAPTURE_CHAIN_TIM           TIM2
+#define TIMER4_CAPTURE_CHAIN_ITR           TIM_TS_ITR3
+#if defined(BSP_USING_TIMER2_CAPTURE) || defined(BSP_USING_TIMER2_ENCODER) || defined(TIMER2_CAPTURE_CHAIN)
+#error "TIM2 is the chain slave of TIM4, it can not be used for anything else"
+#endif
+#elif TIMER4_CAPTURE_CHAIN == 3
+#define TIMER4_CAPTURE_CHAIN_TIM           TIM3
+#define TIMER4_CAPTURE_CHAIN_ITR           TIM_TS_ITR3
+#if defined(BSP_USING_TIMER3_CAPTURE) || defined(BSP_USING_TIMER3_ENCODER) || defined(TIMER3_CAPTURE_CHAIN)
+#error "TIM3 is the chain slave of TIM4, it can not be used for anything else"
+#endif
+#else
+#error "TIMER4_CAPTURE_CHAIN must be the number of another timer (2/3/4)"
+#endif
+#ifndef BSP_USING_TIMER4_CAPTURE
+#error "TIMER4_CAPTURE_CHAIN needs BSP_USING_TIMER4_CAPTURE"
+#endif
+#endif /* TIMER4_CAPTURE_CHAIN */
+#if defined(TIMER2_CAPTURE_CHAIN) || defined(TIMER3_CAPTURE_CHAIN) || defined(TIMER4_CAPTURE_CHAIN)
+#define BSP_USING_INPUT_CAPTURE_CHAIN
+#endif
+
+/* @同步启动：board.h中定义BSP_USING_INPUT_CAPTURE_SYNC，所有捕获定时器在初始化时一起启动，计数对齐
+ * @INPUT_CAPTURE_SYNC_MASTER为主定时器的编号（2/3/4，需开了捕获），其他捕获定时器（含TIM1）由它的TRGO触发启动
+ * @主定时器的TRGO被占用，不能同时做硬件级联的主定时器 */
+#ifdef BSP_USING_INPUT_CAPTURE_SYNC
+#ifndef INPUT_CAPTURE_SYNC_MASTER
+#if defined(BSP_USING_TIMER2_CAPTURE) && !defined(TIMER2_CAPTURE_CHAIN)
+#define INPUT_CAPTURE_SYNC_MASTER               2
+#elif defined(BSP_USING_TIMER3_CAPTURE) && !defined(TIMER3_CAPTURE_CHAIN)
+#define INPUT_CAPTURE_SYNC_MASTER               3
+#else
+#define INPUT_CAPTURE_SYNC_MASTER               4
+#endif
+#endif
+#if INPUT_CAPTURE_SYNC_MASTER == 2
+#define INPUT_CAPTURE_SYNC_MASTER_TIM           TIM2
+#if !defined(BSP_USING_TIMER2_CAPTURE) || defined(TIMER2_CAPTURE_CHAIN)
+#error "INPUT_CAPTURE_SYNC_MASTER must be a capture timer that is not a chain master"
+#endif
+#elif INPUT_CAPTURE_SYNC_MASTER == 3
+#define INPUT_CAPTURE_SYNC_MASTER_TIM           TIM3
+#if !defined(BSP_USING_TIMER3_CAPTURE) || defined(TIMER3_CAPTURE_CHAIN)
+#error "INPUT_CAPTURE_SYNC_MASTER must be a capture timer that is not a chain master"
+#endif
+#elif INPUT_CAPTURE_SYNC_MASTER == 4
+#define INPUT_CAPTURE_SYNC_MASTER_TIM           TIM4
+#if !defined(BSP_USING_TIMER4_CAPTURE) || defined(TIMER4_CAPTURE_CHAIN)
+#error "INPUT_CAPTURE_SYNC_MASTER must be a capture timer that is not a chain master"
+#endif
+#else
+#error "INPUT_CAPTURE_SYNC_MASTER must be 2, 3 or 4"
+#endif
+#endif /* BSP_USING_INPUT_CAPTURE_SYNC */
+
+/* @与pwm共用定时器：board.h中定义TIMERx_CAPTURE_SHARE_PWM，该定时器同时在drv_pwm中开启（BSP_USING_PWMx）
+ * @预分频和周期由pwm决定，捕获按寄存器里的实际值换算，pwm没用的通道都可以做捕获 */
+#ifdef TIMER1_CAPTURE_SHARE_PWM
+#if !defined(BSP_USING_TIMER1_CAPTURE) || !defined(BSP_USING_PWM1)
+#error "TIMER1_CAPTURE_SHARE_PWM needs both BSP_USING_TIMER1_CAPTURE and BSP_USING_PWM1"
+#endif
+#if defined(TIMER1_CAPTURE_CHAIN)
+#error "a timer shared with PWM can not be a chain master, the chain assumes a 0xffff reload"
+#endif
+#define BSP_USING_INPUT_CAPTURE_SHARE_PWM
+#endif
+#ifdef TIMER2_CAPTURE_SHARE_PWM
+#if !defined(BSP_USING_TIMER2_CAPTURE) || !defined(BSP_USING_PWM2)
+#error "TIMER2_CAPTURE_SHARE_PWM needs both BSP_USING_TIMER2_CAPTURE and BSP_USING_PWM2"
+#endif
+#if defined(TIMER2_CAPTURE_CHAIN)
+#error "a timer shared with PWM can not be a chain master, the chain assumes a 0xffff reload"
+#endif
+#define BSP_USING_INPUT_CAPTURE_SHARE_PWM
+#endif
+#ifdef TIMER3_CAPTURE_SHARE_PWM
+#if !defined(BSP_USING_TIMER3_CAPTURE) || !defined(BSP_USING_PWM3)
+#error "TIMER3_CAPTURE_SHARE_PWM needs both BSP_USING_TIMER3_CAPTURE and BSP_USING_PWM3"
+#endif
+#if defined(TIMER3_CAPTURE_CHAIN)
+#error "a timer shared with PWM can not be a chain master, the chain assumes a 0xffff reload"
+#endif
+#define BSP_USING_INPUT_CAPTURE_SHARE_PWM
+#endif
+#ifdef TIMER4_CAPTURE_SHARE_PWM
+#if !defined(BSP_USING_TIMER4_CAPTURE) || !defined(BSP_USING_PWM4)
+#error "TIMER4_CAPTURE_SHARE_PWM needs both BSP_USING_TIMER4_CAPTURE and BSP_USING_PWM4"
+#endif
+#if defined(TIMER4_CAPTURE_CHAIN)
+#error "a timer shared with PWM can not be a chain master, the chain assumes a 0xffff reload"
+#endif
+#define BSP_USING_INPUT_CAPTURE_SHARE_PWM
+#endif
+#if defined(BSP_USING_INPUT_CAPTURE_SHARE_PWM) && defined(BSP_USING_INPUT_CAPTURE_SYNC)
+#error "synchronised start resets the timers, it can not be used with TIMERx_CAPTURE_SHARE_PWM"
+#endif
+
+/* @编码器模式：CH1/CH2接A/B相由硬件计数，Z相（index）接CH3，做输入捕获
+ * @编码器独占定时器，同一定时器不能再开输入捕获通道；TIM1的中断函数名不同，暂未支持 */
+#if defined(BSP_USING_TIMER2_ENCODER)
+#ifndef TIMER2_ENCODER_CONFIG
+#ifdef TIMER2_ENCODER_USING_Z
+#define TIMER2_ENCODER_Z                  1
+#else
+#define TIMER2_ENCODER_Z                  0
+#endif
+#define TIMER2_ENCODER_CONFIG                 \
+        {                                       \
+    .timer.Instance          = TIM2,            \
+    .name                    = "tim2_enc",      \
+    .irq                     = TIM2_IRQn,       \
+    .irq_priority            = TIMER2_CAPTURE_IRQ_PRIORITY + 1, \
+    .ch                      = TIM_CHANNEL_3,   \
+    .encoder                 = 1,               \
+    .enc_z                   = TIMER2_ENCODER_Z,\
+        }
+#endif /* TIMER2_ENCODER_CONFIG */
+#endif /* BSP_USING_TIMER2_ENCODER */
+
+#if defined(BSP_USING_TIMER3_ENCODER)
+#ifndef TIMER3_ENCODER_CONFIG
+#ifdef TIMER3_ENCODER_USING_Z
+#define TIMER3_ENCODER_Z                  1
+#else
+#define TIMER3_ENCODER_Z                  0
+#endif
+#define TIMER3_ENCODER_CONFIG                 \
+        {                                       \
+    .timer.Instance          = TIM3,            \
+    .name                    = "tim3_enc",      \
+    .irq                     = TIM3_IRQn,       \
+    .irq_priority            = TIMER3_CAPTURE_IRQ_PRIORITY + 1, \
+    .ch                      = TIM_CHANNEL_3,   \
+    .encoder                 = 1,               \
+    .enc_z                   = TIMER3_ENCODER_Z,\
+        }
+#endif /* TIMER3_ENCODER_CONFIG */
+#endif /* BSP_USING_TIMER3_ENCODER */
+
+#if defined(BSP_USING_TIMER4_ENCODER)
+#ifndef TIMER4_ENCODER_CONFIG
+#ifdef TIMER4_ENCODER_USING_Z
+#define TIMER4_ENCODER_Z                  1
+#else
+#define TIMER4_ENCODER_Z                  0
+#endif
+#define TIMER4_ENCODER_CONFIG                 \
+        {                                       \
+    .timer.Instance          = TIM4,            \
+    .name                    = "tim4_enc",      \
+    .irq                     = TIM4_IRQn,       \
+    .irq_priority            = TIMER4_CAPTURE_IRQ_PRIORITY + 1, \
+    .ch                      = TIM_CHANNEL_3,   \
+    .encoder                 = 1,               \
+    .enc_z                   = TIMER4_ENCODER_Z,\
+        }
+#endif /* TIMER4_ENCODER_CONFIG */
+#endif /* BSP_USING_TIMER4_ENCODER */
+
+#if defined(BSP_USING_TIMER2_ENCODER) || defined(BSP_USING_TIMER3_ENCODER) || defined(BSP_USING_TIMER4_ENCODER)
+#define BSP_USING_INPUT_CAPTURE_ENCODER
+#endif
+#if (defined(BSP_USING_TIMER2_ENCODER) && defined(BSP_USING_TIMER2_CAPTURE)) || \
+    (defined(BSP_USING_TIMER3_ENCODER) && defined(BSP_USING_TIMER3_CAPTURE)) || \
+    (defined(BSP_USING_TIMER4_ENCODER) && defined(BSP_USING_TIMER4_CAPTURE))
+#error "encoder mode needs the whole timer, do not enable input capture channels on it"
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_ENCODER
+/* 测速周期 */
+#ifndef INPUT_CAPTURE_ENCODER_PERIOD_MS
+#define INPUT_CAPTURE_ENCODER_PERIOD_MS         10
+#endif
+/* 一个测速周期内计数变化少于这么多时改用边沿计时测速 */
+#ifndef INPUT_CAPTURE_ENCODER_LOW_COUNTS
+#define INPUT_CAPTURE_ENCODER_LOW_COUNTS        16
+#endif
+/* 低速时超过这么久没有边沿认为停止 */
+#ifndef INPUT_CAPTURE_ENCODER_STOP_MS
+#define INPUT_CAPTURE_ENCODER_STOP_MS           500
+#endif
+/* 输入滤波，0~15 */
+#ifndef INPUT_CAPTURE_ENCODER_FILTER
+#define INPUT_CAPTURE_ENCODER_FILTER            4
+#endif
+#endif /* BSP_USING_INPUT_CAPTURE_ENCODER */
+
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+/* 追踪缓冲区大小（32位记录字个数），必须是2的幂 */
+#ifndef INPUT_CAPTURE_TRACE_BUF_WORDS
+#define INPUT_CAPTURE_TRACE_BUF_WORDS           2048
+#endif
+/* 追踪线程没被缓冲区半满唤醒时，至少每隔这么久写出一次 */
+#ifndef INPUT_CAPTURE_TRACE_FLUSH_MS
+#define INPUT_CAPTURE_TRACE_FLUSH_MS            100
+#endif
+/* 每个通道每隔这么多条记录放一条同步记录（不超过65535），越小上位机对齐越及时，流也越大 */
+#ifndef INPUT_CAPTURE_TRACE_SYNC_RECORDS
+#define INPUT_CAPTURE_TRACE_SYNC_RECORDS        256
+#endif
+#ifndef INPUT_CAPTURE_TRACE_THREAD_PRIORITY
+#define INPUT_CAPTURE_TRACE_THREAD_PRIORITY     (RT_THREAD_PRIORITY_MAX - 3)
+#endif
+#ifndef INPUT_CAPTURE_TRACE_THREAD_STACK_SIZE
+#define INPUT_CAPTURE_TRACE_THREAD_STACK_SIZE   1024
+#endif
+#endif /* BSP_USING_INPUT_CAPTURE_TRACE */
+
+#ifdef BSP_USING_INPUT_CAPTURE_RPM
+/* 测速模式最多对多少转取平均 */
+#ifndef INPUT_CAPTURE_RPM_WINDOW_MAX
+#define INPUT_CAPTURE_RPM_WINDOW_MAX            8
+#endif
+#endif /* BSP_USING_INPUT_CAPTURE_RPM */
+
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+/* @中值/Hampel滤波的最大窗口长度（奇数），每个设备按它给高、低电平各留两份窗口
+ * @滤波在中断里做，每个边沿O(N)而不是O(log N)：有序窗口插入最坏移动N-1个元素，Hampel再算一次MAD (N-1)/2步；
+ *  窗口小时数组移动比平衡树/双堆更省周期和内存，所以用O(N)的有序数组，靠限制N控制中断开销
+ * @168MHz的M4上最坏估计约11N+150个周期：N=9约250个周期（1.5us），上限N=31约500个周期（3us），所以上限定为31 */
+#ifndef INPUT_CAPTURE_FILTER_WINDOW_MAX
+#define INPUT_CAPTURE_FILTER_WINDOW_MAX         9
+#endif
+#if INPUT_CAPTURE_FILTER_WINDOW_MAX < 3 || INPUT_CAPTURE_FILTER_WINDOW_MAX > 31 || (INPUT_CAPTURE_FILTER_WINDOW_MAX & 1) == 0
+#error "INPUT_CAPTURE_FILTER_WINDOW_MAX must be an odd number in 3~31"
+#endif
+#endif /* BSP_USING_INPUT_CAPTURE_FILTER */
+
+#ifdef BSP_USING_INPUT_CAPTURE_FANOUT
+/* 多读者共用缓冲区的记录条数（每条8字节），必须是2的幂，有读者的设备才分配 */
+#ifndef INPUT_CAPTURE_FANOUT_RECORDS
+#define INPUT_CAPTURE_FANOUT_RECORDS            256
+#endif
+#if (INPUT_CAPTURE_FANOUT_RECORDS & (INPUT_CAPTURE_FANOUT_RECORDS - 1)) != 0
+#error "INPUT_CAPTURE_FANOUT_RECORDS must be a power of 2"
+#endif
+#endif /* BSP_USING_INPUT_CAPTURE_FANOUT */
+
+#ifdef BSP_USING_INPUT_CAPTURE_DECODER
+/* 最多几个设备同时挂解码器 */
+#ifndef INPUT_CAPTURE_DECODER_PORT_MAX
+#define INPUT_CAPTURE_DECODER_PORT_MAX          4
+#endif
+/* 没到水位线时解码线程的轮询间隔 */
+#ifndef INPUT_CAPTURE_DECODER_POLL_MS
+#define INPUT_CAPTURE_DECODER_POLL_MS           20
+#endif
+#ifndef INPUT_CAPTURE_DECODER_THREAD_PRIORITY
+#define INPUT_CAPTURE_DECODER_THREAD_PRIORITY   (RT_THREAD_PRIORITY_MAX / 2)
+#endif
+#ifndef INPUT_CAPTURE_DECODER_THREAD_STACK_SIZE
+#define INPUT_CAPTURE_DECODER_THREAD_STACK_SIZE 1024
+#endif
+#endif /* BSP_USING_INPUT_CAPTURE_DECODER */
+
 #endif /* RT_USING_INPUT_CAPTURE */
 
 #endif /* DRIVERS_INCLUDE_CONFIG_INPUT_CAPTURE_CONFIG_H_ */
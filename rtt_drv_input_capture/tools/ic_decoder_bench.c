@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ * 2026-10-19     28784        split spans at dropped records
+ */
+
+/*
+ * 上位机工具：在电脑上跑ic_decoder_builtin.c中的解码器，统计解码结果和吞吐量
+ * 编译：gcc -O2 -DIC_DECODER_HOST -I.. -o ic_decoder_bench ic_decoder_bench.c ../ic_decoder_builtin.c
+ * 用法：
+ *   ic_decoder_bench <ppm|nec|rc5> <追踪文件> <通道名> [-l 0|1] [-b 批大小] [-r 重复次数] [-v]
+ *   ic_decoder_bench <ppm|nec|rc5> -s <帧数> [-b 批大小] [-r 重复次数] [-v]
+ * 追踪文件为ic_trace命令录下的文件；-s用内置的合成波形（NEC/RC5低有效，PPM高有效）
+ * -l为mark电平，默认与合成波形一致
+ * 追踪文件中的丢弃记录把脉宽分成几段，每段开始时复位解码器，丢弃前后的脉宽不会连成一个波形
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ic_decoder.h"
+#include "ic_trace_format.h"
+
+struct span_buf
+{
+    struct rt_inputcapture_data *span;
+    size_t count, cap;
+    size_t *runs;           // 丢弃记录之后第一个脉宽的下标
+    size_t n_runs, cap_runs;
+};
+
+static void span_add(struct span_buf *b, rt_uint32_t width, int level)
+{
+    if (b->count == b->cap) {
+        b->cap = b->cap ? b->cap * 2 : 4096;
+        b->span = realloc(b->span, b->cap * sizeof(*b->span));
+    }
+    b->span[b->count].pulsewidth_us = width;
+    b->span[b->count].is_high = level;
+    b->count++;
+}
+
+/* 丢弃记录：之后的脉宽另起一段 */
+static void span_break(struct span_buf *b)
+{
+    if (b->count == 0 || (b->n_runs && b->runs[b->n_runs - 1] == b->count))
+        return;
+    if (b->n_runs == b->cap_runs) {
+        b->cap_runs = b->cap_runs ? b->cap_runs * 2 : 16;
+        b->runs = realloc(b->runs, b->cap_runs * sizeof(*b->runs));
+    }
+    b->runs[b->n_runs++] = b->count;
+}
+
+static int load_trace(const char *path, const char *name, struct span_buf *b)
+{
+    FILE *f = fopen(path, "rb");
+    unsigned char hdr[IC_TRACE_HEADER_SIZE], w[4];
+    char ch_name[IC_TRACE_NAME_LEN + 1] = {0};
+    unsigned n_ch, ch = 0xffff;
+    uint32_t word, ext = 0;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) || memcmp(hdr, IC_TRACE_MAGIC, 4)) {
+        fprintf(stderr, "not an input capture trace\n");
+        return -1;
+    }
+    n_ch = hdr[6] | (hdr[7] << 8);
+    for (unsigned i = 0; i < n_ch; i++)
+    {
+        if (fread(ch_name, 1, IC_TRACE_NAME_LEN, f) != IC_TRACE_NAME_LEN)
+            return -1;
+        if (!strcmp(ch_name, name))
+            ch = i;
+    }
+    if (ch == 0xffff) {
+        fprintf(stderr, "channel %s not in trace\n", name);
+        return -1;
+    }
+    while (fread(w, 1, 4, f) == 4)
+    {
+        word = w[0] | (w[1] << 8) | (w[2] << 16) | ((uint32_t)w[3] << 24);
+        if (IC_TRACE_WORD_CH(word) == IC_TRACE_CH_EXT) {
+            ext = IC_TRACE_WORD_DELTA(word);
+            continue;
+        }
+        if (IC_TRACE_WORD_CH(word) == IC_TRACE_CH_DROP) {
+            fprintf(stderr, "warning: %u edges dropped before span %zu\n", (unsigned)IC_TRACE_WORD_DELTA(word), b->count);
+            span_break(b);
+        }
+        else if (IC_TRACE_WORD_CH(word) == ch) {
+            /* 超过32位的脉宽对解码没有意义，饱和即可 */
+            span_add(b, ext >> (32 - IC_TRACE_DELTA_BITS) ? 0xffffffffUL :
+                    (ext << IC_TRACE_DELTA_BITS) | IC_TRACE_WORD_DELTA(word), IC_TRACE_WORD_LEVEL(word));
+        }
+        ext = 0;
+    }
+    fclose(f);
+    return 0;
+}
+
+/* 合成波形 -------------------------------------------------------------------*/
+static void synth_ppm(struct span_buf *b, int frames)
+{
+    for (int f = 0; f < frames; f++)
+    {
+        rt_uint32_t used = 0;
+        for (int c = 0; c < 8; c++)
+        {
+            rt_uint32_t v = 1000 + (f * 37 + c * 125) % 1000;
+            span_add(b, 300, 1);
+            span_add(b, v - 300, 0);
+            used += v;
+        }
+        span_add(b, 300, 1);
+        span_add(b, 22500 - used - 300, 0);
+    }
+}
+
+static void synth_nec(struct span_buf *b, int frames)
+{
+    for (int f = 0; f < frames; f++)
+    {
+        rt_uint32_t addr = f & 0xff, cmd = (f * 7) & 0xff;
+        rt_uint32_t data = addr | ((~addr & 0xff) << 8) | (cmd << 16) | ((~cmd & 0xffUL) << 24);
+        span_add(b, 9000, 0);
+        span_add(b, 4500, 1);
+        for (int i = 0; i < 32; i++)
+        {
+            span_add(b, 560, 0);
+            span_add(b, (data >> i) & 1 ? 1690 : 560, 1);
+        }
+        span_add(b, 560, 0);
+        span_add(b, 40000, 1);
+        /* 一个重复码 */
+        span_add(b, 9000, 0);
+        span_add(b, 2250, 1);
+        span_add(b, 560, 0);
+        span_add(b, 96000, 1);
+    }
+}
+
+static void synth_rc5(struct span_buf *b, int frames)
+{
+    for (int f = 0; f < frames; f++)
+    {
+        rt_uint32_t data = (1u << 13) | (1u << 12) | ((f & 1u) << 11) | ((f & 0x1fu) << 6) | ((f * 3) & 0x3fu);
+        int level = 1, halves[28], n = 0;
+        for (int i = 13; i >= 0; i--)
+        {
+            int bit = (data >> i) & 1;
+            halves[n++] = !bit;  /* 1：先空闲后mark */
+            halves[n++] = bit;
+        }
+        /* 帧前空闲，包括S1的前半位 */
+        rt_uint32_t run = 889 + 20000;
+        level = 1;
+        for (int i = 1; i < 28; i++)
+        {
+            int l = halves[i] ? 0 : 1;
+            if (l == level) {
+                run += 889;
+            }
+            else {
+                span_add(b, run, level);
+                level = l;
+                run = 889;
+            }
+        }
+        span_add(b, run, level);
+        if (level == 0)
+            span_add(b, 20000, 1);
+        else
+            b->span[b->count - 1].pulsewidth_us += 20000;
+    }
+}
+
+/* ---------------------------------------------------------------------------*/
+static int verbose = 0;
+
+static void on_frame(struct ic_decoder *dec, const struct ic_frame *frame, void *user)
+{
+    (void)user;
+    if (!verbose)
+        return;
+    printf("%s:", dec->name);
+    for (int i = 0; i < frame->count; i++)
+        printf(" %u", frame->value[i]);
+    printf(frame->type == IC_FRAME_NEC_REPEAT ? " (repeat)\n" : "\n");
+}
+
+/* 按段喂给解码器，每段开始时复位 */
+static void feed_runs(struct ic_decoder *dec, const struct span_buf *b, size_t batch)
+{
+    size_t start = 0, end;
+
+    for (size_t r = 0; r <= b->n_runs; r++)
+    {
+        end = r < b->n_runs ? b->runs[r] : b->count;
+        if (r > 0)
+            ic_decoder_reset(dec);
+        for (size_t i = start; i < end; i += batch)
+            ic_decoder_feed(dec, &b->span[i], end - i < batch ? end - i : batch);
+        start = end;
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    struct ic_ppm_decoder ppm;
+    struct ic_nec_decoder nec;
+    struct ic_rc5_decoder rc5;
+    struct ic_decoder *dec;
+    struct span_buf b = {0};
+    const char *proto, *path = NULL, *name = NULL;
+    int synth = 0, level = -1, batch = 64, repeat = 100;
+    double t0, t1;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <ppm|nec|rc5> <trace> <channel> | -s <frames>  [-l level] [-b batch] [-r repeat] [-v]\n", argv[0]);
+        return 1;
+    }
+    proto = argv[1];
+    for (int a = 2; a < argc; a++)
+    {
+        if (!strcmp(argv[a], "-s") && a + 1 < argc)
+            synth = atoi(argv[++a]);
+        else if (!strcmp(argv[a], "-l") && a + 1 < argc)
+            level = atoi(argv[++a]);
+        else if (!strcmp(argv[a], "-b") && a + 1 < argc)
+            batch = atoi(argv[++a]);
+        else if (!strcmp(argv[a], "-r") && a + 1 < argc)
+            repeat = atoi(argv[++a]);
+        else if (!strcmp(argv[a], "-v"))
+            verbose = 1;
+        else if (!path)
+            path = argv[a];
+        else
+            name = argv[a];
+    }
+    if (batch <= 0 || repeat <= 0)
+        return 1;
+
+    if (!strcmp(proto, "ppm")) {
+        ic_ppm_decoder_init(&ppm, level < 0 ? 1 : level, on_frame, NULL);
+        dec = &ppm.parent;
+        if (synth)
+            synth_ppm(&b, synth);
+    }
+    else if (!strcmp(proto, "nec")) {
+        ic_nec_decoder_init(&nec, level < 0 ? 0 : level, on_frame, NULL);
+        dec = &nec.parent;
+        if (synth)
+            synth_nec(&b, synth);
+    }
+    else if (!strcmp(proto, "rc5")) {
+        ic_rc5_decoder_init(&rc5, level < 0 ? 0 : level, on_frame, NULL);
+        dec = &rc5.parent;
+        if (synth)
+            synth_rc5(&b, synth);
+    }
+    else {
+        fprintf(stderr, "unknown protocol %s\n", proto);
+        return 1;
+    }
+    if (!synth && (!path || !name || load_trace(path, name, &b) != 0))
+        return 1;
+    if (b.count == 0) {
+        fprintf(stderr, "no spans\n");
+        return 1;
+    }
+
+    /* 第一遍输出解码结果，之后只计时 */
+    feed_runs(dec, &b, b.count);
+    printf("%zu spans in %zu run(s), %u frames, %u errors\n", b.count, b.n_runs + 1, dec->frames, dec->errors);
+    verbose = 0;
+
+    t0 = now_ns();
+    for (int r = 0; r < repeat; r++)
+    {
+        ic_decoder_reset(dec);
+        feed_runs(dec, &b, (size_t)batch);
+    }
+    t1 = now_ns();
+    printf("batch %d: %.2f ns/span, %.1f Mspan/s\n", batch,
+            (t1 - t0) / ((double)b.count * repeat), (double)b.count * repeat * 1e3 / (t1 - t0));
+    free(b.span);
+    free(b.runs);
+    return 0;
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ */
+
+/*
+ * 上位机工具：验证ic_kernels.c的结果并和逐条处理的写法比较速度
+ * 编译：gcc -O2 -DIC_KERNELS_HOST -I.. -o ic_kernels_bench ic_kernels_bench.c ../ic_kernels.c
+ * 加-DIC_KERNELS_EMULATE_DSP则走SIMD分支（指令用C模拟，只用来验证结果，速度没有参考意义）
+ * 用法：ic_kernels_bench [-n 记录数] [-r 重复次数]
+ * 合成的是带抖动的pwm记录流，夹杂丢边沿和停滞记录；逐条处理的写法是应用里常见的每条记录用浮点算占空比和频率
+ * 滑动平均和剔除与最直白的逐个算法比较结果；计时只反映上位机（有FPU），不代表MCU上的快慢
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ic_kernels.h"
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static rt_uint32_t rnd_state = 12345;
+static rt_uint32_t rnd(void)
+{
+    rnd_state = rnd_state * 1103515245UL + 12345UL;
+    return rnd_state >> 8;
+}
+
+static void synth_pwm(struct rt_inputcapture_data *d, size_t n)
+{
+    int level = 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        rt_uint32_t high = 300 + rnd() % 50, low = 700 + rnd() % 50;
+        if (rnd() % 1000 == 0) {// 丢了一个边沿：电平不交替
+            d[i].pulsewidth_us = high + low;
+            d[i].is_high = !level;
+            continue;
+        }
+        if (rnd() % 5000 == 0) {// 停滞记录
+            d[i].pulsewidth_us = 0x80000000UL | 70000;
+            d[i].is_high = level;
+            continue;
+        }
+        d[i].pulsewidth_us = level ? high : low;
+        d[i].is_high = level;
+        level = !level;
+    }
+}
+
+/* 逐条处理：配对的逻辑与ic_kernel_period_duty相同，用浮点算 */
+static size_t per_sample(const struct rt_inputcapture_data *in, size_t n, float *duty, float *freq)
+{
+    size_t count = 0;
+    for (size_t i = 0; i + 1 < n; )
+    {
+        if (!in[i].is_high || (in[i].pulsewidth_us & 0x80000000UL) ||
+                in[i + 1].is_high || (in[i + 1].pulsewidth_us & 0x80000000UL)) {
+            i++;
+            continue;
+        }
+        float period = (float)in[i].pulsewidth_us + (float)in[i + 1].pulsewidth_us;
+        duty[count] = in[i].pulsewidth_us * 100.0f / period;
+        freq[count] = 1000000.0f / period;
+        count++;
+        i += 2;
+    }
+    return count;
+}
+
+/* 逐个重新求和的滑动平均 */
+static size_t ref_moving_average(const rt_uint32_t *in, size_t n, int shift, rt_uint32_t *out)
+{
+    size_t window = (size_t)1 << shift, count = 0;
+    for (size_t i = 0; i + window <= n; i++)
+    {
+        rt_uint64_t sum = 0;
+        for (size_t k = 0; k < window; k++)
+            sum += in[i + k];
+        out[count++] = (rt_uint32_t)(sum >> shift);
+    }
+    return count;
+}
+
+static size_t ref_reject(const rt_uint32_t *in, size_t n, rt_uint32_t lo, rt_uint32_t hi, rt_uint32_t *out)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (in[i] >= lo && in[i] <= hi)
+            out[kept++] = in[i];
+    }
+    return kept;
+}
+
+static int check_u16(void)
+{
+    enum { N = 1001 };
+    rt_uint16_t t[N], d[N], c[N];
+    int err = 0;
+    size_t clamped = 0, expect = 0;
+
+    for (int i = 0; i < N; i++)
+        t[i] = (rt_uint16_t)(i * 40009u + rnd() % 7);// 频繁回绕
+    ic_kernel_deltas_u16(t, N, d);
+    for (int i = 0; i + 1 < N; i++)
+        err += d[i] != (rt_uint16_t)(t[i + 1] - t[i]);
+
+    /* 奇数长度，尾巴走普通实现 */
+    ic_kernel_deltas_u16(t + 1, N - 1, d);
+    for (int i = 0; i + 2 < N; i++)
+        err += d[i] != (rt_uint16_t)(t[i + 2] - t[i + 1]);
+
+    for (int i = 0; i < N; i++)
+    {
+        c[i] = t[i];
+        expect += t[i] < 10000 || t[i] > 50000;
+    }
+    clamped = ic_kernel_clamp_u16(c, N, 10000, 50000);
+    for (int i = 0; i < N; i++)
+        err += c[i] != (t[i] < 10000 ? 10000 : t[i] > 50000 ? 50000 : t[i]);
+    err += clamped != expect;
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = 1 << 16, pairs, used, ref_pairs, kept, avg;
+    int repeat = 100, err;
+    struct rt_inputcapture_data *rec;
+    struct ic_period_duty *pd;
+    rt_uint32_t *freq, *period, *tmp, *mavg, *ref;
+    float *fduty, *ffreq;
+    double t0, t1, t_ref, t_ker;
+    volatile float sink = 0;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if (!strcmp(argv[a], "-n") && a + 1 < argc)
+            n = strtoul(argv[++a], NULL, 0);
+        else if (!strcmp(argv[a], "-r") && a + 1 < argc)
+            repeat = atoi(argv[++a]);
+        else {
+            fprintf(stderr, "Usage: %s [-n records] [-r repeat]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (n < 16 || repeat <= 0)
+        return 1;
+
+    rec = malloc(n * sizeof(*rec));
+    pd = malloc(n * sizeof(*pd));
+    freq = malloc(n * sizeof(*freq));
+    period = malloc(n * sizeof(*period));
+    tmp = malloc(n * sizeof(*tmp));
+    mavg = malloc(n * sizeof(*mavg));
+    ref = malloc(n * sizeof(*ref));
+    fduty = malloc(n * sizeof(*fduty));
+    ffreq = malloc(n * sizeof(*ffreq));
+    synth_pwm(rec, n);
+
+    /* 结果验证 */
+    err = check_u16();
+    pairs = ic_kernel_period_duty(rec, n, pd, &used);
+    ic_kernel_frequency(pd, pairs, freq);
+    ref_pairs = per_sample(rec, n, fduty, ffreq);
+    err += pairs != ref_pairs;
+    for (size_t i = 0; i < pairs && i < ref_pairs; i++)
+    {
+        if (abs((int)pd[i].duty - (int)(fduty[i] * 100.0f + 0.5f)) > 1)
+            err++;
+        if (llabs((long long)freq[i] - (long long)(ffreq[i] * 1000.0f)) > 2)
+            err++;
+        period[i] = pd[i].period_us;
+    }
+    kept = ic_kernel_reject_u32(period, pairs, 950, 1150, tmp);
+    err += kept != ref_reject(period, pairs, 950, 1150, ref);
+    for (size_t i = 0; i < kept; i++)
+        err += tmp[i] != ref[i];
+    /* 原地剔除 */
+    memcpy(mavg, period, pairs * sizeof(*mavg));
+    err += ic_kernel_reject_u32(mavg, pairs, 950, 1150, mavg) != kept;
+    for (size_t i = 0; i < kept; i++)
+        err += mavg[i] != ref[i];
+    avg = ic_kernel_moving_average_u32(tmp, kept, 3, mavg);
+    err += avg != ref_moving_average(tmp, kept, 3, ref);
+    for (size_t i = 0; i < avg; i++)
+        err += mavg[i] != ref[i];
+    printf("%zu records -> %zu periods (%zu used), %zu kept after rejection, %zu averages\n", n, pairs, used, kept, avg);
+    printf("%s path: %d mismatches\n",
+#ifdef IC_KERNELS_EMULATE_DSP
+            "SIMD (emulated)",
+#else
+            "portable",
+#endif
+            err);
+
+    /* 计时 */
+    t0 = now_ns();
+    for (int r = 0; r < repeat; r++)
+    {
+        ref_pairs = per_sample(rec, n, fduty, ffreq);
+        sink += fduty[r % ref_pairs];
+    }
+    t1 = now_ns();
+    t_ref = (t1 - t0) / ((double)n * repeat);
+
+    t0 = now_ns();
+    for (int r = 0; r < repeat; r++)
+    {
+        pairs = ic_kernel_period_duty(rec, n, pd, &used);
+        ic_kernel_frequency(pd, pairs, freq);
+        sink += pd[r % pairs].duty;
+    }
+    t1 = now_ns();
+    t_ker = (t1 - t0) / ((double)n * repeat);
+    printf("per-sample float: %.2f ns/record\n", t_ref);
+    printf("batch kernels   : %.2f ns/record (%.0f%%)\n", t_ker, t_ker * 100 / t_ref);
+
+    t0 = now_ns();
+    for (int r = 0; r < repeat; r++)
+    {
+        ic_kernel_deltas_u16((const rt_uint16_t *)period, n * 2, (rt_uint16_t *)tmp);
+        sink += tmp[r % n];
+    }
+    t1 = now_ns();
+    printf("deltas_u16      : %.2f ns/value\n", (t1 - t0) / ((double)n * 2 * repeat));
+
+    free(rec); free(pd); free(freq); free(period); free(tmp); free(mavg); free(ref); free(fduty); free(ffreq);
+    (void)sink;
+    return err ? 2 : 0;
+}
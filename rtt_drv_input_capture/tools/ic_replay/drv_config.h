@@ -0,0 +1,2 @@
+/* ic_replay：上位机编译驱动用，见ic_replay_mock.h */
+#include "../../input_capture_config.h"
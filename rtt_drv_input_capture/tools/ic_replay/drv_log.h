@@ -0,0 +1,6 @@
+/* ic_replay：上位机编译驱动用，见ic_replay_mock.h */
+#include "ic_replay_mock.h"
+#define LOG_D(...)                  ((void)0)
+#define LOG_I(...)                  ((void)0)
+#define LOG_W(...)                  ((void)0)
+#define LOG_E(...)                  ((void)0)
@@ -0,0 +1,1848 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ */
+
+/*
+ * 上位机工具：把边沿序列经模拟的定时器送进drv_input_capture.c的中断入口（TIMx_IRQHandler），
+ * 逐条核对rt_hw_inputcapture_isr收到的脉宽和电平，并统计中断处理每个边沿的耗时
+ * 编译（在本目录）：gcc -O2 -Wall -Wextra -I. -o ic_replay ic_replay.c
+ *   rtconfig.h默认只开普通捕获和测速；加-DIC_REPLAY_FEATURES开滤波、抽取、追踪、多读者、延迟统计，
+ *   也可以单独-DBSP_USING_INPUT_CAPTURE_xxx，两种都要编译跑一遍
+ * 用法：ic_replay [-r 重复次数] [-w 目录] [-l 中断延迟ns] [-s 停滞超时ms] [-c 通道] [追踪流文件 ...]
+ *   不给文件时跑内置的合成序列：16位回绕的每个相位、捕获与溢出同时挂起、丢边沿、毛刺、0%/100%占空比、MHz突发、两通道共用溢出、
+ *   同一定时器的两个通道关闭再打开、测速模式停转和重新打开后的平均周期、
+ *   单次捕获（信号断了靠停滞记录完成），开了附加功能时还有中值/Hampel/最小宽度滤波、抽取、追踪流、快慢两个读者、延迟直方图
+ *   给文件时回放ic_trace录下的追踪流（-c选通道，默认0），回放到tim3_ic2上
+ *   -w把内置序列按追踪流格式写到目录里，可以用ic_trace_conv转成VCD查看，也可以再拿来回放
+ *   驱动改了之后跑一遍：结果不对返回2，ns/edge可以和改之前比
+ *
+ * 模拟的硬件（ic_replay_mock.h）：
+ * @时间单位ns，TIM3/TIM4时钟72MHz，驱动设的预分频下1us一个计数，16位自动重装载
+ * @边沿与通道当前的捕获极性一致才捕获，捕获标志没清又捕获一次时覆盖捕获值（前一次丢失）
+ * @HAL的通道状态与真的一样：只有经过HAL_TIM_IC_Init的句柄才能HAL_TIM_IC_Start_IT，所有通道关闭后计数器停止
+ * @标志置位后过"中断延迟"才进中断，中断处理本身不占模拟时间，所以延迟内的边沿碰不上新的极性，会丢
+ * 正确答案不用驱动的算法，直接由硬件模型得到：中断清捕获标志时，捕获寄存器里那次捕获的绝对时刻，相邻两次之差就是应输出的脉宽，
+ * 电平是这段时间输入的实际电平；停滞记录在中断清溢出标志时，按溢出时刻和上一次捕获的绝对时刻算；
+ * 附加功能的答案由这些原始记录按各功能的定义（参考实现在"附加功能"一节，不用驱动的代码）变换得到
+ * 耗时是中断入口函数的执行时间（已减去计时本身的开销），除以处理的捕获次数
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+/* 直接包含驱动源文件，才能访问stm32_capture_obj等静态变量 */
+#include "../../drv_input_capture.c"
+#include "../../ic_trace_format.h"
+
+#define SIM_TIM_CLOCK       72000000ULL     // TIM3/TIM4在APB1上：36MHz×2
+#define SIM_T0              5000000ULL      // 序列的第一个边沿（ns），追踪流回放也从这里开始
+#define SIM_NEVER           UINT64_MAX
+#define SIM_US              1000ULL
+#define SIM_MS              1000000ULL
+
+struct sim_edge
+{
+    uint64_t t;                 // 时刻（ns）
+    uint8_t  level;             // 边沿之后的电平
+};
+
+struct sim_trace
+{
+    struct sim_edge *edge;
+    size_t   n, cap;
+    uint8_t  init_level;        // 第一个边沿之前的电平
+};
+
+struct rec_list
+{
+    struct rt_inputcapture_data *r;
+    size_t   n, cap;
+};
+
+struct sim_timer
+{
+    TIM_TypeDef *tim;
+    void   (*irq)(void);
+    uint8_t  running;
+    uint64_t start;             // 计数器从0开始计的时刻
+    uint64_t tick_ns;
+    uint64_t wrap;              // 一次溢出的计数值
+    uint64_t next_wrap;
+    uint64_t isr_at;            // 已挂起、将要进中断的时刻
+};
+
+struct sim_input
+{
+    struct stm32_capture_device *dev;
+    struct sim_timer *tmr;
+    uint32_t idx;               // 通道下标0~3
+    const struct sim_trace *tr;
+    size_t   pos;
+    uint8_t  level;
+    /* 硬件：捕获寄存器里的那次捕获 */
+    uint8_t  latched, latched_before;
+    uint64_t latched_tick;
+    /* 正确答案 */
+    uint8_t  have_last, last_after, stall_pending;
+    uint64_t last_tick, stall_tick;
+    uint32_t stall_ovf;
+    struct rec_list expect, got;
+    /* 统计 */
+    uint64_t captures, serviced, overwritten;
+    uint64_t reopen_captures;   // 关闭再打开时的captures，之后有边沿却没有捕获说明计数器没有重新启动
+    uint8_t *phase_seen;
+    uint8_t  rpm;               // 测速模式，应得的记录由序列给出
+    /* rt_inputcapture的环形缓冲区，rt_hw_inputcapture_isr写，读设备时读 */
+    struct rt_ringbuffer rb;
+    rt_uint8_t rb_pool[RT_INPUT_CAPTURE_RB_SIZE * sizeof(struct rt_inputcapture_data)];
+};
+
+struct sim_case;
+/* 附加功能用例的设置，用例只用到其中几项，为0的不设 */
+struct sim_feature
+{
+    struct inputcapture_filter_config filter;
+    rt_uint32_t decimate;       // 抽取的周期数
+    rt_uint32_t oneshot;        // 单次捕获的记录数
+    uint64_t hold_from;         // 读者从这时起不再读，直到最后一次
+};
+
+struct sim_case
+{
+    const char *name;
+    const char *dev[2];
+    struct sim_trace tr[2];
+    int      ntr;
+    uint64_t latency, jitter;   // 中断延迟，实际为latency + [0, jitter]（ns）
+    uint64_t tail;              // 最后一个边沿之后再模拟多久（ns）
+    uint32_t stall_ms;
+    uint8_t  all_phases;        // 要求捕获落在溢出周期的每个相位上
+    uint64_t reopen_at;         // 不为0时在这个时刻关闭再打开设备
+    const struct inputcapture_rpm_config *rpm;  // 测速模式（第一个通道）
+    struct rec_list expect;     // 测速模式应得的记录，生成序列时按每转的周期算好
+    /* @附加功能（第一个通道）：打开后调用setup；每隔poll_every调用一次poll（相当于读者线程），最后再调用一次（last为1）
+     * @核对之前调用check，它把in->expect（硬件模型给出的原始记录）换成这个功能应有的输出，再查功能自己的统计，最后把设置恢复，返回错误数 */
+    const struct sim_feature *feat;
+    int    (*setup)(const struct sim_case *c, struct sim_input *in);
+    void   (*poll)(const struct sim_case *c, struct sim_input *in, int last);
+    uint64_t poll_every;
+    int    (*check)(const struct sim_case *c, struct sim_input *in);
+};
+
+struct sim_stat
+{
+    uint64_t edges, captures, serviced, overwritten, isr_ns;
+    size_t   records, phases;
+    int      errors;
+};
+
+static uint64_t sim_now;
+static struct sim_timer sim_tmr[2];
+static int sim_ntmr;
+static struct sim_input sim_in[2];
+static int sim_nin;
+static uint64_t sim_latency, sim_jitter, sim_clock_overhead;
+static size_t sim_stray;
+static rt_uint32_t rnd_state = 12345;
+
+static rt_uint32_t rnd(void)
+{
+    rnd_state = rnd_state * 1103515245UL + 12345UL;
+    return rnd_state >> 8;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void rec_put(struct rec_list *l, rt_uint32_t width, rt_bool_t level)
+{
+    if (l->n == l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 1024;
+        l->r = realloc(l->r, l->cap * sizeof(*l->r));
+    }
+    l->r[l->n].pulsewidth_us = width;
+    l->r[l->n].is_high = level;
+    l->n++;
+}
+
+/* 序列 ----------------------------------------------------------------------*/
+static void tr_begin(struct sim_trace *tr, uint8_t level)
+{
+    free(tr->edge);
+    memset(tr, 0, sizeof(*tr));
+    tr->init_level = level;
+}
+
+/* 在t时刻翻转电平，t必须递增 */
+static void tr_toggle(struct sim_trace *tr, uint64_t t)
+{
+    uint8_t level = tr->n ? !tr->edge[tr->n - 1].level : !tr->init_level;
+
+    if (tr->n == tr->cap) {
+        tr->cap = tr->cap ? tr->cap * 2 : 4096;
+        tr->edge = realloc(tr->edge, tr->cap * sizeof(*tr->edge));
+    }
+    tr->edge[tr->n].t = t;
+    tr->edge[tr->n].level = level;
+    tr->n++;
+}
+
+static uint64_t tr_last(const struct sim_trace *tr)
+{
+    return tr->n ? tr->edge[tr->n - 1].t : SIM_T0;
+}
+
+/* 模拟的定时器 ----------------------------------------------------------------*/
+static struct sim_timer *sim_timer_of(TIM_TypeDef *tim)
+{
+    for (int i = 0; i < sim_ntmr; i++)
+    {
+        if (sim_tmr[i].tim == tim)
+            return &sim_tmr[i];
+    }
+    return RT_NULL;
+}
+
+static void sim_schedule(struct sim_timer *t, uint64_t at)
+{
+    if (t->isr_at == SIM_NEVER && (t->tim->SR & t->tim->DIER & 0xffU))
+        t->isr_at = at + sim_latency + (sim_jitter ? rnd() % (sim_jitter + 1) : 0);
+}
+
+TIM_TypeDef ic_mock_tim[5];
+
+void ic_mock_tim_enable(TIM_TypeDef *tim)
+{
+    struct sim_timer *t = sim_timer_of(tim);
+
+    tim->CR1 |= TIM_CR1_CEN;
+    if (t == RT_NULL || t->running)
+        return;
+    RT_ASSERT((tim->PSC + 1ULL) * 1000000000ULL % SIM_TIM_CLOCK == 0);
+    t->running = 1;
+    t->start = sim_now;
+    t->tick_ns = (tim->PSC + 1ULL) * 1000000000ULL / SIM_TIM_CLOCK;
+    t->wrap = tim->ARR + 1ULL;
+    t->next_wrap = t->start + t->wrap * t->tick_ns;
+}
+
+/* 与HAL的__HAL_TIM_DISABLE一样，还有通道开着时不停 */
+void ic_mock_tim_disable(TIM_TypeDef *tim)
+{
+    struct sim_timer *t = sim_timer_of(tim);
+
+    if ((tim->CCER & 0x1111U) != 0)
+        return;
+    tim->CR1 &= ~TIM_CR1_CEN;
+    if (t)
+        t->running = 0;
+}
+
+uint32_t ic_mock_tim_counter(TIM_TypeDef *tim)
+{
+    struct sim_timer *t = sim_timer_of(tim);
+
+    if (t == RT_NULL || !t->running)
+        return tim->CNT;
+    return (uint32_t)((sim_now - t->start) / t->tick_ns % t->wrap);
+}
+
+/* 应有的停滞记录：溢出之后到中断处理之前又有了边沿就不报告 */
+static void sim_expect_stall(struct sim_input *in)
+{
+    uint64_t from = in->have_last ? in->last_tick : 0, wrap = in->tmr->wrap, elapsed;
+    rt_uint32_t width;
+
+    if (in->have_last && in->last_tick >= in->stall_tick)
+        return;
+    if ((in->stall_tick / wrap - from / wrap) % in->stall_ovf != 0)
+        return;
+    elapsed = in->stall_tick - from;
+    width = INPUTCAPTURE_STALL_FLAG | (elapsed > INPUTCAPTURE_STALL_US_MASK ? INPUTCAPTURE_STALL_US_MASK : (rt_uint32_t)elapsed);
+    if (!in->have_last)
+        width |= INPUTCAPTURE_STALL_NO_LEVEL;
+    rec_put(&in->expect, width, in->have_last ? in->last_after : 0);
+}
+
+/* 中断清标志：这时捕获寄存器里的捕获就是驱动处理的那一次 */
+void ic_mock_clear_sr(TIM_TypeDef *tim, uint32_t mask)
+{
+    for (int i = 0; i < sim_nin; i++)
+    {
+        struct sim_input *in = &sim_in[i];
+        uint32_t ccf = TIM_FLAG_CC1 << in->idx;
+
+        if (in->tmr->tim != tim)
+            continue;
+        if ((mask & ccf) && (tim->SR & ccf) && in->latched) {
+            if (in->have_last && !in->rpm)
+                rec_put(&in->expect, (rt_uint32_t)(in->latched_tick - in->last_tick), in->latched_before);
+            in->have_last = 1;
+            in->last_tick = in->latched_tick;
+            in->last_after = !in->latched_before;
+            in->latched = 0;
+            in->serviced++;
+            if (in->phase_seen)
+                in->phase_seen[in->latched_tick % in->tmr->wrap] = 1;
+        }
+        if ((mask & TIM_FLAG_UPDATE) && (tim->SR & TIM_FLAG_UPDATE) && in->stall_pending) {
+            in->stall_pending = 0;
+            sim_expect_stall(in);
+        }
+    }
+    tim->SR &= ~mask;
+}
+
+static void sim_edge(struct sim_input *in, const struct sim_edge *e)
+{
+    TIM_TypeDef *tim = in->tmr->tim;
+    uint32_t shift = in->idx * 4, ccf = TIM_FLAG_CC1 << in->idx, pol;
+    uint8_t before = in->level;
+    uint64_t tick;
+
+    in->level = e->level;
+    if (before == e->level || !in->tmr->running || !(tim->CCER & (TIM_CCER_CC1E << shift)))
+        return;
+    pol = (tim->CCER >> shift) & TIM_INPUTCHANNELPOLARITY_BOTHEDGE;
+    if (pol != TIM_INPUTCHANNELPOLARITY_BOTHEDGE && (pol == TIM_INPUTCHANNELPOLARITY_FALLING) == (e->level != 0))
+        return;
+    tick = (e->t - in->tmr->start) / in->tmr->tick_ns;
+    (&tim->CCR1)[in->idx] = (uint32_t)(tick % in->tmr->wrap);
+    if (tim->SR & ccf) {
+        tim->SR |= TIM_FLAG_CC1OF << in->idx;
+        in->overwritten++;
+    }
+    tim->SR |= ccf;
+    in->latched = 1;
+    in->latched_tick = tick;
+    in->latched_before = before;
+    in->captures++;
+    sim_schedule(in->tmr, e->t);
+}
+
+static void sim_wrap(struct sim_timer *t)
+{
+    uint64_t at = t->next_wrap;
+
+    t->tim->SR |= TIM_FLAG_UPDATE;
+    for (int i = 0; i < sim_nin; i++)
+    {
+        if (sim_in[i].tmr == t && sim_in[i].stall_ovf) {
+            sim_in[i].stall_pending = 1;
+            sim_in[i].stall_tick = (at - t->start) / t->tick_ns;
+        }
+    }
+    t->next_wrap += t->wrap * t->tick_ns;
+    sim_schedule(t, at);
+}
+
+/* DWT周期计数器：SystemCoreClock下的模拟时间，32位回绕 */
+DWT_Type ic_mock_dwt;
+CoreDebug_Type ic_mock_coredebug;
+uint32_t SystemCoreClock = 72000000UL;
+
+static void sim_dwt_update(void)
+{
+    ic_mock_dwt.CYCCNT = (uint32_t)(sim_now * (SystemCoreClock / 1000000UL) / 1000U);
+}
+
+static void sim_isr(struct sim_timer *t, struct sim_stat *st)
+{
+    uint64_t a, b;
+
+    sim_now = t->isr_at;
+    t->isr_at = SIM_NEVER;
+    t->tim->CNT = ic_mock_tim_counter(t->tim);
+    sim_dwt_update();
+    a = now_ns();
+    t->irq();
+    b = now_ns();
+    st->isr_ns += b - a > sim_clock_overhead ? b - a - sim_clock_overhead : 0;
+    sim_schedule(t, sim_now);
+}
+
+/* 模拟的rtthread/HAL，声明见ic_replay_mock.h --------------------------------------*/
+void ic_mock_assert(const char *expr, const char *file, int line)
+{
+    fprintf(stderr, "assertion failed: %s at %s:%d\n", expr, file, line);
+    exit(3);
+}
+rt_base_t rt_hw_interrupt_disable(void) { return 0; }
+void rt_hw_interrupt_enable(rt_base_t level) { (void)level; }
+void rt_interrupt_enter(void) {}
+void rt_interrupt_leave(void) {}
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag) { (void)name; (void)flag; sem->value = value; return RT_EOK; }
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time) { (void)time; if (!sem->value) return -RT_ETIMEOUT; sem->value--; return RT_EOK; }
+rt_err_t rt_sem_release(rt_sem_t sem) { sem->value++; return RT_EOK; }
+rt_err_t rt_sem_control(rt_sem_t sem, int cmd, void *arg) { (void)cmd; (void)arg; sem->value = 0; return RT_EOK; }
+rt_err_t rt_sem_detach(rt_sem_t sem) { (void)sem; return RT_EOK; }
+void rt_timer_init(rt_timer_t timer, const char *name, void (*timeout)(void *parameter), void *parameter, rt_tick_t time, rt_uint8_t flag)
+{ (void)timer; (void)name; (void)timeout; (void)parameter; (void)time; (void)flag; }
+rt_err_t rt_timer_start(rt_timer_t timer) { (void)timer; return RT_EOK; }
+rt_err_t rt_timer_stop(rt_timer_t timer) { (void)timer; return RT_EOK; }
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms) { return (rt_tick_t)ms; }
+rt_tick_t rt_tick_get(void) { return (rt_tick_t)(sim_now / (1000000000ULL / RT_TICK_PER_SECOND)); }
+/* 线程只创建不运行，追踪线程的活由用例的poll代做 */
+static struct rt_thread sim_thread;
+rt_thread_t rt_thread_create(const char *name, void (*entry)(void *), void *p, rt_uint32_t stack, rt_uint8_t prio, rt_uint32_t tick)
+{ (void)name; (void)entry; (void)p; (void)stack; (void)prio; (void)tick; return &sim_thread; }
+rt_err_t rt_thread_startup(rt_thread_t t) { (void)t; return RT_EOK; }
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void rt_free(void *p) { free(p); }
+int rt_kprintf(const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+    va_start(ap, fmt);
+    n = vprintf(fmt, ap);
+    va_end(ap);
+    return n;
+}
+rt_device_t rt_device_find(const char *name) { (void)name; return RT_NULL; }
+rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag) { (void)dev; (void)oflag; return -RT_ERROR; }
+rt_err_t rt_device_close(rt_device_t dev) { (void)dev; return -RT_ERROR; }
+rt_ssize_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{ (void)dev; (void)pos; (void)buffer; (void)size; return 0; }
+/* 环形缓冲区与rtthread的一样用镜像位区分空和满 */
+rt_size_t rt_ringbuffer_data_len(struct rt_ringbuffer *rb)
+{
+    if (rb->read_index == rb->write_index)
+        return rb->read_mirror == rb->write_mirror ? 0 : (rt_size_t)rb->buffer_size;
+    if (rb->write_index > rb->read_index)
+        return rb->write_index - rb->read_index;
+    return rb->buffer_size - (rb->read_index - rb->write_index);
+}
+
+static rt_size_t sim_rb_put(struct rt_ringbuffer *rb, const void *p, rt_size_t len)
+{
+    if (rt_ringbuffer_space_len(rb) < len)
+        return 0;
+    for (rt_size_t i = 0; i < len; i++)
+    {
+        rb->buffer_ptr[rb->write_index] = ((const rt_uint8_t *)p)[i];
+        if (++rb->write_index == rb->buffer_size) {
+            rb->write_index = 0;
+            rb->write_mirror = ~rb->write_mirror;
+        }
+    }
+    return len;
+}
+
+static rt_size_t sim_rb_get(struct rt_ringbuffer *rb, void *p, rt_size_t len)
+{
+    if (len > rt_ringbuffer_data_len(rb))
+        len = rt_ringbuffer_data_len(rb);
+    for (rt_size_t i = 0; i < len; i++)
+    {
+        ((rt_uint8_t *)p)[i] = rb->buffer_ptr[rb->read_index];
+        if (++rb->read_index == rb->buffer_size) {
+            rb->read_index = 0;
+            rb->read_mirror = ~rb->read_mirror;
+        }
+    }
+    return len;
+}
+
+static rt_err_t sim_framework_control(rt_device_t dev, int cmd, void *args) { (void)dev; (void)cmd; (void)args; return -RT_ENOSYS; }
+/* rt_inputcapture的read：size为记录条数 */
+static rt_ssize_t sim_framework_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    struct rt_inputcapture_device *inputcapture = (struct rt_inputcapture_device *)dev;
+
+    (void)pos;
+    return sim_rb_get(inputcapture->ringbuff, buffer, size * sizeof(struct rt_inputcapture_data)) / sizeof(struct rt_inputcapture_data);
+}
+rt_err_t rt_device_inputcapture_register(struct rt_inputcapture_device *inputcapture, const char *name, void *data)
+{
+    (void)name;
+    inputcapture->parent.control = sim_framework_control;
+    inputcapture->parent.read = sim_framework_read;
+    inputcapture->parent.user_data = data;
+    return RT_EOK;
+}
+
+void rt_hw_inputcapture_isr(struct rt_inputcapture_device *inputcapture, rt_bool_t level)
+{
+    struct rt_inputcapture_data data = { 0, level };
+
+    inputcapture->ops->get_pulsewidth(inputcapture, &data.pulsewidth_us);
+    for (int i = 0; i < sim_nin; i++)
+    {
+        if (&sim_in[i].dev->parent == inputcapture) {
+            rec_put(&sim_in[i].got, data.pulsewidth_us, level);
+            /* 满了就丢，与rtthread一样 */
+            sim_rb_put(inputcapture->ringbuff, &data, sizeof(data));
+            return;
+        }
+    }
+    sim_stray++;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim)
+{
+    htim->Instance->PSC = htim->Init.Prescaler;
+    htim->Instance->ARR = htim->Init.Period;
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef *htim)
+{
+    for (int i = 0; i < 4; i++)
+        htim->ChannelState[i] = HAL_TIM_CHANNEL_STATE_READY;
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef *htim, TIM_ClockConfigTypeDef *cfg) { (void)htim; (void)cfg; return HAL_OK; }
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, TIM_MasterConfigTypeDef *cfg) { (void)htim; (void)cfg; return HAL_OK; }
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim)
+{
+    ic_mock_tim_enable(htim->Instance);
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim)
+{
+    htim->Instance->DIER |= TIM_IT_UPDATE;
+    ic_mock_tim_enable(htim->Instance);
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef *htim, TIM_IC_InitTypeDef *cfg, uint32_t ch)
+{
+    uint32_t idx = ch / 4, shift = (idx & 1) * 8;
+    __IO uint32_t *ccmr = idx < 2 ? &htim->Instance->CCMR1 : &htim->Instance->CCMR2;
+
+    *ccmr = (*ccmr & ~(TIM_CCMR1_CC1S << shift)) | (cfg->ICSelection << shift);
+    __HAL_TIM_SET_CAPTUREPOLARITY(htim, ch, cfg->ICPolarity);
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef *htim, uint32_t ch)
+{
+    if (htim->ChannelState[ch / 4] != HAL_TIM_CHANNEL_STATE_READY)
+        return HAL_ERROR;
+    htim->ChannelState[ch / 4] = HAL_TIM_CHANNEL_STATE_BUSY;
+    htim->Instance->CCER |= TIM_CCER_CC1E << ch;
+    htim->Instance->DIER |= TIM_IT_CC1 << (ch / 4);
+    ic_mock_tim_enable(htim->Instance);
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef *htim, uint32_t ch)
+{
+    htim->Instance->CCER &= ~(TIM_CCER_CC1E << ch);
+    htim->Instance->DIER &= ~(TIM_IT_CC1 << (ch / 4));
+    ic_mock_tim_disable(htim->Instance);
+    htim->ChannelState[ch / 4] = HAL_TIM_CHANNEL_STATE_READY;
+    return HAL_OK;
+}
+uint32_t HAL_TIM_ReadCapturedValue(TIM_HandleTypeDef *htim, uint32_t ch)
+{
+    return (&htim->Instance->CCR1)[ch / 4];
+}
+void HAL_RCC_GetClockConfig(RCC_ClkInitTypeDef *cfg, uint32_t *latency)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->APB1CLKDivider = RCC_HCLK_DIV2;
+    cfg->APB2CLKDivider = RCC_HCLK_DIV1;
+    *latency = 2;
+}
+uint32_t HAL_RCC_GetPCLK1Freq(void) { return SIM_TIM_CLOCK / 2; }
+uint32_t HAL_RCC_GetPCLK2Freq(void) { return SIM_TIM_CLOCK; }
+void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t pre, uint32_t sub) { (void)irq; (void)pre; (void)sub; }
+void HAL_NVIC_EnableIRQ(IRQn_Type irq) { (void)irq; }
+
+/* 回放 ----------------------------------------------------------------------*/
+static void sim_reset(void)
+{
+    for (int i = 0; i < sim_nin; i++)
+    {
+        free(sim_in[i].expect.r);
+        free(sim_in[i].got.r);
+        free(sim_in[i].phase_seen);
+    }
+    memset(sim_in, 0, sizeof(sim_in));
+    memset(sim_tmr, 0, sizeof(sim_tmr));
+    memset(ic_mock_tim, 0, sizeof(ic_mock_tim));
+    sim_nin = sim_ntmr = 0;
+    sim_stray = 0;
+    sim_now = 0;
+    rnd_state = 12345;
+    for (struct stm32_capture_timer *group = stm32_capture_timer_obj; group->instance != RT_NULL; group++)
+    {
+        group->ready = 0;
+        group->clock = 0;
+    }
+}
+
+static int sim_compare(const struct sim_case *c, struct sim_input *in)
+{
+    const struct rec_list *expect = in->rpm ? &c->expect : &in->expect;
+    size_t n = expect->n < in->got.n ? expect->n : in->got.n;
+    int errors = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const struct rt_inputcapture_data *e = &expect->r[i], *g = &in->got.r[i];
+        if (e->pulsewidth_us == g->pulsewidth_us && !e->is_high == !g->is_high)
+            continue;
+        if (errors++ < 5)
+            printf("  %s %s record %zu: expected %#x/%d, got %#x/%d\n", c->name, in->dev->name, i,
+                    e->pulsewidth_us, e->is_high, g->pulsewidth_us, g->is_high);
+    }
+    if (expect->n != in->got.n) {
+        printf("  %s %s: expected %zu records, got %zu\n", c->name, in->dev->name, expect->n, in->got.n);
+        errors++;
+    }
+    return errors;
+}
+
+/* 关闭再打开：驱动重新从第一个边沿开始，答案也重新开始；先全部关闭再打开，同一定时器上的通道都关了计数器才会停 */
+static int sim_reopen(const struct sim_case *c)
+{
+    int errors = 0;
+
+    for (int i = 0; i < sim_nin; i++)
+        stm32_capture_close(&sim_in[i].dev->parent);
+    for (int i = 0; i < sim_nin; i++)
+    {
+        if (stm32_capture_open(&sim_in[i].dev->parent) != RT_EOK) {
+            printf("  %s: %s reopen failed\n", c->name, sim_in[i].dev->name);
+            errors++;
+        }
+        sim_in[i].reopen_captures = sim_in[i].captures;
+        sim_in[i].have_last = 0;
+        sim_in[i].latched = 0;
+        sim_in[i].stall_pending = 0;
+    }
+    return errors;
+}
+
+static int sim_run(const struct sim_case *c, struct sim_stat *st)
+{
+    uint64_t end = 0, t, reopen, poll;
+    int errors = 0;
+
+    memset(st, 0, sizeof(*st));
+    sim_reset();
+    sim_latency = c->latency;
+    sim_jitter = c->jitter;
+    for (int i = 0; i < c->ntr; i++)
+    {
+        struct sim_input *in = &sim_in[sim_nin++];
+        int index = stm32_capture_index(c->dev[i]);
+
+        RT_ASSERT(index >= 0);
+        in->dev = &stm32_capture_obj[index];
+        in->tmr = sim_timer_of(in->dev->timer.Instance);
+        if (in->tmr == RT_NULL) {
+            in->tmr = &sim_tmr[sim_ntmr++];
+            in->tmr->tim = in->dev->timer.Instance;
+            in->tmr->irq = in->tmr->tim == TIM3 ? TIM3_IRQHandler : TIM4_IRQHandler;
+            in->tmr->isr_at = SIM_NEVER;
+        }
+        in->idx = in->dev->ch / 4;
+        in->rb.buffer_ptr = in->rb_pool;
+        in->rb.buffer_size = sizeof(in->rb_pool);
+        in->dev->parent.ringbuff = &in->rb;
+        in->tr = &c->tr[i];
+        in->level = c->tr[i].init_level;
+        if (c->all_phases)
+            in->phase_seen = calloc(0x10000, 1);
+        st->edges += c->tr[i].n;
+        if (tr_last(&c->tr[i]) > end)
+            end = tr_last(&c->tr[i]);
+    }
+    end += c->tail;
+    for (int i = 0; i < sim_nin; i++)
+    {
+        struct stm32_capture_device *dev = sim_in[i].dev;
+
+        if (stm32_capture_init(&dev->parent) != RT_EOK || stm32_capture_open(&dev->parent) != RT_EOK) {
+            printf("  %s: %s init/open failed\n", c->name, dev->name);
+            return 1;
+        }
+        rt_uint32_t stall_ms = c->stall_ms;
+        stm32_capture_control(&dev->parent.parent, INPUTCAPTURE_CMD_SET_STALL_TIMEOUT, &stall_ms);
+        sim_in[i].stall_ovf = dev->stall_overflows;
+        if (i == 0 && c->rpm != RT_NULL) {
+            struct inputcapture_rpm_config cfg = *c->rpm;
+            if (stm32_capture_control(&dev->parent.parent, INPUTCAPTURE_CMD_SET_RPM, &cfg) != RT_EOK) {
+                printf("  %s: %s set rpm failed\n", c->name, dev->name);
+                return 1;
+            }
+            sim_in[i].rpm = 1;
+            sim_in[i].stall_ovf = 0;
+        }
+    }
+    if (c->setup != RT_NULL && (errors = c->setup(c, &sim_in[0])) != 0)
+        return errors;
+    reopen = c->reopen_at ? c->reopen_at : SIM_NEVER;
+    poll = c->poll != RT_NULL ? c->poll_every : SIM_NEVER;
+
+    for (;;)
+    {
+        struct sim_input *edge_in = RT_NULL;
+        struct sim_timer *wrap_tmr = RT_NULL, *isr_tmr = RT_NULL;
+        uint64_t hw = SIM_NEVER, isr = SIM_NEVER;
+
+        for (int i = 0; i < sim_nin; i++)
+        {
+            if (sim_in[i].pos < sim_in[i].tr->n && sim_in[i].tr->edge[sim_in[i].pos].t < hw) {
+                hw = sim_in[i].tr->edge[sim_in[i].pos].t;
+                edge_in = &sim_in[i];
+            }
+        }
+        for (int i = 0; i < sim_ntmr; i++)
+        {
+            if (sim_tmr[i].running && sim_tmr[i].next_wrap < hw) {
+                hw = sim_tmr[i].next_wrap;
+                wrap_tmr = &sim_tmr[i];
+                edge_in = RT_NULL;
+            }
+            if (sim_tmr[i].isr_at < isr) {
+                isr = sim_tmr[i].isr_at;
+                isr_tmr = &sim_tmr[i];
+            }
+        }
+        if (reopen <= hw && reopen <= isr && reopen <= end) {
+            sim_now = reopen;
+            reopen = SIM_NEVER;
+            errors += sim_reopen(c);
+            continue;
+        }
+        if (poll <= hw && poll <= isr && poll <= end) {
+            sim_now = poll;
+            poll += c->poll_every;
+            sim_dwt_update();
+            c->poll(c, &sim_in[0], 0);
+            continue;
+        }
+        /* 同一时刻先发生硬件事件，再进中断 */
+        t = hw <= isr ? hw : isr;
+        if (t > end)
+            break;
+        if (hw <= isr) {
+            sim_now = hw;
+            if (edge_in != RT_NULL)
+                sim_edge(edge_in, &edge_in->tr->edge[edge_in->pos++]);
+            else
+                sim_wrap(wrap_tmr);
+        }
+        else
+            sim_isr(isr_tmr, st);
+    }
+
+    if (c->poll != RT_NULL) {
+        sim_now = end;
+        sim_dwt_update();
+        c->poll(c, &sim_in[0], 1);
+    }
+    for (int i = 0; i < sim_nin; i++)
+    {
+        struct sim_input *in = &sim_in[i];
+
+        if (i == 0 && c->check != RT_NULL)
+            errors += c->check(c, in);
+        if (in->rpm) {
+            /* 设备对象在用例之间是共用的，测速要关掉 */
+            struct inputcapture_rpm_config off = { 0 };
+            stm32_capture_control(&in->dev->parent.parent, INPUTCAPTURE_CMD_SET_RPM, &off);
+        }
+        stm32_capture_close(&in->dev->parent);
+        errors += sim_compare(c, in);
+        if (c->reopen_at && tr_last(in->tr) > c->reopen_at && in->captures == in->reopen_captures) {
+            printf("  %s %s: no captures after reopen\n", c->name, in->dev->name);
+            errors++;
+        }
+        st->captures += in->captures;
+        st->serviced += in->serviced;
+        st->overwritten += in->overwritten;
+        st->records += in->got.n;
+        if (in->phase_seen) {
+            for (size_t p = 0; p < in->tmr->wrap; p++)
+                st->phases += in->phase_seen[p];
+            if (st->phases != in->tmr->wrap) {
+                printf("  %s %s: captures hit only %zu of %llu counter phases\n", c->name, in->dev->name,
+                        st->phases, (unsigned long long)in->tmr->wrap);
+                errors++;
+            }
+        }
+    }
+    if (sim_stray) {
+        printf("  %s: %zu records from channels not in this case\n", c->name, sim_stray);
+        errors++;
+    }
+    st->errors = errors;
+    return errors;
+}
+
+/* 内置序列 -------------------------------------------------------------------*/
+static void pwm(struct sim_trace *tr, uint64_t *t, uint64_t low, uint64_t high, int periods)
+{
+    for (int i = 0; i < periods; i++)
+    {
+        tr_toggle(tr, *t += low);
+        tr_toggle(tr, *t += high);
+    }
+}
+
+/* 带抖动的pwm：低、高电平各加[0, jitter)ns，每every个周期的高电平再加extra（野值） */
+rt_inline void pwm_jitter(struct sim_trace *tr, uint64_t *t, uint64_t low, uint64_t high, uint64_t jitter,
+        int every, uint64_t extra, int periods)
+{
+    for (int i = 0; i < periods; i++)
+    {
+        tr_toggle(tr, *t += low + rnd() % jitter);
+        tr_toggle(tr, *t += high + rnd() % jitter + (i % every == every - 1 ? extra : 0));
+    }
+}
+
+/* @测速信号：第一个上升沿只作为起点，之后revs转、每转cfg->pulses_per_rev个脉冲，第r转的脉冲周期为period + (r % 5) * 7us
+ * @应得的记录（every_rev）：每转一条最近window转的平均周期；t返回最后一个上升沿的时刻 */
+static void tach(struct sim_trace *tr, struct rec_list *expect, uint64_t *t, uint64_t period_us, int revs,
+        const struct inputcapture_rpm_config *cfg)
+{
+    uint64_t hist[INPUT_CAPTURE_RPM_WINDOW_MAX], sum, p = period_us;
+    int filled;
+
+    tr_toggle(tr, *t);
+    tr_toggle(tr, *t + p * SIM_US / 2);
+    for (int r = 0; r < revs; r++)
+    {
+        p = period_us + (r % 5) * 7;
+        for (int k = 0; k < cfg->pulses_per_rev; k++)
+        {
+            tr_toggle(tr, *t += p * SIM_US);
+            tr_toggle(tr, *t + p * SIM_US / 2);
+        }
+        hist[r % cfg->window] = p * cfg->pulses_per_rev;
+        filled = r + 1 < cfg->window ? r + 1 : cfg->window;
+        sum = 0;
+        for (int k = 0; k < filled; k++)
+            sum += hist[k];
+        rec_put(expect, (rt_uint32_t)(sum / filled), 1);
+    }
+}
+
+/* 附加功能 -------------------------------------------------------------------*/
+rt_inline void rec_free(struct rec_list *l)
+{
+    free(l->r);
+    memset(l, 0, sizeof(*l));
+}
+
+rt_inline void rec_replace(struct rec_list *l, struct rec_list *with)
+{
+    free(l->r);
+    *l = *with;
+}
+
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+static int cmp_u32(const void *a, const void *b)
+{
+    rt_uint32_t x = *(const rt_uint32_t *)a, y = *(const rt_uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* 参考实现直接按定义算：排序取中值，偏差再排序取中值得MAD，不用驱动的有序窗口和两边归并 */
+static rt_uint32_t ref_median(const rt_uint32_t *hist, int n, rt_uint32_t *mad)
+{
+    rt_uint32_t s[INPUT_CAPTURE_FILTER_WINDOW_MAX], med;
+
+    memcpy(s, hist, n * sizeof(s[0]));
+    qsort(s, n, sizeof(s[0]), cmp_u32);
+    med = s[(n - 1) / 2];
+    if (mad != RT_NULL) {
+        for (int i = 0; i < n; i++)
+            s[i] = s[i] > med ? s[i] - med : med - s[i];
+        qsort(s, n, sizeof(s[0]), cmp_u32);
+        *mad = s[(n - 1) / 2];
+    }
+    return med;
+}
+
+/* 滤波应有的输出，*rejected为应替换或并掉的条数；停滞记录原样，最小宽度推迟的那一条在停滞记录之前输出 */
+static void ref_filter(struct rec_list *l, const struct inputcapture_filter_config *cfg, rt_uint32_t *rejected)
+{
+    struct rec_list out = { 0 };
+    rt_uint32_t hist[2][INPUT_CAPTURE_FILTER_WINDOW_MAX], med, mad, thresh, v, pending = 0;
+    int filled[2] = { 0, 0 }, pos[2] = { 0, 0 }, have = 0, absorbing = 0, lv;
+    rt_bool_t pending_level = 0;
+
+    *rejected = 0;
+    for (size_t i = 0; i < l->n; i++)
+    {
+        v = l->r[i].pulsewidth_us;
+        lv = l->r[i].is_high ? 1 : 0;
+        if (INPUTCAPTURE_IS_STALL(&l->r[i])) {
+            if (have)
+                rec_put(&out, pending, pending_level);
+            have = absorbing = 0;
+            rec_put(&out, v, l->r[i].is_high);
+            continue;
+        }
+        if (cfg->type == INPUTCAPTURE_FILTER_MIN_WIDTH) {
+            if (absorbing) {
+                pending += v;
+                absorbing = 0;
+            }
+            else if (!have) {
+                pending = v;
+                pending_level = l->r[i].is_high;
+                have = 1;
+            }
+            else if (v < cfg->min_us) {
+                pending += v;
+                absorbing = 1;
+                (*rejected)++;
+            }
+            else {
+                rec_put(&out, pending, pending_level);
+                pending = v;
+                pending_level = l->r[i].is_high;
+            }
+            continue;
+        }
+        /* 中值、Hampel：Hampel用的是放入这一条之前的窗口 */
+        if (cfg->type == INPUTCAPTURE_FILTER_HAMPEL && filled[lv] == cfg->window) {
+            med = ref_median(hist[lv], filled[lv], &mad);
+            thresh = mad * cfg->k_x10 * 3 / 20;
+            if (thresh < cfg->min_us)
+                thresh = cfg->min_us;
+            hist[lv][pos[lv]] = v;
+            if ((v > med ? v - med : med - v) > thresh) {
+                v = med;
+                (*rejected)++;
+            }
+        }
+        else
+            hist[lv][pos[lv]] = v;
+        pos[lv] = (pos[lv] + 1) % cfg->window;
+        if (filled[lv] < cfg->window)
+            filled[lv]++;
+        if (cfg->type == INPUTCAPTURE_FILTER_MEDIAN)
+            v = ref_median(hist[lv], filled[lv], RT_NULL);
+        rec_put(&out, v, l->r[i].is_high);
+    }
+    rec_replace(l, &out);
+}
+#endif /* BSP_USING_INPUT_CAPTURE_FILTER */
+
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+/* 抽取应有的输出：每2×cycles条输出平均的高、低电平各一条（先高后低），停滞时不满的也输出，之后是停滞记录 */
+static void ref_decimate(struct rec_list *l, rt_uint32_t cycles)
+{
+    struct rec_list out = { 0 };
+    uint64_t sum[2] = { 0, 0 };
+    rt_uint32_t count[2] = { 0, 0 }, records = 0;
+    int lv;
+
+    for (size_t i = 0; i < l->n; i++)
+    {
+        if (!INPUTCAPTURE_IS_STALL(&l->r[i])) {
+            lv = l->r[i].is_high ? 1 : 0;
+            sum[lv] += l->r[i].pulsewidth_us;
+            count[lv]++;
+            if (++records < 2 * cycles)
+                continue;
+        }
+        for (lv = 1; lv >= 0; lv--)
+        {
+            if (count[lv])
+                rec_put(&out, (rt_uint32_t)(sum[lv] / count[lv]), lv);
+            sum[lv] = 0;
+            count[lv] = 0;
+        }
+        records = 0;
+        if (INPUTCAPTURE_IS_STALL(&l->r[i]))
+            rec_put(&out, l->r[i].pulsewidth_us, l->r[i].is_high);
+    }
+    rec_replace(l, &out);
+}
+#endif /* BSP_USING_INPUT_CAPTURE_DECIMATE */
+
+/* 按c->feat设置滤波、抽取和单次捕获，不合法的设置先试一遍，要被拒绝 */
+static int sim_feature_setup(const struct sim_case *c, struct sim_input *in)
+{
+    const struct sim_feature *f = c->feat;
+    rt_device_t dev = &in->dev->parent.parent;
+    int errors = 0;
+
+    /* ic_replay直接调用驱动的open，单次捕获要看的打开标志在这里补上 */
+    dev->open_flag |= RT_DEVICE_OFLAG_OPEN;
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+    if (f->filter.type != INPUTCAPTURE_FILTER_NONE) {
+        static const struct inputcapture_filter_config bad[] = {
+            { INPUTCAPTURE_FILTER_HAMPEL, 5, 0, 0 },                                // Hampel没有门限
+            { INPUTCAPTURE_FILTER_MEDIAN, 4, 0, 0 },                                // 偶数窗口
+            { INPUTCAPTURE_FILTER_MEDIAN, INPUT_CAPTURE_FILTER_WINDOW_MAX + 2, 0, 0 },
+            { INPUTCAPTURE_FILTER_MIN_WIDTH + 1, 5, 30, 0 },
+        };
+        struct inputcapture_filter_config cfg;
+
+        for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+        {
+            cfg = bad[i];
+            if (stm32_capture_control(dev, INPUTCAPTURE_CMD_SET_FILTER, &cfg) != -RT_EINVAL) {
+                printf("  %s: filter type %u window %u k %u accepted\n", c->name, cfg.type, cfg.window, cfg.k_x10);
+                errors++;
+            }
+        }
+        cfg = f->filter;
+        if (stm32_capture_control(dev, INPUTCAPTURE_CMD_SET_FILTER, &cfg) != RT_EOK) {
+            printf("  %s: set filter failed\n", c->name);
+            errors++;
+        }
+    }
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+    if (f->decimate) {
+        rt_uint32_t cycles = INPUTCAPTURE_DECIMATE_MAX + 1;
+
+        if (stm32_capture_control(dev, INPUTCAPTURE_CMD_SET_DECIMATE, &cycles) != -RT_EINVAL) {
+            printf("  %s: decimate %u accepted\n", c->name, cycles);
+            errors++;
+        }
+        cycles = f->decimate;
+        if (stm32_capture_control(dev, INPUTCAPTURE_CMD_SET_DECIMATE, &cycles) != RT_EOK) {
+            printf("  %s: set decimate failed\n", c->name);
+            errors++;
+        }
+    }
+#endif
+    if (f->oneshot) {
+        rt_uint32_t records = f->oneshot;
+
+        if (stm32_capture_control(dev, INPUTCAPTURE_CMD_ONESHOT_ARM, &records) != RT_EOK) {
+            printf("  %s: one-shot arm failed\n", c->name);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/* 设备对象在用例之间是共用的，设置都要恢复 */
+static void sim_feature_teardown(struct sim_input *in)
+{
+    rt_device_t dev = &in->dev->parent.parent;
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+    struct inputcapture_filter_config none = { 0 };
+
+    stm32_capture_control(dev, INPUTCAPTURE_CMD_SET_FILTER, &none);
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+    rt_uint32_t cycles = 0;
+
+    stm32_capture_control(dev, INPUTCAPTURE_CMD_SET_DECIMATE, &cycles);
+#endif
+    dev->open_flag &= ~RT_DEVICE_OFLAG_OPEN;
+}
+
+/* 原始记录依次经过滤波、抽取，单次捕获只要前面那么多条，滤波统计和单次捕获的完成信号也要对 */
+static int sim_feature_check(const struct sim_case *c, struct sim_input *in)
+{
+    const struct sim_feature *f = c->feat;
+    rt_device_t dev = &in->dev->parent.parent;
+    int errors = 0;
+
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+    if (f->filter.type != INPUTCAPTURE_FILTER_NONE) {
+        struct inputcapture_filter_stat stat;
+        rt_uint32_t samples = 0, rejected;
+
+        for (size_t i = 0; i < in->expect.n; i++)
+            samples += !INPUTCAPTURE_IS_STALL(&in->expect.r[i]);
+        ref_filter(&in->expect, &f->filter, &rejected);
+        stm32_capture_control(dev, INPUTCAPTURE_CMD_GET_FILTER_STAT, &stat);
+        if (stat.samples != samples || stat.rejected != rejected) {
+            printf("  %s: filter stat %u samples %u rejected, expected %u/%u\n", c->name,
+                    stat.samples, stat.rejected, samples, rejected);
+            errors++;
+        }
+    }
+#endif
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+    if (f->decimate > 1)
+        ref_decimate(&in->expect, f->decimate);
+#endif
+    if (f->oneshot) {
+        rt_int32_t timeout = 0;
+
+        if (in->expect.n > f->oneshot)
+            in->expect.n = f->oneshot;
+        if (in->expect.n == f->oneshot && stm32_capture_control(dev, INPUTCAPTURE_CMD_ONESHOT_WAIT, &timeout) != RT_EOK) {
+            printf("  %s: one-shot not signalled\n", c->name);
+            errors++;
+        }
+        if (in->dev->timer.Instance->DIER & input_capture_ch_it(in->dev->ch)) {
+            printf("  %s: still capturing after the one-shot\n", c->name);
+            errors++;
+        }
+    }
+    sim_feature_teardown(in);
+    return errors;
+}
+
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+static struct { rt_uint8_t *p; size_t n, cap; } sim_trace_out;
+
+static rt_ssize_t sim_trace_write(void *ctx, const void *buf, rt_size_t size)
+{
+    (void)ctx;
+    if (sim_trace_out.n + size > sim_trace_out.cap) {
+        sim_trace_out.cap = (sim_trace_out.n + size) * 2;
+        sim_trace_out.p = realloc(sim_trace_out.p, sim_trace_out.cap);
+    }
+    memcpy(sim_trace_out.p + sim_trace_out.n, buf, size);
+    sim_trace_out.n += size;
+    return size;
+}
+
+/* 追踪的通道上同时设了滤波和抽取，追踪流里应该还是原始边沿 */
+static int sim_trace_setup(const struct sim_case *c, struct sim_input *in)
+{
+    int errors = sim_feature_setup(c, in);
+
+    sim_trace_out.n = 0;
+    if (stm32_capture_trace_start(1UL << (in->dev - stm32_capture_obj), sim_trace_write, RT_NULL) != RT_EOK) {
+        printf("  %s: trace start failed\n", c->name);
+        errors++;
+    }
+    return errors;
+}
+
+/* 代替追踪线程写出 */
+static void sim_trace_poll(const struct sim_case *c, struct sim_input *in, int last)
+{
+    (void)c;
+    (void)in;
+    (void)last;
+    stm32_capture_trace_flush(&stm32_capture_trace_obj);
+}
+
+/* @追踪流解析成记录放进in->got，应与原始记录一致（停滞记录不进追踪流），也不能再进环形缓冲区
+ * @同步记录给出的时间要与其间各条记录的持续时间累加一致，个数为每INPUT_CAPTURE_TRACE_SYNC_RECORDS条一个 */
+static int sim_trace_check(const struct sim_case *c, struct sim_input *in)
+{
+    const size_t header = IC_TRACE_HEADER_SIZE + IC_TRACE_NAME_LEN * TIMER_CAPTURE_INDEX_MAX;
+    const rt_uint8_t *p = sim_trace_out.p;
+    rt_uint32_t ch = in->dev - stm32_capture_obj, word, syncs = 0;
+    uint64_t ext = 0, delta, now = 0, sync_at = 0;
+    int errors = 0, have_now = 0, have_sync = 0;
+    struct stm32_capture_trace_stat stat;
+    struct rec_list raw = { 0 };
+    size_t n = in->got.n;
+
+    stm32_capture_trace_stop();
+    stm32_capture_trace_get_stat(&stat);
+    if (sim_trace_out.n < header || memcmp(p, IC_TRACE_MAGIC, 4) != 0) {
+        printf("  %s: bad trace header\n", c->name);
+        errors++;
+    }
+    for (size_t i = header; errors == 0 && i + 4 <= sim_trace_out.n; i += 4)
+    {
+        word = p[i] | (rt_uint32_t)p[i + 1] << 8 | (rt_uint32_t)p[i + 2] << 16 | (rt_uint32_t)p[i + 3] << 24;
+        delta = ext | IC_TRACE_WORD_DELTA(word);
+        ext = 0;
+        switch (IC_TRACE_WORD_CH(word))
+        {
+        case IC_TRACE_CH_EXT:
+            ext = (uint64_t)IC_TRACE_WORD_DELTA(word) << IC_TRACE_DELTA_BITS;
+            break;
+        case IC_TRACE_CH_DROP:
+            printf("  %s: %llu edges dropped\n", c->name, (unsigned long long)delta);
+            errors++;
+            break;
+        case IC_TRACE_CH_SYNC:
+            sync_at = delta;
+            have_sync = 1;
+            syncs++;
+            break;
+        default:
+            if (IC_TRACE_WORD_CH(word) != ch) {
+                printf("  %s: record of channel %u\n", c->name, (unsigned)IC_TRACE_WORD_CH(word));
+                errors++;
+                break;
+            }
+            now += delta;
+            if (have_sync) {
+                if (have_now && now != sync_at) {
+                    printf("  %s: sync at %llu, records add up to %llu\n", c->name,
+                            (unsigned long long)sync_at, (unsigned long long)now);
+                    errors++;
+                }
+                now = sync_at;
+                have_now = 1;
+                have_sync = 0;
+            }
+            rec_put(&in->got, (rt_uint32_t)delta, IC_TRACE_WORD_LEVEL(word));
+            break;
+        }
+    }
+    if (n != 0) {
+        printf("  %s: %zu records went to the ring buffer\n", c->name, n);
+        errors++;
+    }
+    n = in->got.n - n;
+    if (stat.records != n || stat.dropped != 0 || syncs != (n + INPUT_CAPTURE_TRACE_SYNC_RECORDS - 1) / INPUT_CAPTURE_TRACE_SYNC_RECORDS) {
+        printf("  %s: %zu records, stat %u records %u dropped, %u syncs\n", c->name, n, stat.records, stat.dropped, syncs);
+        errors++;
+    }
+    for (size_t i = 0; i < in->expect.n; i++)
+    {
+        if (!INPUTCAPTURE_IS_STALL(&in->expect.r[i]))
+            rec_put(&raw, in->expect.r[i].pulsewidth_us, in->expect.r[i].is_high);
+    }
+    rec_replace(&in->expect, &raw);
+    sim_feature_teardown(in);
+    return errors;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_TRACE */
+
+#ifdef BSP_USING_INPUT_CAPTURE_FANOUT
+static struct stm32_capture_reader sim_fast, sim_slow;
+
+static int sim_fanout_setup(const struct sim_case *c, struct sim_input *in)
+{
+    rt_device_t dev = &in->dev->parent.parent;
+
+    memset(&sim_fast, 0, sizeof(sim_fast));
+    memset(&sim_slow, 0, sizeof(sim_slow));
+    sim_fast.watermark = 16;
+    if (stm32_capture_reader_attach(dev, &sim_fast) != RT_EOK || stm32_capture_reader_attach(dev, &sim_slow) != RT_EOK) {
+        printf("  %s: reader attach failed\n", c->name);
+        return 1;
+    }
+    return 0;
+}
+
+/* 快的读者每次都读完，放进in->got；慢的读者只在最后读 */
+static void sim_fanout_poll(const struct sim_case *c, struct sim_input *in, int last)
+{
+    struct rt_inputcapture_data buf[64];
+    rt_size_t n;
+
+    (void)c;
+    (void)last;
+    while ((n = stm32_capture_reader_read(&sim_fast, buf, 64)) != 0)
+    {
+        for (rt_size_t i = 0; i < n; i++)
+            rec_put(&in->got, buf[i].pulsewidth_us, buf[i].is_high);
+    }
+}
+
+/* 快的读者一条不丢；慢的读者只剩最后INPUT_CAPTURE_FANOUT_RECORDS条，其余计入overruns，不影响快的 */
+static int sim_fanout_check(const struct sim_case *c, struct sim_input *in)
+{
+    struct rt_inputcapture_data buf[64];
+    struct rec_list slow = { 0 };
+    rt_size_t n;
+    size_t off;
+    int errors = 0;
+
+    while ((n = stm32_capture_reader_read(&sim_slow, buf, 64)) != 0)
+    {
+        for (rt_size_t i = 0; i < n; i++)
+            rec_put(&slow, buf[i].pulsewidth_us, buf[i].is_high);
+    }
+    if (sim_fast.overruns != 0 || slow.n + sim_slow.overruns != in->got.n || slow.n > INPUT_CAPTURE_FANOUT_RECORDS) {
+        printf("  %s: fast reader %zu records %u overruns, slow reader %zu records %u overruns\n", c->name,
+                in->got.n, sim_fast.overruns, slow.n, sim_slow.overruns);
+        errors++;
+    }
+    else {
+        off = in->got.n - slow.n;
+        for (size_t i = 0; i < slow.n; i++)
+        {
+            if (slow.r[i].pulsewidth_us != in->got.r[off + i].pulsewidth_us || !slow.r[i].is_high != !in->got.r[off + i].is_high) {
+                printf("  %s: slow reader record %zu differs\n", c->name, i);
+                errors++;
+                break;
+            }
+        }
+    }
+    stm32_capture_reader_detach(&sim_slow);
+    stm32_capture_reader_detach(&sim_fast);
+    if (in->dev->fan.buf != RT_NULL) {
+        printf("  %s: shared buffer kept after the last reader\n", c->name);
+        errors++;
+    }
+    rec_free(&slow);
+    return errors;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_FANOUT */
+
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+static struct rec_list sim_lat_read;    // 读者读到的记录
+static size_t sim_lat_last;             // 最后一次读到的条数
+
+static int sim_latency_setup(const struct sim_case *c, struct sim_input *in)
+{
+    rt_uint32_t on = 1;
+
+    rec_free(&sim_lat_read);
+    sim_lat_last = 0;
+    if (stm32_capture_control(&in->dev->parent.parent, INPUTCAPTURE_CMD_SET_LATENCY, &on) != RT_EOK) {
+        printf("  %s: set latency failed\n", c->name);
+        return 1;
+    }
+    return 0;
+}
+
+/* 读者：hold_from之前每次都读完，之后只在最后用带时间戳的读再读一次 */
+static void sim_latency_poll(const struct sim_case *c, struct sim_input *in, int last)
+{
+    rt_device_t dev = &in->dev->parent.parent;
+    struct rt_inputcapture_data buf[32];
+    rt_uint32_t cycles[32];
+    struct inputcapture_stamped_read rd = { buf, cycles, 32, 0 };
+    size_t before = sim_lat_read.n;
+    rt_ssize_t n;
+
+    if (!last && sim_now >= c->feat->hold_from)
+        return;
+    for (;;)
+    {
+        if (last) {
+            stm32_capture_control(dev, INPUTCAPTURE_CMD_READ_STAMPED, &rd);
+            n = rd.read;
+        }
+        else
+            n = dev->read(dev, 0, buf, 32);
+        if (n <= 0)
+            break;
+        for (rt_ssize_t i = 0; i < n; i++)
+            rec_put(&sim_lat_read, buf[i].pulsewidth_us, buf[i].is_high);
+    }
+    if (last)
+        sim_lat_last = sim_lat_read.n - before;
+}
+
+/* @读到的就是驱动交出的全部记录；按时读的延迟都在一个读周期之内，hold_from之后等到最后（超过DWT一圈）的只计入overlimit */
+static int sim_latency_check(const struct sim_case *c, struct sim_input *in)
+{
+    struct inputcapture_latency_stat stat;
+    rt_uint32_t on = 0, bins = 0, period_us = (rt_uint32_t)(c->poll_every / SIM_US);
+    int errors = 0;
+
+    stm32_capture_control(&in->dev->parent.parent, INPUTCAPTURE_CMD_GET_LATENCY, &stat);
+    for (int i = 0; i < INPUTCAPTURE_LATENCY_BINS; i++)
+        bins += stat.bins[i];
+    if (stat.count + stat.overlimit != sim_lat_read.n || stat.overlimit != sim_lat_last || sim_lat_last == 0 ||
+            bins != stat.count || stat.max_us > period_us || stat.max_us < period_us * 8 / 10) {
+        printf("  %s: read %zu (%zu at the end), stat %u count %u overlimit %u in bins, max %u us\n", c->name,
+                sim_lat_read.n, sim_lat_last, stat.count, stat.overlimit, bins, stat.max_us);
+        errors++;
+    }
+    if (sim_lat_read.n != in->got.n || memcmp(sim_lat_read.r, in->got.r, in->got.n * sizeof(in->got.r[0])) != 0) {
+        printf("  %s: read %zu records, driver delivered %zu\n", c->name, sim_lat_read.n, in->got.n);
+        errors++;
+    }
+    stm32_capture_control(&in->dev->parent.parent, INPUTCAPTURE_CMD_SET_LATENCY, &on);
+    return errors;
+}
+#endif /* BSP_USING_INPUT_CAPTURE_LATENCY */
+
+#define CASE_MAX    32
+
+static int build_cases(struct sim_case *cs)
+{
+    struct sim_case *c;
+    struct sim_trace *tr;
+    uint64_t t;
+    int n = 0;
+
+    /* 普通pwm：1kHz，30%占空比 */
+    c = &cs[n++]; c->name = "pwm-1k"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+    c->latency = 2 * SIM_US; c->tail = SIM_MS;
+    tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+    pwm(tr, &t, 700 * SIM_US, 300 * SIM_US, 2000);
+
+    /* @16位回绕的每个相位：一个周期65537us（奇数），上升沿依次落在计数值的每一个相位上，下降沿也一样
+     * @中断延迟3~6us，回绕前后几us内的边沿都是捕获和溢出同时挂起 */
+    c = &cs[n++]; c->name = "wrap-phase"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+    c->latency = 3 * SIM_US; c->jitter = 3 * SIM_US; c->tail = SIM_MS; c->all_phases = 1;
+    tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+    for (int i = 0; i < 0x10000; i++)
+    {
+        /* 计数内的ns偏移不累加，相位才能逐个走到 */
+        tr_toggle(tr, (t += 35526 * SIM_US) + rnd() % SIM_US);
+        tr_toggle(tr, (t += 30011 * SIM_US) + rnd() % SIM_US);
+    }
+
+    /* 一个脉宽跨好几次回绕 */
+    c = &cs[n++]; c->name = "wrap-long"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+    c->latency = 2 * SIM_US; c->jitter = 2 * SIM_US; c->tail = SIM_MS;
+    tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+    pwm(tr, &t, 200002 * SIM_US, 70001 * SIM_US, 4096);
+
+    /* 边沿正好落在回绕前后几个计数内，中断进来时捕获和溢出都挂起；每3次回绕有一个跨在回绕上的3us脉冲 */
+    c = &cs[n++]; c->name = "coincident"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+    c->latency = 4 * SIM_US; c->tail = SIM_MS;
+    tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, SIM_T0);
+    {
+        static const int64_t offset[] = { -3000, -2000, -1001, -1000, -1, 0, 1, 999, 1000, 1001, 2000, 3000 };
+        for (uint64_t k = 1; k <= 600; k++)
+        {
+            uint64_t wrap_at = k * 0x10000 * SIM_US;
+            if (k % 3 == 0) {
+                tr_toggle(tr, wrap_at - 1500);
+                tr_toggle(tr, wrap_at + 1500);
+            }
+            else
+                tr_toggle(tr, wrap_at + offset[k % (sizeof(offset) / sizeof(offset[0]))]);
+        }
+    }
+
+    /* 丢边沿：每7个高电平有一个只有1us，比中断延迟短，下降沿捕获不到 */
+    c = &cs[n++]; c->name = "missed-edge"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+    c->latency = 3 * SIM_US; c->tail = SIM_MS;
+    tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+    for (int i = 0; i < 3000; i++)
+    {
+        tr_toggle(tr, t += 700 * SIM_US);
+        tr_toggle(tr, t += (i % 7 == 3) ? SIM_US : 300 * SIM_US);
+    }
+
+    /* 毛刺：低电平中间随机出现1~15us的窄脉冲，有的比中断延迟短 */
+    c = &cs[n++]; c->name = "glitch"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+    c->latency = 2 * SIM_US; c->jitter = 2 * SIM_US; c->tail = SIM_MS;
+    tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+    for (int i = 0; i < 3000; i++)
+    {
+        if (rnd() % 3 == 0) {
+            uint64_t at = 50 * SIM_US + rnd() % (600 * SIM_US), width = SIM_US + rnd() % (15 * SIM_US);
+            tr_toggle(tr, t + at);
+            tr_toggle(tr, t + at + width);
+        }
+        tr_toggle(tr, t += 800 * SIM_US);
+        tr_toggle(tr, t += 200 * SIM_US);
+    }
+
+    /* 0%/100%占空比：100Hz之后一直低/一直高，100ms停滞超时 */
+    for (int high = 0; high <= 1; high++)
+    {
+        c = &cs[n++]; c->name = high ? "duty-100" : "duty-0"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+        c->latency = 2 * SIM_US; c->tail = 1200 * SIM_MS; c->stall_ms = 100;
+        tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+        pwm(tr, &t, 5 * SIM_MS, 5 * SIM_MS, 50);
+        if (!high)
+            tr_toggle(tr, t += 5 * SIM_MS);
+    }
+
+    /* 打开后一直没有边沿：停滞记录不知道电平 */
+    c = &cs[n++]; c->name = "no-signal"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+    c->latency = 2 * SIM_US; c->tail = 1000 * SIM_MS; c->stall_ms = 50;
+    tr_begin(&c->tr[0], 0);
+
+    /* MHz突发：1MHz和250kHz的突发各32个周期，间隔2ms，大部分边沿在中断延迟内，只能捕获到一部分 */
+    c = &cs[n++]; c->name = "mhz-burst"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+    c->latency = 1500; c->tail = SIM_MS;
+    tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+    for (int i = 0; i < 400; i++)
+    {
+        uint64_t half = (i & 1) ? 2000 : 500;
+        t += 2 * SIM_MS;
+        for (int k = 0; k < 64; k++)
+            tr_toggle(tr, t += half);
+    }
+
+    /* 同一定时器的两个通道，共用中断和溢出 */
+    c = &cs[n++]; c->name = "two-channel"; c->dev[0] = "tim4_ic1"; c->dev[1] = "tim4_ic2"; c->ntr = 2;
+    c->latency = 2 * SIM_US; c->jitter = 4 * SIM_US; c->tail = SIM_MS;
+    tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+    pwm(tr, &t, 400 * SIM_US, 266 * SIM_US, 4500);
+    tr = &c->tr[1]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+    pwm(tr, &t, 13000 * SIM_US, 14027 * SIM_US + 333, 110);
+
+    /* 同一定时器的两个通道都关闭再打开：计数器停了又重新启动，第二个通道也要能打开 */
+    c = &cs[n++]; c->name = "two-ch-reopen"; c->dev[0] = "tim4_ic1"; c->dev[1] = "tim4_ic2"; c->ntr = 2;
+    c->latency = 2 * SIM_US; c->tail = SIM_MS;
+    tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+    pwm(tr, &t, 700 * SIM_US, 300 * SIM_US, 600);
+    c->reopen_at = SIM_T0 + 300 * SIM_MS + 500 * SIM_US;  // 第一个通道低电平期间
+    tr = &c->tr[1]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0 + 77 * SIM_US);
+    pwm(tr, &t, 2100 * SIM_US, 1900 * SIM_US, 150);
+
+    /* @测速：停转之后、关闭再打开之后重新平均，之前几转的周期不能再算进来
+     * @每转3个脉冲不用硬件预分频（模拟的定时器没有预分频） */
+    {
+        static const struct inputcapture_rpm_config rpm_cfg = { 3, 4, 1, 100 };
+
+        c = &cs[n++]; c->name = "rpm-resume"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+        c->latency = 2 * SIM_US; c->tail = 400 * SIM_MS; c->rpm = &rpm_cfg;
+        tr = &c->tr[0]; tr_begin(tr, 0); t = SIM_T0;
+        tach(tr, &c->expect, &t, 1000, 40, c->rpm);
+        rec_put(&c->expect, 0, 0);                  // 停转
+        t += 400 * SIM_MS;
+        tach(tr, &c->expect, &t, 400, 40, c->rpm);  // 比停转前快
+        c->reopen_at = t + SIM_MS;                  // 低电平期间关闭再打开
+        t += 5 * SIM_MS;
+        tach(tr, &c->expect, &t, 700, 40, c->rpm);
+        rec_put(&c->expect, 0, 0);
+    }
+
+    /* 单次捕获：只要打开后的前25条，之后不再捕获 */
+    {
+        static const struct sim_feature oneshot = { .oneshot = 25 };
+
+        c = &cs[n++]; c->name = "oneshot"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+        c->latency = 2 * SIM_US; c->tail = SIM_MS;
+        c->feat = &oneshot; c->setup = sim_feature_setup; c->check = sim_feature_check;
+        tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+        pwm(tr, &t, 700 * SIM_US, 300 * SIM_US, 100);
+    }
+
+    /* 单次捕获时信号断了：4条脉宽之后靠停滞记录凑够8条完成 */
+    {
+        static const struct sim_feature oneshot = { .oneshot = 8 };
+
+        c = &cs[n++]; c->name = "oneshot-stall"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+        c->latency = 2 * SIM_US; c->tail = 1000 * SIM_MS; c->stall_ms = 100;
+        c->feat = &oneshot; c->setup = sim_feature_setup; c->check = sim_feature_check;
+        tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+        pwm(tr, &t, 700 * SIM_US, 300 * SIM_US, 2);
+    }
+
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+    /* @滤波：1kHz，宽度抖动0~20us，每13个周期有一个高电平宽200us的野值
+     * @最小宽度用毛刺序列，最后停滞把推迟的那一条带出来 */
+    {
+        static const struct sim_feature median = { .filter = { INPUTCAPTURE_FILTER_MEDIAN, 5, 0, 0 } };
+        static const struct sim_feature hampel = { .filter = { INPUTCAPTURE_FILTER_HAMPEL, 7, 30, 5 } };
+        static const struct sim_feature min_width = { .filter = { INPUTCAPTURE_FILTER_MIN_WIDTH, 0, 0, 20 } };
+
+        for (int k = 0; k < 2; k++)
+        {
+            c = &cs[n++]; c->name = k ? "filter-hampel" : "filter-median"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+            c->latency = 2 * SIM_US; c->tail = SIM_MS;
+            c->feat = k ? &hampel : &median; c->setup = sim_feature_setup; c->check = sim_feature_check;
+            tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+            pwm_jitter(tr, &t, 700 * SIM_US, 300 * SIM_US, 20 * SIM_US, 13, 200 * SIM_US, 600);
+        }
+
+        c = &cs[n++]; c->name = "filter-minwidth"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+        c->latency = 2 * SIM_US; c->tail = 300 * SIM_MS; c->stall_ms = 100;
+        c->feat = &min_width; c->setup = sim_feature_setup; c->check = sim_feature_check;
+        tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+        for (int i = 0; i < 1000; i++)
+        {
+            if (rnd() % 3 == 0) {
+                uint64_t at = 50 * SIM_US + rnd() % (600 * SIM_US), width = 5 * SIM_US + rnd() % (30 * SIM_US);
+                tr_toggle(tr, t + at);
+                tr_toggle(tr, t + at + width);
+            }
+            tr_toggle(tr, t += 800 * SIM_US);
+            tr_toggle(tr, t += 200 * SIM_US);
+        }
+    }
+#endif
+
+#ifdef BSP_USING_INPUT_CAPTURE_DECIMATE
+    /* 抽取：每5个周期一对平均值，最后停滞时不满的一组也要输出 */
+    {
+        static const struct sim_feature decimate = { .decimate = 5 };
+
+        c = &cs[n++]; c->name = "decimate"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+        c->latency = 2 * SIM_US; c->tail = 300 * SIM_MS; c->stall_ms = 100;
+        c->feat = &decimate; c->setup = sim_feature_setup; c->check = sim_feature_check;
+        tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+        pwm_jitter(tr, &t, 700 * SIM_US, 300 * SIM_US, 20 * SIM_US, 13, 200 * SIM_US, 603);
+    }
+#ifdef BSP_USING_INPUT_CAPTURE_FILTER
+    /* 先中值滤波再抽取 */
+    {
+        static const struct sim_feature median_decimate = { .filter = { INPUTCAPTURE_FILTER_MEDIAN, 3, 0, 0 }, .decimate = 4 };
+
+        c = &cs[n++]; c->name = "median-decimate"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+        c->latency = 2 * SIM_US; c->tail = 300 * SIM_MS; c->stall_ms = 100;
+        c->feat = &median_decimate; c->setup = sim_feature_setup; c->check = sim_feature_check;
+        tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+        pwm_jitter(tr, &t, 700 * SIM_US, 300 * SIM_US, 20 * SIM_US, 13, 200 * SIM_US, 602);
+    }
+#endif
+#endif
+
+#ifdef BSP_USING_INPUT_CAPTURE_TRACE
+    /* 追踪：设了滤波和抽取也是原始边沿，停滞记录不进追踪流，每INPUT_CAPTURE_TRACE_SYNC_RECORDS条一个同步记录 */
+    {
+        static const struct sim_feature trace = { .filter = { INPUTCAPTURE_FILTER_MEDIAN, 5, 0, 0 }, .decimate = 4 };
+
+        c = &cs[n++]; c->name = "trace"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+        c->latency = 2 * SIM_US; c->tail = 300 * SIM_MS; c->stall_ms = 100;
+        c->feat = &trace; c->setup = sim_trace_setup; c->check = sim_trace_check;
+        c->poll = sim_trace_poll; c->poll_every = 20 * SIM_MS;
+        tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+        pwm_jitter(tr, &t, 700 * SIM_US, 300 * SIM_US, 20 * SIM_US, 13, 200 * SIM_US, 400);
+    }
+#endif
+
+#ifdef BSP_USING_INPUT_CAPTURE_FANOUT
+    /* 多读者：一个5ms读一次，一个到最后才读，后者只剩最后INPUT_CAPTURE_FANOUT_RECORDS条，停滞记录两边都有 */
+    {
+        static const struct sim_feature none = { .oneshot = 0 };
+
+        c = &cs[n++]; c->name = "fanout"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+        c->latency = 2 * SIM_US; c->tail = 300 * SIM_MS; c->stall_ms = 100;
+        c->feat = &none; c->setup = sim_fanout_setup; c->check = sim_fanout_check;
+        c->poll = sim_fanout_poll; c->poll_every = 5 * SIM_MS;
+        tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+        pwm(tr, &t, 700 * SIM_US, 300 * SIM_US, 600);
+    }
+#endif
+
+#ifdef BSP_USING_INPUT_CAPTURE_LATENCY
+    /* @延迟统计：10ms读一次，延迟都在10ms内；最后3条在缓冲区里等到70s后才读，超过DWT一圈（72MHz约59.6s），只计入overlimit */
+    {
+        static struct sim_feature latency;
+
+        c = &cs[n++]; c->name = "latency"; c->dev[0] = "tim3_ic2"; c->ntr = 1;
+        c->latency = 2 * SIM_US; c->tail = 70000 * SIM_MS;
+        c->feat = &latency; c->setup = sim_latency_setup; c->check = sim_latency_check;
+        c->poll = sim_latency_poll; c->poll_every = 10 * SIM_MS;
+        tr = &c->tr[0]; tr_begin(tr, 1); tr_toggle(tr, t = SIM_T0);
+        pwm(tr, &t, 700 * SIM_US, 300 * SIM_US, 1000);
+        latency.hold_from = t + 20 * SIM_MS;
+        t += 100 * SIM_MS;
+        for (int i = 0; i < 3; i++)
+            tr_toggle(tr, t += SIM_MS);
+    }
+#endif
+
+    return n;
+}
+
+/* 追踪流 ----------------------------------------------------------------------*/
+static void put_le32(FILE *f, uint32_t v)
+{
+    uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    fwrite(b, 1, 4, f);
+}
+
+/* 写成追踪流：计数频率1GHz（delta单位ns），第一个边沿在SIM_T0的通道回放时时刻完全一样（回放把第一个边沿放在SIM_T0）
+ * 每个通道的第一条记录前放一条同步记录（模拟时间），不在SIM_T0开始的通道靠它在ic_trace_conv转换时与其他通道对齐 */
+static int write_ictr(const char *dir, const struct sim_case *c)
+{
+    char path[512], name[IC_TRACE_NAME_LEN];
+    size_t pos[2] = { 1, 1 };
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/%s.ictr", dir, c->name);
+    f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    fwrite(IC_TRACE_MAGIC, 1, 4, f);
+    fputc(IC_TRACE_VERSION & 0xff, f);
+    fputc(IC_TRACE_VERSION >> 8, f);
+    fputc(c->ntr & 0xff, f);
+    fputc(c->ntr >> 8, f);
+    put_le32(f, 1000000000UL);
+    for (int i = 0; i < c->ntr; i++)
+    {
+        memset(name, 0, sizeof(name));
+        strncpy(name, c->dev[i], sizeof(name) - 1);
+        fwrite(name, 1, sizeof(name), f);
+    }
+    for (;;)
+    {
+        int ch = -1;
+        for (int i = 0; i < c->ntr; i++)
+        {
+            if (pos[i] < c->tr[i].n && (ch < 0 || c->tr[i].edge[pos[i]].t < c->tr[ch].edge[pos[ch]].t))
+                ch = i;
+        }
+        if (ch < 0)
+            break;
+        const struct sim_edge *e = &c->tr[ch].edge[pos[ch]++];
+        uint64_t delta = e->t - e[-1].t;
+        if (pos[ch] == 2) {
+            if (e->t > IC_TRACE_DELTA_MAX)
+                put_le32(f, IC_TRACE_WORD(IC_TRACE_CH_EXT, 0, e->t >> IC_TRACE_DELTA_BITS));
+            put_le32(f, IC_TRACE_WORD(IC_TRACE_CH_SYNC, 0, e->t));
+        }
+        if (delta > IC_TRACE_DELTA_MAX)
+            put_le32(f, IC_TRACE_WORD(IC_TRACE_CH_EXT, 0, delta >> IC_TRACE_DELTA_BITS));
+        put_le32(f, IC_TRACE_WORD(ch, e[-1].level, delta));
+    }
+    fclose(f);
+    return 0;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* 读出追踪流中一个通道的边沿，第一个边沿放在SIM_T0；只回放一个通道，同步记录用不上，跳过 */
+static int load_ictr(const char *path, unsigned want, struct sim_trace *tr)
+{
+    uint8_t header[IC_TRACE_HEADER_SIZE], buf[4];
+    uint32_t tick_hz, word, ext = 0;
+    uint64_t ticks = 0, delta;
+    unsigned n_ch;
+    int first = 1;
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) || memcmp(header, IC_TRACE_MAGIC, 4) ||
+            (header[4] | (header[5] << 8)) == 0 || (header[4] | (header[5] << 8)) > IC_TRACE_VERSION) {
+        fprintf(stderr, "%s: not an input capture trace\n", path);
+        fclose(f);
+        return 1;
+    }
+    n_ch = header[6] | (header[7] << 8);
+    tick_hz = get_le32(&header[8]);
+    if (want >= n_ch || tick_hz == 0 || fseek(f, (long)n_ch * IC_TRACE_NAME_LEN, SEEK_CUR) != 0) {
+        fprintf(stderr, "%s: no channel %u\n", path, want);
+        fclose(f);
+        return 1;
+    }
+    tr_begin(tr, 0);
+    while (fread(buf, 1, 4, f) == 4)
+    {
+        word = get_le32(buf);
+        if (IC_TRACE_WORD_CH(word) == IC_TRACE_CH_EXT) {
+            ext = IC_TRACE_WORD_DELTA(word);
+            continue;
+        }
+        if (IC_TRACE_WORD_CH(word) == IC_TRACE_CH_DROP) {
+            fprintf(stderr, "%s: records dropped while tracing, replaying up to that point\n", path);
+            break;
+        }
+        delta = ((uint64_t)ext << IC_TRACE_DELTA_BITS) | IC_TRACE_WORD_DELTA(word);
+        ext = 0;
+        if (IC_TRACE_WORD_CH(word) != want)
+            continue;
+        if (first) {
+            /* 第一条记录之前是第一个边沿，那之前的电平与这条相反 */
+            tr->init_level = !IC_TRACE_WORD_LEVEL(word);
+            tr_toggle(tr, SIM_T0);
+            first = 0;
+        }
+        ticks += delta;
+        tr_toggle(tr, SIM_T0 + (1000000000ULL % tick_hz == 0 ? ticks * (1000000000ULL / tick_hz)
+                : (uint64_t)((long double)ticks * 1e9L / tick_hz)));
+    }
+    fclose(f);
+    return 0;
+}
+
+static void report(const struct sim_case *c, const struct sim_stat *st, uint64_t best_ns)
+{
+    printf("%-12s %8llu edges %8llu captured %6llu overwritten %8zu records  %s",
+            c->name, (unsigned long long)st->edges, (unsigned long long)st->captures,
+            (unsigned long long)st->overwritten, st->records, st->errors ? "FAIL" : "ok  ");
+    if (st->serviced)
+        printf("  %6.1f ns/edge", (double)best_ns / st->serviced);
+    if (st->phases)
+        printf("  (%zu phases)", st->phases);
+    printf("\n");
+}
+
+static int run_case(const struct sim_case *c, int repeat, uint64_t *total_ns, uint64_t *total_edges)
+{
+    struct sim_stat st = { 0 };
+    uint64_t best = SIM_NEVER;
+    int errors = 0;
+
+    for (int r = 0; r < repeat; r++)
+    {
+        errors += sim_run(c, &st);
+        if (st.isr_ns < best)
+            best = st.isr_ns;
+        if (errors)
+            break;
+    }
+    st.errors = errors;
+    report(c, &st, best);
+    *total_ns += best;
+    *total_edges += st.serviced;
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    static struct sim_case cases[CASE_MAX];
+    const char *write_dir = RT_NULL;
+    uint64_t latency = 2 * SIM_US, total_ns = 0, total_edges = 0, a;
+    unsigned channel = 0;
+    uint32_t stall_ms = 0;
+    int repeat = 3, files = 0, failed = 0, n;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+            write_dir = argv[++i];
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            latency = strtoull(argv[++i], RT_NULL, 0);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            stall_ms = strtoul(argv[++i], RT_NULL, 0);
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            channel = strtoul(argv[++i], RT_NULL, 0);
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [-r repeat] [-w dir] [-l latency_ns] [-s stall_ms] [-c channel] [trace.ictr ...]\n", argv[0]);
+            return 1;
+        }
+        else
+            files++;
+    }
+    if (repeat <= 0)
+        return 1;
+
+    /* 计时本身的开销 */
+    a = now_ns();
+    for (int i = 0; i < 100000; i++)
+        now_ns();
+    sim_clock_overhead = (now_ns() - a) / 100000;
+
+    stm32_timer_capture_device_init();
+    if (files) {
+        for (int i = 1; i < argc; i++)
+        {
+            struct sim_case c = { 0 };
+            if (argv[i][0] == '-') {
+                i++;
+                continue;
+            }
+            c.name = argv[i];
+            c.dev[0] = "tim3_ic2";
+            c.ntr = 1;
+            c.latency = latency;
+            c.tail = stall_ms ? 10ULL * stall_ms * SIM_MS : SIM_MS;
+            c.stall_ms = stall_ms;
+            if (load_ictr(argv[i], channel, &c.tr[0]) != 0) {
+                failed++;
+                continue;
+            }
+            failed += run_case(&c, repeat, &total_ns, &total_edges) != 0;
+            free(c.tr[0].edge);
+        }
+    }
+    else {
+        n = build_cases(cases);
+        for (int i = 0; i < n; i++)
+        {
+            if (write_dir && write_ictr(write_dir, &cases[i]) != 0)
+                return 1;
+            failed += run_case(&cases[i], repeat, &total_ns, &total_edges) != 0;
+        }
+    }
+    if (total_edges)
+        printf("overall: %.1f ns/edge in the ISR\n", (double)total_ns / total_edges);
+    printf("%d case(s) failed\n", failed);
+    return failed ? 2 : 0;
+}
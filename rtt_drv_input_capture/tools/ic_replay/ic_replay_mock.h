@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ */
+
+/*
+ * ic_replay在上位机编译drv_input_capture.c用的最小环境：rtthread/rtdevice的类型和函数声明、STM32 HAL的定时器部分
+ * 定时器寄存器是普通内存，计数值、边沿捕获和中断标志由ic_replay.c按模拟时间维护：
+ * @SR的清除（HAL里写0清除）和CNT的读取要经过ic_replay.c，它在这里记下"哪次捕获被中断处理了"作为正确答案的依据
+ * @HAL的初始化/启动函数只改寄存器位，不做时钟、GPIO等与捕获计算无关的事
+ * @rt_inputcapture的环形缓冲区、DWT周期计数器和rt_tick_get也按模拟时间，追踪线程只创建不运行，由ic_replay.c代替它写出
+ * 只覆盖ic_replay用到的两套配置（F1、16位定时器，见rtconfig.h），驱动用到新的HAL接口时在这里补
+ */
+#ifndef IC_REPLAY_MOCK_H_
+#define IC_REPLAY_MOCK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "rtconfig.h"
+
+/* rtthread ------------------------------------------------------------------*/
+typedef int8_t      rt_int8_t;
+typedef int16_t     rt_int16_t;
+typedef int32_t     rt_int32_t;
+typedef int64_t     rt_int64_t;
+typedef uint8_t     rt_uint8_t;
+typedef uint16_t    rt_uint16_t;
+typedef uint32_t    rt_uint32_t;
+typedef uint64_t    rt_uint64_t;
+typedef int         rt_bool_t;
+typedef long        rt_base_t;
+typedef unsigned long rt_ubase_t;
+typedef rt_base_t   rt_err_t;
+typedef rt_ubase_t  rt_size_t;
+typedef rt_base_t   rt_ssize_t;
+typedef rt_base_t   rt_off_t;
+typedef rt_uint32_t rt_tick_t;
+
+#define RT_TRUE                     1
+#define RT_FALSE                    0
+#define RT_NULL                     ((void *)0)
+#define RT_EOK                      0
+#define RT_ERROR                    1
+#define RT_ETIMEOUT                 2
+#define RT_EFULL                    3
+#define RT_EEMPTY                   4
+#define RT_ENOMEM                   5
+#define RT_ENOSYS                   6
+#define RT_EBUSY                    7
+#define RT_EIO                      8
+#define RT_EINVAL                   10
+#define RT_WAITING_FOREVER          -1
+#define RT_WAITING_NO               0
+#define RT_IPC_FLAG_FIFO            0
+#define RT_IPC_CMD_RESET            1
+#define RT_NAME_MAX                 8
+#define RT_ALIGN_SIZE               4
+#define RT_ASSERT(x)                do { if (!(x)) ic_mock_assert(#x, __FILE__, __LINE__); } while (0)
+#define rt_inline                   static inline
+#define RT_UNUSED(x)                ((void)(x))
+#define INIT_DEVICE_EXPORT(fn)
+#define RT_DEVICE_OFLAG_RDWR        0x003
+#define RT_DEVICE_OFLAG_OPEN        0x008
+#define RT_TIMER_FLAG_PERIODIC      0x2
+#define RT_TIMER_FLAG_HARD_TIMER    0x0
+
+struct rt_object { char name[RT_NAME_MAX]; };
+struct rt_semaphore { struct rt_object parent; rt_uint16_t value; };
+typedef struct rt_semaphore *rt_sem_t;
+struct rt_thread { struct rt_object parent; };
+typedef struct rt_thread *rt_thread_t;
+struct rt_timer { struct rt_object parent; };
+typedef struct rt_timer *rt_timer_t;
+
+struct rt_device;
+typedef struct rt_device *rt_device_t;
+struct rt_device
+{
+    struct rt_object parent;
+    rt_uint16_t flag;
+    rt_uint16_t open_flag;
+    rt_uint8_t  ref_count;
+    rt_err_t (*rx_indicate)(rt_device_t dev, rt_size_t size);
+    rt_err_t  (*init)   (rt_device_t dev);
+    rt_err_t  (*open)   (rt_device_t dev, rt_uint16_t oflag);
+    rt_err_t  (*close)  (rt_device_t dev);
+    rt_ssize_t (*read)  (rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size);
+    rt_ssize_t (*write) (rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size);
+    rt_err_t  (*control)(rt_device_t dev, int cmd, void *args);
+    void *user_data;
+};
+
+void ic_mock_assert(const char *expr, const char *file, int line);
+rt_base_t rt_hw_interrupt_disable(void);
+void rt_hw_interrupt_enable(rt_base_t level);
+void rt_interrupt_enter(void);
+void rt_interrupt_leave(void);
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag);
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time);
+rt_err_t rt_sem_release(rt_sem_t sem);
+rt_err_t rt_sem_control(rt_sem_t sem, int cmd, void *arg);
+rt_err_t rt_sem_detach(rt_sem_t sem);
+void rt_timer_init(rt_timer_t timer, const char *name, void (*timeout)(void *parameter), void *parameter, rt_tick_t time, rt_uint8_t flag);
+rt_err_t rt_timer_start(rt_timer_t timer);
+rt_err_t rt_timer_stop(rt_timer_t timer);
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms);
+rt_tick_t rt_tick_get(void);
+rt_thread_t rt_thread_create(const char *name, void (*entry)(void *), void *p, rt_uint32_t stack, rt_uint8_t prio, rt_uint32_t tick);
+rt_err_t rt_thread_startup(rt_thread_t t);
+void *rt_malloc(rt_size_t size);
+void rt_free(void *p);
+#define rt_memset                   memset
+#define rt_memcpy                   memcpy
+#define rt_memmove                  memmove
+#define rt_strcmp                   strcmp
+#define rt_strncpy                  strncpy
+int rt_kprintf(const char *fmt, ...);
+rt_device_t rt_device_find(const char *name);
+rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag);
+rt_err_t rt_device_close(rt_device_t dev);
+rt_ssize_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size);
+
+/* rtdevice：rt_inputcapture框架 ------------------------------------------------*/
+struct rt_ringbuffer
+{
+    rt_uint8_t *buffer_ptr;
+    rt_uint16_t read_mirror : 1;
+    rt_uint16_t read_index : 15;
+    rt_uint16_t write_mirror : 1;
+    rt_uint16_t write_index : 15;
+    rt_int16_t buffer_size;
+};
+rt_size_t rt_ringbuffer_data_len(struct rt_ringbuffer *rb);
+#define rt_ringbuffer_space_len(rb) ((rb)->buffer_size - rt_ringbuffer_data_len(rb))
+
+#define INPUTCAPTURE_CMD_CLEAR_BUF          (128 + 0)
+#define INPUTCAPTURE_CMD_SET_WATERMARK      (128 + 1)
+
+struct rt_inputcapture_data
+{
+    rt_uint32_t pulsewidth_us;
+    rt_bool_t   is_high;
+};
+struct rt_inputcapture_device;
+struct rt_inputcapture_ops
+{
+    rt_err_t (*init)(struct rt_inputcapture_device *inputcapture);
+    rt_err_t (*open)(struct rt_inputcapture_device *inputcapture);
+    rt_err_t (*close)(struct rt_inputcapture_device *inputcapture);
+    rt_err_t (*get_pulsewidth)(struct rt_inputcapture_device *inputcapture, rt_uint32_t *pulsewidth_us);
+};
+struct rt_inputcapture_device
+{
+    struct rt_device parent;
+    const struct rt_inputcapture_ops *ops;
+    struct rt_ringbuffer *ringbuff;
+    rt_size_t watermark;
+};
+rt_err_t rt_device_inputcapture_register(struct rt_inputcapture_device *inputcapture, const char *name, void *data);
+/* 驱动输出的出口，ic_replay.c在这里收集记录 */
+void rt_hw_inputcapture_isr(struct rt_inputcapture_device *inputcapture, rt_bool_t level);
+
+/* Cortex-M：DWT周期计数器，CYCCNT在进中断和读之前由ic_replay.c按模拟时间更新 ------------*/
+typedef struct { volatile uint32_t CTRL, CYCCNT; } DWT_Type;
+typedef struct { volatile uint32_t DEMCR; } CoreDebug_Type;
+extern DWT_Type ic_mock_dwt;
+extern CoreDebug_Type ic_mock_coredebug;
+extern uint32_t SystemCoreClock;
+#define DWT                         (&ic_mock_dwt)
+#define CoreDebug                   (&ic_mock_coredebug)
+#define DWT_CTRL_CYCCNTENA_Msk      0x1U
+#define CoreDebug_DEMCR_TRCENA_Msk  0x01000000U
+
+/* STM32 HAL：定时器 ------------------------------------------------------------*/
+#define __IO volatile
+typedef struct
+{
+    __IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR, CCR1, CCR2, CCR3, CCR4, BDTR, DCR, DMAR;
+} TIM_TypeDef;
+extern TIM_TypeDef ic_mock_tim[5];
+#define TIM1                        (&ic_mock_tim[1])
+#define TIM2                        (&ic_mock_tim[2])
+#define TIM3                        (&ic_mock_tim[3])
+#define TIM4                        (&ic_mock_tim[4])
+#define TIM8                        ((TIM_TypeDef *)RT_NULL)
+
+typedef enum { TIM1_UP_IRQn = 25, TIM1_CC_IRQn = 27, TIM2_IRQn = 28, TIM3_IRQn = 29, TIM4_IRQn = 30 } IRQn_Type;
+typedef enum { HAL_OK = 0, HAL_ERROR } HAL_StatusTypeDef;
+typedef enum { RESET = 0, SET = 1 } FlagStatus, ITStatus;
+typedef enum
+{
+    HAL_TIM_ACTIVE_CHANNEL_1 = 0x01, HAL_TIM_ACTIVE_CHANNEL_2 = 0x02, HAL_TIM_ACTIVE_CHANNEL_3 = 0x04,
+    HAL_TIM_ACTIVE_CHANNEL_4 = 0x08, HAL_TIM_ACTIVE_CHANNEL_CLEARED = 0x00
+} HAL_TIM_ActiveChannel;
+typedef struct { uint32_t Prescaler, CounterMode, Period, ClockDivision, RepetitionCounter, AutoReloadPreload; } TIM_Base_InitTypeDef;
+typedef enum { HAL_TIM_CHANNEL_STATE_RESET = 0, HAL_TIM_CHANNEL_STATE_READY, HAL_TIM_CHANNEL_STATE_BUSY } HAL_TIM_ChannelStateTypeDef;
+/* 通道状态与HAL一样：HAL_TIM_IC_Init之后为READY，HAL_TIM_IC_Start_IT只接受READY的通道 */
+typedef struct
+{
+    TIM_TypeDef *Instance; TIM_Base_InitTypeDef Init; HAL_TIM_ActiveChannel Channel;
+    HAL_TIM_ChannelStateTypeDef ChannelState[4];
+} TIM_HandleTypeDef;
+typedef struct { uint32_t ClockSource, ClockPolarity, ClockPrescaler, ClockFilter; } TIM_ClockConfigTypeDef;
+typedef struct { uint32_t MasterOutputTrigger, MasterSlaveMode; } TIM_MasterConfigTypeDef;
+typedef struct { uint32_t ICPolarity, ICSelection, ICPrescaler, ICFilter; } TIM_IC_InitTypeDef;
+typedef struct { uint32_t ClockType, SYSCLKSource, AHBCLKDivider, APB1CLKDivider, APB2CLKDivider; } RCC_ClkInitTypeDef;
+
+#define RCC_HCLK_DIV1               0x0U
+#define RCC_HCLK_DIV2               0x400U
+#define TIM_CHANNEL_1               0x00U
+#define TIM_CHANNEL_2               0x04U
+#define TIM_CHANNEL_3               0x08U
+#define TIM_CHANNEL_4               0x0CU
+#define TIM_IT_UPDATE               0x01U
+#define TIM_IT_CC1                  0x02U
+#define TIM_IT_CC2                  0x04U
+#define TIM_IT_CC3                  0x08U
+#define TIM_IT_CC4                  0x10U
+#define TIM_IT_COM                  0x20U
+#define TIM_IT_TRIGGER              0x40U
+#define TIM_IT_BREAK                0x80U
+#define TIM_FLAG_UPDATE             TIM_IT_UPDATE
+#define TIM_FLAG_CC1                TIM_IT_CC1
+#define TIM_FLAG_CC2                TIM_IT_CC2
+#define TIM_FLAG_CC3                TIM_IT_CC3
+#define TIM_FLAG_CC4                TIM_IT_CC4
+#define TIM_FLAG_COM                TIM_IT_COM
+#define TIM_FLAG_TRIGGER            TIM_IT_TRIGGER
+#define TIM_FLAG_BREAK              TIM_IT_BREAK
+#define TIM_FLAG_CC1OF              0x200U
+#define TIM_CR1_CEN                 0x01U
+#define TIM_CCMR1_CC1S              0x0003U
+#define TIM_CCMR1_CC2S              0x0300U
+#define TIM_CCMR2_CC3S              0x0003U
+#define TIM_CCMR2_CC4S              0x0300U
+#define TIM_CCER_CC1E               0x0001U
+#define TIM_INPUTCHANNELPOLARITY_RISING     0x0U
+#define TIM_INPUTCHANNELPOLARITY_FALLING    0x2U
+#define TIM_INPUTCHANNELPOLARITY_BOTHEDGE   0xAU
+#define TIM_ICSELECTION_DIRECTTI    0x1U
+#define TIM_ICPSC_DIV1              0x0U
+#define TIM_ICPSC_DIV2              0x4U
+#define TIM_ICPSC_DIV4              0x8U
+#define TIM_ICPSC_DIV8              0xCU
+#define TIM_COUNTERMODE_UP          0x0U
+#define TIM_CLOCKDIVISION_DIV1      0x0U
+#define TIM_AUTORELOAD_PRELOAD_ENABLE   0x80U
+#define TIM_CLOCKSOURCE_INTERNAL    0x1000U
+#define TIM_TRGO_RESET              0x00U
+#define TIM_TRGO_ENABLE             0x10U
+#define TIM_TRGO_UPDATE             0x20U
+#define TIM_MASTERSLAVEMODE_DISABLE 0x00U
+#define TIM_MASTERSLAVEMODE_ENABLE  0x80U
+
+/* SR的位写0清除，经过ic_mock_clear_sr */
+void ic_mock_clear_sr(TIM_TypeDef *tim, uint32_t mask);
+void ic_mock_tim_enable(TIM_TypeDef *tim);
+void ic_mock_tim_disable(TIM_TypeDef *tim);
+uint32_t ic_mock_tim_counter(TIM_TypeDef *tim);
+#define __HAL_TIM_GET_FLAG(h, f)            (((h)->Instance->SR & (f)) == (f))
+#define __HAL_TIM_CLEAR_FLAG(h, f)          ic_mock_clear_sr((h)->Instance, (f))
+#define __HAL_TIM_CLEAR_IT(h, i)            ic_mock_clear_sr((h)->Instance, (i))
+#define __HAL_TIM_GET_IT_SOURCE(h, i)       ((((h)->Instance->DIER & (i)) == (i)) ? SET : RESET)
+#define __HAL_TIM_ENABLE_IT(h, i)           ((h)->Instance->DIER |= (i))
+#define __HAL_TIM_DISABLE_IT(h, i)          ((h)->Instance->DIER &= ~(i))
+#define __HAL_TIM_ENABLE(h)                 ic_mock_tim_enable((h)->Instance)
+#define __HAL_TIM_DISABLE(h)                ic_mock_tim_disable((h)->Instance)
+#define __HAL_TIM_GET_COUNTER(h)            ic_mock_tim_counter((h)->Instance)
+#define __HAL_TIM_SET_CAPTUREPOLARITY(h, c, p) \
+    ((h)->Instance->CCER = ((h)->Instance->CCER & ~(TIM_INPUTCHANNELPOLARITY_BOTHEDGE << (c))) | ((p) << (c)))
+#define __HAL_TIM_SET_ICPRESCALER(h, c, p)  ((void)0)
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef *htim, TIM_ClockConfigTypeDef *cfg);
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, TIM_MasterConfigTypeDef *cfg);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef *htim, TIM_IC_InitTypeDef *cfg, uint32_t ch);
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef *htim, uint32_t ch);
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef *htim, uint32_t ch);
+uint32_t HAL_TIM_ReadCapturedValue(TIM_HandleTypeDef *htim, uint32_t ch);
+void HAL_RCC_GetClockConfig(RCC_ClkInitTypeDef *cfg, uint32_t *latency);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t pre, uint32_t sub);
+void HAL_NVIC_EnableIRQ(IRQn_Type irq);
+
+#endif /* IC_REPLAY_MOCK_H_ */
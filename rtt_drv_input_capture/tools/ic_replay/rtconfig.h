@@ -0,0 +1,29 @@
+/* @ic_replay：上位机编译驱动用的配置，TIM3 CH2单独一个通道（也测测速模式），TIM4 CH1/CH2两个通道共用溢出中断
+ * @编译时加-DIC_REPLAY_FEATURES是第二套配置：再打开滤波、抽取、追踪、多读者和延迟统计，ic_replay多跑这些功能的用例
+ *  （单次捕获和停滞检测不用开关，两套配置都测）；也可以只加其中几个-DBSP_USING_INPUT_CAPTURE_xxx，用例按开关各自编译 */
+#ifndef RT_CONFIG_H__
+#define RT_CONFIG_H__
+
+#define RT_USING_INPUT_CAPTURE
+#define RT_INPUT_CAPTURE_RB_SIZE    100
+#define SOC_SERIES_STM32F1
+#define RT_TICK_PER_SECOND          1000
+#define RT_THREAD_PRIORITY_MAX      32
+
+#define BSP_USING_TIMER3_CAPTURE
+#define TIMER3_CAPTURE_CHANNEL2
+#define BSP_USING_TIMER4_CAPTURE
+#define TIMER4_CAPTURE_CHANNEL1
+#define TIMER4_CAPTURE_CHANNEL2
+
+#define BSP_USING_INPUT_CAPTURE_RPM
+
+#ifdef IC_REPLAY_FEATURES
+#define BSP_USING_INPUT_CAPTURE_FILTER
+#define BSP_USING_INPUT_CAPTURE_DECIMATE
+#define BSP_USING_INPUT_CAPTURE_TRACE
+#define BSP_USING_INPUT_CAPTURE_FANOUT
+#define BSP_USING_INPUT_CAPTURE_LATENCY
+#endif
+
+#endif
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-19     28784        the first version
+ * 2026-10-19     28784        align channels on sync records
+ */
+
+/*
+ * 上位机工具：把ic_trace输出的二进制追踪流转换为VCD（可用GTKWave等打开）或CSV
+ * 编译：gcc -O2 -I.. -o ic_trace_conv ic_trace_conv.c
+ * 用法：ic_trace_conv [-f vcd|csv] <输入文件|-> [输出文件]
+ *
+ * 每条记录是"某通道在某电平保持了delta个计数后发生了边沿"，各通道先各自累加得到本通道的时间
+ * @同步记录给出下一条记录结束时距开始追踪的时间，本通道的时间加上一个偏移就对齐到公共时间轴上
+ * @偏移按段记：丢弃记录之后各通道开始新的一段，要等该通道的下一条同步记录；同一段里后来的同步记录与累加的结果不一致时也开新的一段
+ * @同步记录之前的记录（开始追踪前捕获的边沿）用这一段后来的同步记录倒推
+ * @版本1的流没有同步记录，各通道只能各自从第一个边沿算起，多个通道不能对齐
+ * 全部记录先读进内存，定好各段的偏移后再输出：CSV按流中的顺序，VCD按时间排序
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "ic_trace_format.h"
+
+#define EV_INITIAL  0xfffe      // ch取这个值：通道第一条记录之前的电平
+#define EV_DROP     0xffff      // ch取这个值：丢弃记录
+
+struct trace_event
+{
+    int64_t  time;      // 边沿时刻（计数值），读的时候是本通道的时间，定好偏移后是公共时间
+    uint64_t width;     // 这条记录的持续时间；丢弃记录为丢弃条数
+    uint32_t seq;       // 流中的顺序，排序时保证同一时刻的先后不变
+    uint32_t seg;       // 所属的段
+    uint16_t ch;        // 通道号，或EV_xxx
+    uint16_t data_ch;   // EV_INITIAL的通道号
+    uint8_t  level;     // 边沿之后的电平
+};
+
+struct trace_seg
+{
+    int64_t  offset;    // 公共时间 = 本通道的时间 + offset
+    uint16_t ch;
+    uint8_t  synced;
+    uint8_t  used;      // 段里有记录
+};
+
+struct trace_channel
+{
+    char     name[IC_TRACE_NAME_LEN + 1];
+    int64_t  time;      // 本通道的时间
+    uint32_t seg;
+    int      seen;
+};
+
+static struct trace_event *events;
+static size_t n_events, cap_events;
+static struct trace_seg *segs;
+static size_t n_segs, cap_segs;
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static struct trace_event *event_add(void)
+{
+    if (n_events == cap_events) {
+        cap_events = cap_events ? cap_events * 2 : 4096;
+        events = realloc(events, cap_events * sizeof(*events));
+    }
+    memset(&events[n_events], 0, sizeof(events[0]));
+    return &events[n_events++];
+}
+
+static uint32_t seg_new(uint16_t ch, int synced, int64_t offset)
+{
+    if (n_segs == cap_segs) {
+        cap_segs = cap_segs ? cap_segs * 2 : 64;
+        segs = realloc(segs, cap_segs * sizeof(*segs));
+    }
+    segs[n_segs].ch = ch;
+    segs[n_segs].synced = synced;
+    segs[n_segs].offset = offset;
+    segs[n_segs].used = 0;
+    return (uint32_t)n_segs++;
+}
+
+static int event_cmp(const void *a, const void *b)
+{
+    const struct trace_event *x = a, *y = b;
+    if (x->time != y->time)
+        return x->time < y->time ? -1 : 1;
+    return x->seq < y->seq ? -1 : (x->seq > y->seq);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-f vcd|csv] <input|-> [output]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *format = "vcd", *in_path = NULL, *out_path = NULL;
+    FILE *in, *out;
+    uint8_t header[IC_TRACE_HEADER_SIZE], word_buf[4];
+    struct trace_channel *chs;
+    struct trace_event *ev;
+    uint32_t tick_hz, seq = 0, word, ch, ext = 0, version;
+    uint64_t delta, dropped = 0, sync = 0, n_sync = 0, unaligned = 0;
+    unsigned n_ch, i, n_seen = 0;
+    int csv, has_sync = 0;
+
+    for (int a = 1; a < argc; a++)
+    {
+        if (!strcmp(argv[a], "-f") && a + 1 < argc)
+            format = argv[++a];
+        else if (!in_path)
+            in_path = argv[a];
+        else if (!out_path)
+            out_path = argv[a];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!in_path || (strcmp(format, "vcd") && strcmp(format, "csv"))) {
+        usage(argv[0]);
+        return 1;
+    }
+    csv = !strcmp(format, "csv");
+
+    in = strcmp(in_path, "-") ? fopen(in_path, "rb") : stdin;
+    if (!in) {
+        perror(in_path);
+        return 1;
+    }
+    out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror(out_path);
+        return 1;
+    }
+
+    if (fread(header, 1, sizeof(header), in) != sizeof(header) || memcmp(header, IC_TRACE_MAGIC, 4)) {
+        fprintf(stderr, "not an input capture trace\n");
+        return 1;
+    }
+    version = header[4] | (header[5] << 8);
+    if (version < 1 || version > IC_TRACE_VERSION) {
+        fprintf(stderr, "unsupported trace version %u\n", version);
+        return 1;
+    }
+    n_ch = header[6] | (header[7] << 8);
+    tick_hz = get_le32(&header[8]);
+    chs = calloc(n_ch ? n_ch : 1, sizeof(*chs));
+    for (i = 0; i < n_ch; i++)
+    {
+        if (fread(chs[i].name, 1, IC_TRACE_NAME_LEN, in) != IC_TRACE_NAME_LEN) {
+            fprintf(stderr, "truncated header\n");
+            return 1;
+        }
+    }
+
+    while (fread(word_buf, 1, 4, in) == 4)
+    {
+        word = get_le32(word_buf);
+        ch = IC_TRACE_WORD_CH(word);
+        delta = ((uint64_t)ext << IC_TRACE_DELTA_BITS) | IC_TRACE_WORD_DELTA(word);
+        if (ch == IC_TRACE_CH_EXT) {
+            ext = IC_TRACE_WORD_DELTA(word);
+            continue;
+        }
+        ext = 0;
+        if (ch == IC_TRACE_CH_SYNC && version >= 2) {
+            sync = delta;
+            has_sync = 1;
+            continue;
+        }
+        if (ch == IC_TRACE_CH_DROP) {
+            dropped += delta;
+            fprintf(stderr, "warning: %u edges dropped before record %u\n", (unsigned)delta, seq);
+            /* 各通道的时间从这里断开，等各自的下一条同步记录 */
+            for (i = 0; i < n_ch; i++)
+            {
+                if (chs[i].seen)
+                    chs[i].seg = seg_new((uint16_t)i, 0, 0);
+            }
+            ev = event_add();
+            ev->ch = EV_DROP;
+            ev->width = delta;
+            ev->seq = seq;
+            has_sync = 0;
+            continue;
+        }
+        if (ch >= n_ch) {
+            fprintf(stderr, "bad channel %u in record %u\n", ch, seq);
+            return 1;
+        }
+
+        if (!chs[ch].seen) {
+            chs[ch].seen = 1;
+            chs[ch].seg = seg_new((uint16_t)ch, 0, 0);
+            n_seen++;
+            /* 该通道第一条记录之前的电平 */
+            ev = event_add();
+            ev->ch = EV_INITIAL;
+            ev->data_ch = (uint16_t)ch;
+            ev->seq = seq;
+            ev->seg = chs[ch].seg;
+            ev->level = (uint8_t)IC_TRACE_WORD_LEVEL(word);
+        }
+        chs[ch].time += delta;
+        if (has_sync) {
+            struct trace_seg *s = &segs[chs[ch].seg];
+            int64_t offset = (int64_t)sync - chs[ch].time;
+
+            if (!s->synced) {
+                s->synced = 1;
+                s->offset = offset;
+            }
+            else if (s->offset != offset)
+                chs[ch].seg = seg_new((uint16_t)ch, 1, offset);
+            has_sync = 0;
+            n_sync++;
+        }
+        ev = event_add();
+        ev->time = chs[ch].time;
+        ev->width = delta;
+        ev->seq = seq;
+        ev->seg = chs[ch].seg;
+        ev->ch = (uint16_t)ch;
+        segs[ev->seg].used = 1;
+        ev->level = (uint8_t)!IC_TRACE_WORD_LEVEL(word);
+        seq++;
+    }
+
+    /* 没有同步记录的段：有同步的流里只会出现在截断处，接着同一通道上一段的偏移；版本1的流偏移为0 */
+    for (size_t s = 0; s < n_segs; s++)
+    {
+        if (segs[s].synced || !segs[s].used)
+            continue;
+        for (size_t p = s; p-- > 0; )
+        {
+            if (segs[p].ch == segs[s].ch && segs[p].synced) {
+                segs[s].offset = segs[p].offset;
+                break;
+            }
+        }
+        unaligned++;
+    }
+    for (size_t e = 0; e < n_events; e++)
+    {
+        ev = &events[e];
+        if (ev->ch == EV_DROP)
+            continue;
+        ev->time = ev->ch == EV_INITIAL ? 0 : ev->time + segs[ev->seg].offset;
+        if (ev->time < 0)// 开始追踪之前的边沿
+            ev->time = 0;
+    }
+    if (n_sync == 0 && n_seen > 1)
+        fprintf(stderr, "warning: no sync records (version %u stream), channels are not aligned with each other\n", version);
+    else if (n_sync && unaligned)
+        fprintf(stderr, "warning: %llu segment(s) without a sync record, their timing may be off\n", (unsigned long long)unaligned);
+
+    if (csv) {
+        fprintf(out, "time_ticks,channel,name,level_before,width_ticks\n");
+        for (size_t e = 0; e < n_events; e++)
+        {
+            ev = &events[e];
+            if (ev->ch == EV_DROP)
+                fprintf(out, "#dropped,%llu\n", (unsigned long long)ev->width);
+            else if (ev->ch != EV_INITIAL)
+                fprintf(out, "%lld,%u,%s,%u,%llu\n", (long long)ev->time, ev->ch, chs[ev->ch].name,
+                        (unsigned)!ev->level, (unsigned long long)ev->width);
+        }
+    }
+    else {
+        uint64_t scale = (tick_hz && 1000000000ULL % tick_hz == 0) ? 1000000000ULL / tick_hz : 1;
+        int64_t last = -1;
+
+        qsort(events, n_events, sizeof(*events), event_cmp);
+        fprintf(out, "$timescale 1ns $end\n$scope module ic_trace $end\n");
+        for (i = 0; i < n_ch; i++)
+        {
+            if (chs[i].seen)
+                fprintf(out, "$var wire 1 %c %s $end\n", (char)('!' + i), chs[i].name);
+        }
+        fprintf(out, "$upscope $end\n$enddefinitions $end\n");
+        for (size_t e = 0; e < n_events; e++)
+        {
+            ev = &events[e];
+            if (ev->ch == EV_DROP)
+                continue;
+            if (ev->time != last) {
+                last = ev->time;
+                fprintf(out, "#%llu\n", (unsigned long long)last * scale);
+            }
+            fprintf(out, "%u%c\n", ev->level, (char)('!' + (ev->ch == EV_INITIAL ? ev->data_ch : ev->ch)));
+        }
+        if (scale == 1 && tick_hz != 1000000000UL)
+            fprintf(stderr, "warning: tick rate %u Hz is not a divisor of 1 GHz, VCD times are in ticks\n", tick_hz);
+    }
+
+    fprintf(stderr, "%u records, %llu dropped, %llu sync\n", seq, (unsigned long long)dropped, (unsigned long long)n_sync);
+    free(events);
+    free(segs);
+    free(chs);
+    if (out != stdout)
+        fclose(out);
+    if (in != stdin)
+        fclose(in);
+    return 0;
+}